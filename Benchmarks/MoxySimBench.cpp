@@ -0,0 +1,842 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Headless benchmarks for the MoxySim engine. MoxySim and the engine files built with it below have no Qt dependency, so this builds on its own:
+//   g++ -O2 -std=c++14 -I../Moxybox MoxySimBench.cpp ../Moxybox/MoxySim.cpp ../Moxybox/MoxySolver.cpp ../Moxybox/MoxyStateTable.cpp ../Moxybox/MoxyDangerMap.cpp ../Moxybox/MoxyPlayout.cpp ../Moxybox/MoxyExternalSearch.cpp ../Moxybox/MoxyMoveKernel.cpp ../Moxybox/MoxyLevelFile.cpp -pthread -o MoxySimBench
+//   cl /O2 /EHsc /I..\Moxybox MoxySimBench.cpp ..\Moxybox\MoxySim.cpp ..\Moxybox\MoxySolver.cpp ..\Moxybox\MoxyStateTable.cpp ..\Moxybox\MoxyDangerMap.cpp ..\Moxybox\MoxyPlayout.cpp ..\Moxybox\MoxyExternalSearch.cpp ..\Moxybox\MoxyMoveKernel.cpp ..\Moxybox\MoxyLevelFile.cpp
+// Run with no arguments for every benchmark, or name the ones you want (e.g. "MoxySimBench turns").
+// With MOXY_BENCH_TURNS_ONLY defined it's only the "turns" benchmark, which needs nothing from MoxySim but playing turns,
+// so it can also be built against an older revision's MoxySim.h and MoxySim.cpp to compare an engine change with what came before:
+//   g++ -O2 -std=c++14 -DMOXY_BENCH_TURNS_ONLY -I<old> MoxySimBench.cpp <old>/MoxySim.cpp -o MoxySimBenchOld
+
+#include "MoxySim.h"
+#ifndef MOXY_BENCH_TURNS_ONLY
+#include "MoxySolver.h"
+#include "MoxyStateTable.h"
+#include "MoxyDangerMap.h"
+#include "MoxyPlayout.h"
+#include "MoxyExternalSearch.h"
+#include "MoxyMoveKernel.h"
+#include "MoxyLevelFile.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	const int benchRuns = 5;
+
+	double secondsSince(const Clock::time_point &start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// A crowded level: patrollers on every other row and column, a wall of blocks with gaps,
+	// traps scattered about and a hazard/teleport pair, so nearly every turn has something to collide with.
+	MoxySim::simLevel denseLevel()
+	{
+		MoxySim::simLevel level;
+		level.turnsInitial = 200;
+		level.player = MoxySim::simPoint{ 0, 0 };
+
+		for (int x = 2; x < MoxySim::gridRowSize; x += 4)
+		{
+			MoxySim::simPatrollerDef def{};
+			def.initial = MoxySim::simPoint{ x, 4 };
+			def.type = MoxySim::PatrollerType::PUSHER;
+			def.facingInitial = MoxySim::Facing::UP;
+			def.patrolDir = MoxySim::PatrolDir::VERTICAL;
+			def.patrolBoundUp = 4;
+			def.patrolBoundDown = 5;
+			level.pushers.emplace_back(def);
+		}
+		for (int y = 1; y < MoxySim::gridColSize; y += 3)
+		{
+			MoxySim::simPatrollerDef def{};
+			def.initial = MoxySim::simPoint{ 10, y };
+			def.type = MoxySim::PatrollerType::SUCKER;
+			def.facingInitial = MoxySim::Facing::LEFT;
+			def.patrolDir = MoxySim::PatrolDir::HORIZONTAL;
+			def.patrolBoundLeft = 7;
+			def.patrolBoundRight = 8;
+			level.suckers.emplace_back(def);
+		}
+		for (int y = 0; y < MoxySim::gridColSize; y++)
+		{
+			if (y % 3 != 0)
+				level.blocks.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 15, y }, MoxySim::ImmobileType::BLOCK });
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			level.keys.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 1 + (i * 4), 8 }, MoxySim::ImmobileType::KEY });
+			level.gates.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 17 + (i % 3), 1 + (i * 2) }, MoxySim::ImmobileType::GATE });
+		}
+		level.hazards.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 5, 9 }, MoxySim::ImmobileType::HAZARD });
+		level.hazards.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 13, 0 }, MoxySim::ImmobileType::HAZARD });
+		level.teleports.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 0, 9 }, MoxySim::ImmobileType::TELEPORT });
+		level.teleports.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 19, 9 }, MoxySim::ImmobileType::TELEPORT });
+		for (int i = 0; i < 6; i++)
+		{
+			const MoxySim::UtilType type = i % 2 == 0 ? MoxySim::UtilType::PUSHER : MoxySim::UtilType::SUCKER;
+			level.utils.emplace_back(MoxySim::simUtilDef{ MoxySim::simPoint{ 1 + (i * 2), 2 + (i % 5) }, type, MoxySim::UtilState::INACTIVE });
+		}
+		return level;
+	}
+
+	// Random play on the dense level. Restarts the level whenever it ends, like a player would.
+	// Timings on a busy machine easily spread 15% either way, so it's run more times than the others, and the median is given with the best:
+	// two builds only differ if their medians do by more than that.
+	void benchTurns()
+	{
+		const int turnsTotal = 2000000;
+		const int runs = 15;
+		MoxySim sim(denseLevel());
+		std::mt19937 rng(12345);
+		std::uniform_int_distribution<int> pickAction(1, 6);
+
+		// Actions are drawn up front, so the timing is the engine and nothing else.
+		std::vector<MoxySim::Action> actions(turnsTotal);
+		for (auto& action : actions)
+			action = static_cast<MoxySim::Action>(pickAction(rng));
+
+		std::vector<double> seconds;
+		long long checksum = 0;
+		for (int run = 0; run < runs; run++)
+		{
+			sim.reset();
+			checksum = 0;
+			const Clock::time_point start = Clock::now();
+			for (const auto& action : actions)
+			{
+				const MoxySim::TurnResult result = sim.playerTurn(action);
+				checksum += sim.getState().player.pos.x + sim.getState().player.pos.y;
+				if (result == MoxySim::TurnResult::COMPLETE || result == MoxySim::TurnResult::FAILED)
+					sim.reset();
+			}
+			seconds.push_back(secondsSince(start));
+		}
+		std::sort(seconds.begin(), seconds.end());
+
+		printf("turns: %d turns, best %.0f turns/s, median %.0f turns/s over %d runs (checksum %lld)\n",
+			turnsTotal, turnsTotal / seconds.front(), turnsTotal / seconds[runs / 2], runs, checksum);
+	}
+
+#ifndef MOXY_BENCH_TURNS_ONLY
+	// Plays a long game on the dense level with history on (turns only run out through hazards, since it's restarted rather than failed),
+	// then steps all the way back and forward again. Reports what a turn of history costs in memory and time.
+	void benchUndo()
+	{
+		const int turnsTotal = 200000;
+		MoxySim::simLevel level = denseLevel();
+		level.turnsInitial = turnsTotal * 2;
+		MoxySim sim(level);
+		std::mt19937 rng(12345);
+		std::uniform_int_distribution<int> pickAction(1, 6);
+
+		std::vector<MoxySim::Action> actions(turnsTotal);
+		for (auto& action : actions)
+			action = static_cast<MoxySim::Action>(pickAction(rng));
+
+		double secondsUndoBest = 0;
+		double secondsRedoBest = 0;
+		int turnsRecorded = 0;
+		size_t bytes = 0;
+		for (int run = 0; run < benchRuns; run++)
+		{
+			sim.reset();
+			for (const auto& action : actions)
+			{
+				if (sim.playerTurn(action) == MoxySim::TurnResult::FAILED)
+					break;
+			}
+			turnsRecorded = sim.getHistoryTurns();
+			bytes = sim.getHistoryBytes();
+
+			Clock::time_point start = Clock::now();
+			while (sim.undo()) {}
+			const double secondsUndo = secondsSince(start);
+
+			start = Clock::now();
+			while (sim.redo()) {}
+			const double secondsRedo = secondsSince(start);
+
+			if (run == 0 || secondsUndo < secondsUndoBest)
+				secondsUndoBest = secondsUndo;
+			if (run == 0 || secondsRedo < secondsRedoBest)
+				secondsRedoBest = secondsRedo;
+		}
+
+		printf("undo: %d turns of history in %zu bytes (%.1f bytes/turn), undo %.0f turns/s, redo %.0f turns/s\n",
+			turnsRecorded, bytes, double(bytes) / turnsRecorded, turnsRecorded / secondsUndoBest, turnsRecorded / secondsRedoBest);
+	}
+
+	// No patrollers, so the player only walks: a serpentine of block walls, each gate a little further on than the key for it,
+	// and traps to pick up along the way that multiply the states without helping.
+	MoxySim::simLevel mazeLevel()
+	{
+		MoxySim::simLevel level;
+		level.turnsInitial = 120;
+		level.player = MoxySim::simPoint{ 0, 0 };
+
+		for (int y = 1; y < MoxySim::gridColSize - 1; y += 2)
+		{
+			const int gap = (y % 4 == 1) ? MoxySim::gridRowSize - 1 : 0;
+			for (int x = 0; x < MoxySim::gridRowSize; x++)
+			{
+				if (x != gap)
+					level.blocks.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ x, y }, MoxySim::ImmobileType::BLOCK });
+			}
+		}
+		level.keys.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 4, 0 }, MoxySim::ImmobileType::KEY });
+		level.keys.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 2, 4 }, MoxySim::ImmobileType::KEY });
+		level.gates.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 10, 0 }, MoxySim::ImmobileType::GATE });
+		level.gates.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 15, 8 }, MoxySim::ImmobileType::GATE });
+		level.hazards.emplace_back(MoxySim::simImmobileDef{ MoxySim::simPoint{ 8, 8 }, MoxySim::ImmobileType::HAZARD });
+		level.utils.emplace_back(MoxySim::simUtilDef{ MoxySim::simPoint{ 3, 0 }, MoxySim::UtilType::PUSHER, MoxySim::UtilState::INACTIVE });
+		level.utils.emplace_back(MoxySim::simUtilDef{ MoxySim::simPoint{ 15, 2 }, MoxySim::UtilType::SUCKER, MoxySim::UtilState::INACTIVE });
+		return level;
+	}
+
+	// Solves the dense level with a tight turn budget, so the search has to cover everything reachable
+	// (there's no way out in that many turns) rather than stopping at the first win.
+	void benchSolve()
+	{
+		MoxySim::simLevel level = denseLevel();
+		level.turnsInitial = 12;
+
+		MoxySolver::solveOutcome best;
+		for (int run = 0; run < benchRuns; run++)
+		{
+			const MoxySolver::solveOutcome outcome = MoxySolver::solve(level);
+			if (run == 0 || outcome.stats.seconds < best.stats.seconds)
+				best = outcome;
+		}
+
+		const char *resultText = best.result == MoxySolver::Result::SOLVED ? "solved" :
+			best.result == MoxySolver::Result::UNSOLVABLE ? "unsolvable" : "limit reached";
+		printf("solve: %s, %lld states expanded (%lld kept) in %.3f s, %.0f states/s\n",
+			resultText, best.stats.expanded, best.stats.generated, best.stats.seconds, best.stats.expanded / best.stats.seconds);
+	}
+
+	// Breadth-first and iterative-deepening A* on the same levels: the maze, where the heuristic knows the way,
+	// and the dense level, where patrollers leave it next to nothing to go on. Compares time and peak memory.
+	void benchSolveIterative()
+	{
+		// Only a solution has a turn count worth printing.
+		const auto report = [](const char *algorithm, const char *name, const MoxySolver::solveOutcome &outcome) {
+			printf("iterative: %s, %s, ", algorithm, name);
+			if (outcome.result == MoxySolver::Result::SOLVED)
+				printf("solved in %d turns", outcome.turnsUsed);
+			else
+				printf("%s", outcome.result == MoxySolver::Result::UNSOLVABLE ? "unsolvable" : "limit reached");
+			printf(", %lld states expanded in %.3f s, peak memory %.1f MB",
+				outcome.stats.expanded, outcome.stats.seconds, outcome.stats.peakMemory / 1048576.0);
+			if (outcome.stats.iterations > 0)
+				printf(", %d passes", outcome.stats.iterations);
+			printf("\n");
+		};
+
+		MoxySim::simLevel dense = denseLevel();
+		dense.turnsInitial = 10;
+		const struct
+		{
+			const char *name;
+			MoxySim::simLevel level;
+		} levels[] = { { "maze", mazeLevel() }, { "dense", dense } };
+
+		// Breadth-first can't finish the maze, so it's stopped at a million states rather than left to eat the machine's memory.
+		MoxySolver::solveLimits limits;
+		limits.maxStates = 1000000;
+		for (const auto& entry : levels)
+		{
+			report("breadth-first", entry.name, MoxySolver::solve(entry.level, limits));
+			report("IDA*", entry.name, MoxySolver::solveIterative(entry.level, limits));
+		}
+	}
+
+	// The same search as "solve", spread over 1, 2, 4... threads up to what the machine has.
+	// Speedup is against the one-thread run of the parallel search, so it measures scaling rather than the cost of going parallel.
+	void benchSolveParallel()
+	{
+		MoxySim::simLevel level = denseLevel();
+		level.turnsInitial = 12;
+
+		const int threadsMax = std::max(2, int(std::thread::hardware_concurrency()));
+		std::vector<int> threadCounts;
+		for (int threads = 1; threads < threadsMax; threads *= 2)
+			threadCounts.push_back(threads);
+		threadCounts.push_back(threadsMax);
+
+		double rateSingle = 0;
+		for (const int threads : threadCounts)
+		{
+			MoxySolver::solveOutcome best;
+			for (int run = 0; run < benchRuns; run++)
+			{
+				const MoxySolver::solveOutcome outcome = MoxySolver::solveParallel(level, MoxySolver::solveLimits(), threads);
+				if (run == 0 || outcome.stats.seconds < best.stats.seconds)
+					best = outcome;
+			}
+
+			const double rate = best.stats.expanded / best.stats.seconds;
+			if (threads == 1)
+				rateSingle = rate;
+			printf("parallel: %d threads, %lld states expanded in %.3f s, %.0f states/s, speedup %.2fx\n",
+				threads, best.stats.expanded, best.stats.seconds, rate, rate / rateSingle);
+		}
+	}
+
+	// Hammers a MoxyStateTable from 1 to 64 threads. Offers are shared out by index, several per state with different turns and links,
+	// so threads race on the same states as a parallel search would. Afterwards every state is checked against the best offer made for it,
+	// which has to be what's stored whatever order the offers landed in. Then once more, with a table too small to hold everything.
+	void benchStateTable()
+	{
+		const int statesTotal = 1 << 21;
+		const int offersPerState = 4;
+		const long long offersTotal = (long long)statesTotal * offersPerState;
+		const auto offerTurns = [](const long long i) { return int(MoxySim::splitMix(uint64_t(i) * 3 + 1) % 200); };
+
+		std::vector<int> turnsBest(statesTotal, -1);
+		std::vector<uint64_t> linkBest(statesTotal, 0);
+		for (long long i = 0; i < offersTotal; i++)
+		{
+			const int state = int(i % statesTotal);
+			const int turns = offerTurns(i);
+			if (turns > turnsBest[state] || (turns == turnsBest[state] && uint64_t(i) < linkBest[state]))
+			{
+				turnsBest[state] = turns;
+				linkBest[state] = uint64_t(i);
+			}
+		}
+
+		const auto run = [&](MoxyStateTable &table, const int threads) {
+			table.clear();
+			std::vector<std::thread> workers;
+			const Clock::time_point start = Clock::now();
+			for (int t = 0; t < threads; t++)
+			{
+				workers.emplace_back([&, t]() {
+					for (long long i = t; i < offersTotal; i += threads)
+						table.offer(MoxySim::splitMix(uint64_t(i % statesTotal)), offerTurns(i), uint64_t(i));
+				});
+			}
+			for (auto& worker : workers)
+				worker.join();
+			return secondsSince(start);
+		};
+
+		MoxyStateTable table(size_t(statesTotal) * 2 * 16);
+		for (int threads = 1; threads <= 64; threads *= 2)
+		{
+			const double seconds = run(table, threads);
+
+			int wrong = 0;
+			for (int state = 0; state < statesTotal; state++)
+			{
+				int turns;
+				uint64_t link;
+				if (!table.find(MoxySim::splitMix(uint64_t(state)), turns, link) || turns != turnsBest[state] || link != linkBest[state])
+					wrong++;
+			}
+			printf("table: %d threads, %lld offers in %.3f s, %.1f M offers/s, %d of %d states wrong\n",
+				threads, offersTotal, seconds, offersTotal / seconds / 1e6, wrong, statesTotal);
+		}
+
+		MoxyStateTable small(size_t(statesTotal) / 4 * 16, MoxyStateTable::Replacement::FEWEST_TURNS);
+		const int threads = std::max(1, int(std::thread::hardware_concurrency()));
+		const double seconds = run(small, threads);
+		printf("table: %d threads, %zu slots for %d states replacing fewest turns, %.1f M offers/s, %zu kept\n",
+			threads, small.capacity(), statesTotal, offersTotal / seconds / 1e6, small.size());
+	}
+
+	// How long telling a lost state costs, on states from random games: once on the dense level (patrollers, so only keys and pods count)
+	// and once on the maze (walking only, so distances count too). It runs after every turn in play, so it should be well under a turn.
+	void benchLost()
+	{
+		const int turnsTotal = 200000;
+		for (const bool maze : { false, true })
+		{
+			const MoxySim::simLevel level = maze ? mazeLevel() : denseLevel();
+			MoxySim sim(level);
+			const MoxySolver::distanceHeuristic lostCheck(level);
+			std::mt19937 rng(12345);
+			std::uniform_int_distribution<int> pickAction(1, 6);
+
+			std::vector<MoxySim::simState> states;
+			states.reserve(turnsTotal);
+			for (int turn = 0; turn < turnsTotal; turn++)
+			{
+				const MoxySim::TurnResult result = sim.playerTurn(static_cast<MoxySim::Action>(pickAction(rng)));
+				states.push_back(sim.getState());
+				if (result == MoxySim::TurnResult::COMPLETE || result == MoxySim::TurnResult::FAILED)
+					sim.reset();
+			}
+
+			double secondsBest = 0;
+			int lost = 0;
+			for (int run = 0; run < benchRuns; run++)
+			{
+				lost = 0;
+				const Clock::time_point start = Clock::now();
+				for (const auto& state : states)
+					lost += lostCheck.isLost(state) ? 1 : 0;
+				const double seconds = secondsSince(start);
+				if (run == 0 || seconds < secondsBest)
+					secondsBest = seconds;
+			}
+
+			printf("lost: %s level, %d states in %.3f s, %.0f ns a check, %d lost\n",
+				maze ? "maze" : "dense", turnsTotal, secondsBest, secondsBest / turnsTotal * 1e9, lost);
+		}
+	}
+
+	// Keeping a danger map up to date through a long game on the dense level, a turn at a time, against working it out from scratch every turn.
+	// Both are timed without the turns themselves, which are played once up front.
+	void benchDanger()
+	{
+		const int turnsTotal = 200000;
+		const int horizon = 8;
+		MoxySim::simLevel level = denseLevel();
+		level.turnsInitial = turnsTotal * 2;
+		MoxySim sim(level);
+		sim.setHistoryEnabled(false);
+		std::mt19937 rng(12345);
+		std::uniform_int_distribution<int> pickAction(1, 4);
+
+		std::vector<MoxySim::simState> states;
+		states.reserve(turnsTotal);
+		while (int(states.size()) < turnsTotal)
+		{
+			const MoxySim::TurnResult result = sim.playerTurn(static_cast<MoxySim::Action>(pickAction(rng)));
+			if (result == MoxySim::TurnResult::BLOCKED)
+				continue;
+			states.push_back(sim.getState());
+			if (result != MoxySim::TurnResult::PLAYING)
+				sim.reset();
+		}
+
+		MoxySim replay(level);
+		MoxyDangerMap incremental(horizon);
+		MoxyDangerMap fromScratch(horizon);
+		incremental.rebuild(replay);
+		double secondsAdvance = 0;
+		double secondsRebuild = 0;
+		long long agree = 0;
+		const auto sameBoard = [](const MoxySim::simBitboard &a, const MoxySim::simBitboard &b) {
+			return std::equal(a.words, a.words + MoxySim::simBitboard::wordCount, b.words);
+		};
+		for (const auto& state : states)
+		{
+			replay.setState(state);
+			Clock::time_point start = Clock::now();
+			incremental.advance(replay);
+			secondsAdvance += secondsSince(start);
+
+			start = Clock::now();
+			fromScratch.rebuild(replay);
+			secondsRebuild += secondsSince(start);
+
+			// Agreeing means every square of the whole map and of each turn's layer.
+			bool same = sameBoard(incremental.getThreatened(), fromScratch.getThreatened());
+			for (int turns = 1; turns <= horizon && same; turns++)
+				same = sameBoard(incremental.getThreatenedIn(turns), fromScratch.getThreatenedIn(turns));
+			agree += same ? 1 : 0;
+		}
+
+		printf("danger: %d turns, horizon %d, advance %.0f ns a turn, rebuild %.0f ns a turn (%lld of %d agree)\n",
+			turnsTotal, horizon, secondsAdvance / turnsTotal * 1e9, secondsRebuild / turnsTotal * 1e9, agree, turnsTotal);
+	}
+
+	// Random and greedy playouts of both levels, on one thread and then on every thread there is.
+	void benchPlayout()
+	{
+		const int hardwareThreads = std::max(1, int(std::thread::hardware_concurrency()));
+		for (const bool maze : { false, true })
+		{
+			const MoxySim::simLevel level = maze ? mazeLevel() : denseLevel();
+			for (const MoxyPlayout::Policy policy : { MoxyPlayout::Policy::RANDOM, MoxyPlayout::Policy::GREEDY })
+			{
+				const bool greedy = policy == MoxyPlayout::Policy::GREEDY;
+				const long long games = greedy ? 20000 : 200000;
+				for (const int threads : { 1, hardwareThreads })
+				{
+					const MoxyPlayout::playoutStats stats = MoxyPlayout::play(level, games, policy, threads, 12345);
+					printf("playout: %s level, %s, %d threads, %lld games in %.3f s, %.0f games/s, won %.1f%%, median win %d turns\n",
+						maze ? "maze" : "dense", greedy ? "greedy" : "random", threads, stats.games, stats.seconds, stats.games / stats.seconds,
+						stats.winRate() * 100, stats.medianWinTurns());
+					if (hardwareThreads == 1)
+						break;
+				}
+			}
+		}
+	}
+
+	// Every state of the dense level with a few turns, searched from disk with a small buffer so each layer spills several runs.
+	void benchExternal()
+	{
+		MoxySim::simLevel level = denseLevel();
+		level.turnsInitial = 12;
+		MoxyExternalSearch::searchLimits limits;
+		limits.bufferMemory = size_t(4) << 20;
+
+		const MoxyExternalSearch::searchStats stats = MoxyExternalSearch::enumerate(level, limits);
+		if (stats.result != MoxyExternalSearch::Result::COMPLETE)
+		{
+			printf("external: didn't finish (result %d)\n", int(stats.result));
+			return;
+		}
+		printf("external: %lld states in %zu layers, %.3f s, %.0f states/s, %lld runs, %.1f MB written, %.1f MB read (%.0f MB/s), disk peak %.1f MB\n",
+			stats.states, stats.layerStates.size(), stats.seconds, stats.states / stats.seconds, stats.runs,
+			stats.bytesWritten / 1e6, stats.bytesRead / 1e6, (stats.bytesWritten + stats.bytesRead) / 1e6 / stats.seconds, stats.diskPeak / 1e6);
+	}
+
+	// What each action would run into from a few thousand states of the dense level, found by playing every action
+	// and undoing it like the solver does, then by MoxyMoveKernel on each instruction set this machine has.
+	// The player's step check on its own, made the way MoxySim makes it in hitSolidObjectPlayerMoving and playerPlaceUtil:
+	// one state and one action at a time, testing the layers in turn until one has something there. It's the rules' side of benchMoves.
+	MoxyMoveKernel::Outcome stepOutcome(const MoxySim &sim, const MoxySim::Action action)
+	{
+		using Outcome = MoxyMoveKernel::Outcome;
+		const MoxySim::simPlayer &player = sim.getState().player;
+		MoxySim::Facing facing = MoxySim::Facing::NEUTRAL;
+		switch (action)
+		{
+		case MoxySim::Action::MOVE_LEFT:
+			facing = MoxySim::Facing::LEFT;
+			break;
+		case MoxySim::Action::MOVE_RIGHT:
+			facing = MoxySim::Facing::RIGHT;
+			break;
+		case MoxySim::Action::MOVE_UP:
+			facing = MoxySim::Facing::UP;
+			break;
+		case MoxySim::Action::MOVE_DOWN:
+			facing = MoxySim::Facing::DOWN;
+			break;
+		case MoxySim::Action::PLACE_PUSHER_UTIL:
+			return player.heldUtilPushIndex.empty() ? Outcome::NOTHING_TO_PLACE : Outcome::PLACE;
+		case MoxySim::Action::PLACE_SUCKER_UTIL:
+			return player.heldUtilSuckIndex.empty() ? Outcome::NOTHING_TO_PLACE : Outcome::PLACE;
+		case MoxySim::Action::NONE:
+			return Outcome::NOTHING_TO_PLACE;
+		}
+
+		const MoxySim::simDirection &d = MoxySim::directions[int(facing)];
+		const int cell = MoxySim::cellIndex(MoxySim::simPoint{ player.pos.x + d.dx, player.pos.y + d.dy });
+		const MoxySim::simOccupancy &occupancy = sim.getOccupancy();
+		if (cell < 0)
+			return Outcome::OFF_GRID;
+		else if (occupancy.blocks.test(cell))
+			return Outcome::BLOCK;
+		else if (occupancy.hazards.test(cell))
+			return Outcome::HAZARD;
+		else if (occupancy.teleports.test(cell))
+			return Outcome::TELEPORT;
+		else if (occupancy.suckers.test(cell))
+			return Outcome::SUCKER;
+		else if (occupancy.pushers.test(cell))
+			return Outcome::PUSHER;
+		else if (occupancy.utils.test(cell))
+			return Outcome::TRAP;
+		else if (occupancy.gates.test(cell))
+			return player.heldKeys > 0 ? Outcome::GATE_OPENS : Outcome::GATE_SHUT;
+		else if (occupancy.keys.test(cell))
+			return Outcome::KEY;
+		else
+			return Outcome::WALK;
+	}
+
+	// MoxyMoveKernel against the rules, over the same states. Both sides only work out what each action runs into:
+	// the rules with stepOutcome on a MoxySim already in each state, the kernel on a batch. Copying the states into the batch
+	// is timed as well, since a caller starting from MoxySims pays for it. Every outcome is then checked for every ISA,
+	// against stepOutcome and against whether playerTurn really is BLOCKED.
+	void benchMoves()
+	{
+		const int statesTotal = 4096;
+		const int repeats = 50;
+		MoxySim::simLevel level = denseLevel();
+		level.turnsInitial = statesTotal * 2;
+		MoxySim sim(level);
+		std::mt19937 rng(12345);
+		std::uniform_int_distribution<int> pickAction(1, 6);
+
+		std::vector<MoxySim> sims;
+		sims.reserve(statesTotal);
+		for (int i = 0; i < statesTotal; i++)
+		{
+			sims.push_back(sim);
+			const MoxySim::TurnResult result = sim.playerTurn(static_cast<MoxySim::Action>(pickAction(rng)));
+			if (result == MoxySim::TurnResult::COMPLETE || result == MoxySim::TurnResult::FAILED)
+				sim.reset();
+		}
+
+		const auto bestOf = [](const auto &work) {
+			double secondsBest = 0;
+			for (int run = 0; run < benchRuns; run++)
+			{
+				const Clock::time_point start = Clock::now();
+				for (int repeat = 0; repeat < repeats; repeat++)
+					work();
+				const double seconds = secondsSince(start) / repeats;
+				if (run == 0 || seconds < secondsBest)
+					secondsBest = seconds;
+			}
+			return secondsBest;
+		};
+		const auto nsPerState = [&](const double seconds) { return seconds / statesTotal * 1e9; };
+
+		std::vector<MoxyMoveKernel::Outcome> rulesOutcomes(size_t(statesTotal) * MoxyMoveKernel::rowSize);
+		const double secondsRules = bestOf([&]() {
+			for (int i = 0; i < statesTotal; i++)
+			{
+				for (int a = 0; a < 6; a++)
+					rulesOutcomes[(size_t(i) * MoxyMoveKernel::rowSize) + a] = stepOutcome(sims[i], MoxySolver::actionsAll[a]);
+			}
+		});
+		long long blocked = 0;
+		for (int i = 0; i < statesTotal; i++)
+		{
+			for (int a = 0; a < 6; a++)
+				blocked += MoxyMoveKernel::isBlocked(rulesOutcomes[(size_t(i) * MoxyMoveKernel::rowSize) + a]) ? 1 : 0;
+		}
+		printf("moves: rules, %d states, %.1f ns a state (%lld of %d actions blocked)\n", statesTotal, nsPerState(secondsRules), blocked, statesTotal * 6);
+
+		MoxyMoveKernel::stateBatch batch(sim);
+		const auto copyIn = [&]() {
+			batch.clear();
+			for (const auto& state : sims)
+				batch.add(state);
+		};
+		const double secondsCopy = bestOf(copyIn);
+
+		// What playerTurn really does with each action, to check both sides against.
+		std::vector<bool> turnBlocked(size_t(statesTotal) * 6);
+		for (int i = 0; i < statesTotal; i++)
+		{
+			for (int a = 0; a < 6; a++)
+			{
+				MoxySim played = sims[i];
+				turnBlocked[(size_t(i) * 6) + a] = played.playerTurn(MoxySolver::actionsAll[a]) == MoxySim::TurnResult::BLOCKED;
+			}
+		}
+		long long rulesWrong = 0;
+		for (int i = 0; i < statesTotal; i++)
+		{
+			for (int a = 0; a < 6; a++)
+				rulesWrong += MoxyMoveKernel::isBlocked(rulesOutcomes[(size_t(i) * MoxyMoveKernel::rowSize) + a]) != turnBlocked[(size_t(i) * 6) + a] ? 1 : 0;
+		}
+		if (rulesWrong > 0)
+			printf("moves: rules, %lld of %d actions disagree with playerTurn\n", rulesWrong, statesTotal * 6);
+
+		std::vector<MoxyMoveKernel::Outcome> outcomes(size_t(statesTotal) * MoxyMoveKernel::rowSize);
+		const MoxyMoveKernel::Isa best = MoxyMoveKernel::bestIsa();
+		for (const MoxyMoveKernel::Isa isa : { MoxyMoveKernel::Isa::SCALAR, MoxyMoveKernel::Isa::SSE2, MoxyMoveKernel::Isa::AVX2 })
+		{
+			if (int(isa) > int(best))
+				break;
+			copyIn();
+			const double secondsKernel = bestOf([&]() { MoxyMoveKernel::evaluate(batch, outcomes.data(), isa); });
+
+			long long wrong = 0;
+			for (int i = 0; i < statesTotal; i++)
+			{
+				for (int a = 0; a < 6; a++)
+				{
+					const size_t at = (size_t(i) * MoxyMoveKernel::rowSize) + a;
+					if (outcomes[at] != rulesOutcomes[at] || MoxyMoveKernel::isBlocked(outcomes[at]) != turnBlocked[(size_t(i) * 6) + a])
+						wrong++;
+				}
+			}
+			printf("moves: kernel %s, %.1f ns a state, %.1f ns with copying in, %.1fx the rules (%.1fx with copying), %lld of %d actions wrong\n",
+				MoxyMoveKernel::isaName(isa), nsPerState(secondsKernel), nsPerState(secondsCopy + secondsKernel),
+				secondsRules / secondsKernel, secondsRules / (secondsCopy + secondsKernel), wrong, statesTotal * 6);
+		}
+	}
+
+	// A level file like the ones MoxyLevelGen writes, with random tokens in random squares.
+	std::string levelFileText(std::mt19937 &rng, const int number)
+	{
+		std::uniform_int_distribution<int> pickX(0, MoxySim::gridRowSize - 1);
+		std::uniform_int_distribution<int> pickY(0, MoxySim::gridColSize - 1);
+		std::uniform_int_distribution<int> pickCount(0, 12);
+		std::uniform_int_distribution<int> pickBound(0, 4);
+		const char* const facings[] = { "UP", "DOWN", "LEFT", "RIGHT" };
+
+		std::string text;
+		const auto append = [&](const char *part) { text += part; };
+		const auto appendInt = [&](const int value) { text += std::to_string(value); };
+		const auto appendPoint = [&]() {
+			append("(");
+			appendInt(pickX(rng));
+			append(",");
+			appendInt(pickY(rng));
+			append(")");
+		};
+		const auto appendPatrollers = [&](const char *tag, const char *type) {
+			append("::");
+			append(tag);
+			append("=");
+			for (int i = pickCount(rng) / 3; i > 0; i--)
+			{
+				append("(");
+				appendInt(pickX(rng));
+				append(",");
+				appendInt(pickY(rng));
+				append(",");
+				append(type);
+				append(",");
+				append(facings[rng() % 4]);
+				append(rng() % 2 ? ",VERTICAL," : ",HORIZONTAL,");
+				for (int bound = 0; bound < 4; bound++)
+				{
+					appendInt(pickBound(rng));
+					append(bound < 3 ? "," : ")");
+				}
+			}
+			append("::\r\n");
+		};
+
+		char id[32];
+		snprintf(id, sizeof(id), "Bench%08d", number);
+		append("::Id=");
+		append(id);
+		append("::CreatorName=MoxySimBench::LevelName=Bench level ");
+		appendInt(number);
+		append("::LevelDifficulty=");
+		appendInt(pickCount(rng) * 10);
+		append("::TurnsRemaining=");
+		appendInt(20 + pickCount(rng));
+		append("::GridUnits=Cell::\r\n");
+
+		const int gates = pickCount(rng) / 4;
+		append("::Gate=");
+		for (int i = 0; i < gates; i++)
+			appendPoint();
+		append("::Key=");
+		for (int i = 0; i < gates; i++)
+			appendPoint();
+		append("::\r\n::Player=");
+		appendInt(pickX(rng));
+		append(",");
+		appendInt(pickY(rng));
+		append("::\r\n");
+		appendPatrollers("Pusher", "PUSHER");
+		appendPatrollers("Sucker", "SUCKER");
+		append("::Util=");
+		for (int i = pickCount(rng) / 4; i > 0; i--)
+		{
+			append("(");
+			appendInt(pickX(rng));
+			append(",");
+			appendInt(pickY(rng));
+			append(rng() % 2 ? ",PUSHER,INACTIVE)" : ",SUCKER,INACTIVE)");
+		}
+		for (const char *tag : { "Block", "Hazard", "Teleport" })
+		{
+			append("::\r\n::");
+			append(tag);
+			append("=");
+			for (int i = (tag[0] == 'B' ? pickCount(rng) * 2 : pickCount(rng) / 4); i > 0; i--)
+				appendPoint();
+		}
+		append("::\r\n");
+		return text;
+	}
+
+	// Parses a few thousand level files held in memory, so it's the parser being timed and not the disk.
+	void benchLevelFile()
+	{
+		const int levelsTotal = 5000;
+		std::mt19937 rng(12345);
+		std::vector<std::string> texts;
+		size_t bytes = 0;
+		for (int i = 0; i < levelsTotal; i++)
+		{
+			texts.push_back(levelFileText(rng, i));
+			bytes += texts.back().size();
+		}
+
+		MoxyLevelFile::fileLevel level;
+		double secondsBest = 0;
+		long long tokens = 0;
+		int valid = 0;
+		for (int run = 0; run < benchRuns; run++)
+		{
+			tokens = 0;
+			valid = 0;
+			const Clock::time_point start = Clock::now();
+			for (const std::string& text : texts)
+			{
+				if (MoxyLevelFile::parse(text.data(), text.data() + text.size(), level))
+					valid++;
+				tokens += level.players.size() + level.pushers.size() + level.suckers.size() + level.blocks.size() + level.keys.size() +
+					level.gates.size() + level.hazards.size() + level.teleports.size() + level.utils.size();
+			}
+			const double seconds = secondsSince(start);
+			if (run == 0 || seconds < secondsBest)
+				secondsBest = seconds;
+		}
+
+		printf("levelfile: %d levels (%d valid), %.2f MB, %lld tokens in %.3f s, %.0f MB/s, %.0f levels/s\n",
+			levelsTotal, valid, bytes / 1e6, tokens, secondsBest, bytes / 1e6 / secondsBest, levelsTotal / secondsBest);
+	}
+
+#endif
+
+	struct benchEntry
+	{
+		const char *name;
+		void(*run)();
+	};
+	const benchEntry benches[] =
+	{
+		{ "turns", benchTurns },
+#ifndef MOXY_BENCH_TURNS_ONLY
+		{ "undo", benchUndo },
+		{ "solve", benchSolve },
+		{ "iterative", benchSolveIterative },
+		{ "parallel", benchSolveParallel },
+		{ "table", benchStateTable },
+		{ "lost", benchLost },
+		{ "danger", benchDanger },
+		{ "playout", benchPlayout },
+		{ "external", benchExternal },
+		{ "moves", benchMoves },
+		{ "levelfile", benchLevelFile },
+#endif
+	};
+}
+
+int main(int argc, char *argv[])
+{
+	for (const auto& bench : benches)
+	{
+		bool wanted = argc < 2;
+		for (int i = 1; i < argc; i++)
+		{
+			if (strcmp(argv[i], bench.name) == 0)
+				wanted = true;
+		}
+		if (wanted)
+			bench.run();
+	}
+	return 0;
+}
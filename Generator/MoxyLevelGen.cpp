@@ -0,0 +1,606 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Headless level generator. Makes up random levels, has MoxySolver prove each one can be won in the turns it gives,
+// and writes the ones that come out as hard as asked for, and aren't a copy of one it's already written, into a LevelData folder
+// as MoxyLvl files the game loads like any other. Like the benchmarks it only needs the Qt-free engine:
+//   g++ -O2 -std=c++14 -I../Moxybox MoxyLevelGen.cpp ../Moxybox/MoxySim.cpp ../Moxybox/MoxySolver.cpp ../Moxybox/MoxyStateTable.cpp -pthread -o MoxyLevelGen
+//   cl /O2 /EHsc /I..\Moxybox MoxyLevelGen.cpp ..\Moxybox\MoxySim.cpp ..\Moxybox\MoxySolver.cpp ..\Moxybox\MoxyStateTable.cpp
+// Usage: MoxyLevelGen <LevelData folder> [option value]...
+//   -count N        levels to write (default 20)
+//   -threads N      threads checking candidates (default all the machine has)
+//   -seed N         same seed and thread count, same levels (default 1)
+//   -par A-B        turns the best solution takes (default 8-30)
+//   -score A-B      MoxySolver::rate score (default 20-200)
+//   -slack N        turns given beyond par (default 2)
+//   -attempts N     candidates to try before giving up (default 1000000)
+//   -states N       states a check keeps before the candidate's thrown out as too big to prove (default 200000)
+//
+// The pipeline has two stages. Every thread but the caller's makes a candidate, solves it, cuts its turns down to par plus slack,
+// solves it again at that and rates it, over and over. Ones on target wait in a queue, a few per checker, and the caller's thread takes them
+// off in the order the checkers tried them (see orderedQueue), throws out copies and writes the rest. A full queue holds the checkers up
+// rather than growing, so no more than a few levels are ever waiting. Each check is bounded too (-states), so one huge candidate can't hold up a thread.
+
+#include "MoxySim.h"
+#include "MoxySolver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct genSettings
+	{
+		std::string folder;
+		int count = 20;
+		int threads = std::max(1, int(std::thread::hardware_concurrency()));
+		uint64_t seed = 1;
+		int parMin = 8;
+		int parMax = 30;
+		double scoreMin = 20;
+		double scoreMax = 200;
+		int slack = 2;
+		long long attemptsMax = 1000000;
+		long long maxStates = 200000;
+
+		// What a candidate is made of. Each count is picked evenly from 0 (1 for gates) up to its max.
+		// Turns start out generous so that solving finds par, then get cut down to par plus slack.
+		int turnsBudget = 40;
+		int gatesMax = 3;
+		int blocksMin = 10;
+		int blocksMax = 40;
+		int hazardsMax = 8;
+		int pushersMax = 3;
+		int suckersMax = 2;
+		int utilsMax = 3;
+		double teleportChance = 0.25;
+		int leashMax = 4;
+	};
+
+	// What happened to every candidate, for the report at the end.
+	struct genStats
+	{
+		std::atomic<long long> attempts{ 0 };
+		std::atomic<long long> unsolvable{ 0 };
+		std::atomic<long long> gaveUp{ 0 }; // Too big to prove either way within -states.
+		std::atomic<long long> offTarget{ 0 };
+		long long duplicates = 0; // Only touched by the writing thread.
+		long long accepted = 0;
+	};
+
+	struct candidateLevel
+	{
+		MoxySim::simLevel level;
+		MoxySolver::difficultyRating rating;
+		uint64_t key; // canonicalHash.
+	};
+
+	// --------------
+	// CANDIDATES
+	// --------------
+
+	int pick(std::mt19937_64 &random, const int low, const int high)
+	{
+		return std::uniform_int_distribution<int>(low, high)(random);
+	}
+
+	MoxySim::simLevel makeCandidate(const genSettings &settings, std::mt19937_64 &random)
+	{
+		// Squares are dealt from a shuffled deck, so no two tokens start on the same one.
+		std::vector<int> deck(MoxySim::gridCellCount);
+		std::iota(deck.begin(), deck.end(), 0);
+		std::shuffle(deck.begin(), deck.end(), random);
+		size_t dealt = 0;
+		const auto deal = [&]() {
+			const int cell = deck[dealt++];
+			return MoxySim::simPoint{ cell % MoxySim::gridRowSize, cell / MoxySim::gridRowSize };
+		};
+		const auto dealImmobiles = [&](std::vector<MoxySim::simImmobileDef> &list, const int count, const MoxySim::ImmobileType type) {
+			for (int i = 0; i < count; i++)
+				list.push_back(MoxySim::simImmobileDef{ deal(), type });
+		};
+
+		MoxySim::simLevel level;
+		level.turnsInitial = settings.turnsBudget;
+		level.player = deal();
+
+		const int gates = pick(random, 1, settings.gatesMax);
+		dealImmobiles(level.gates, gates, MoxySim::ImmobileType::GATE);
+		dealImmobiles(level.keys, gates, MoxySim::ImmobileType::KEY);
+		dealImmobiles(level.blocks, pick(random, settings.blocksMin, settings.blocksMax), MoxySim::ImmobileType::BLOCK);
+		dealImmobiles(level.hazards, pick(random, 0, settings.hazardsMax), MoxySim::ImmobileType::HAZARD);
+		if (std::uniform_real_distribution<double>(0, 1)(random) < settings.teleportChance)
+			dealImmobiles(level.teleports, 2, MoxySim::ImmobileType::TELEPORT);
+
+		// Leashes are squares either way along the patrol's line, cut short at the edge of the grid.
+		// A patroller with nowhere to go on its line still gets one square, toward whichever side has room.
+		const auto makePatroller = [&](const MoxySim::PatrollerType type) {
+			MoxySim::simPatrollerDef def{};
+			def.initial = deal();
+			def.type = type;
+			def.patrolDir = pick(random, 0, 1) == 0 ? MoxySim::PatrolDir::VERTICAL : MoxySim::PatrolDir::HORIZONTAL;
+			if (def.patrolDir == MoxySim::PatrolDir::VERTICAL)
+			{
+				def.facingInitial = pick(random, 0, 1) == 0 ? MoxySim::Facing::UP : MoxySim::Facing::DOWN;
+				def.patrolBoundUp = std::min(pick(random, 0, settings.leashMax), def.initial.y);
+				def.patrolBoundDown = std::min(pick(random, 0, settings.leashMax), MoxySim::gridColSize - 1 - def.initial.y);
+				if (def.patrolBoundUp + def.patrolBoundDown == 0)
+					(def.initial.y > 0 ? def.patrolBoundUp : def.patrolBoundDown) = 1;
+			}
+			else
+			{
+				def.facingInitial = pick(random, 0, 1) == 0 ? MoxySim::Facing::LEFT : MoxySim::Facing::RIGHT;
+				def.patrolBoundLeft = std::min(pick(random, 0, settings.leashMax), def.initial.x);
+				def.patrolBoundRight = std::min(pick(random, 0, settings.leashMax), MoxySim::gridRowSize - 1 - def.initial.x);
+				if (def.patrolBoundLeft + def.patrolBoundRight == 0)
+					(def.initial.x > 0 ? def.patrolBoundLeft : def.patrolBoundRight) = 1;
+			}
+			return def;
+		};
+		const int pushers = pick(random, 0, settings.pushersMax);
+		for (int i = 0; i < pushers; i++)
+			level.pushers.push_back(makePatroller(MoxySim::PatrollerType::PUSHER));
+		const int suckers = pick(random, 0, settings.suckersMax);
+		for (int i = 0; i < suckers; i++)
+			level.suckers.push_back(makePatroller(MoxySim::PatrollerType::SUCKER));
+
+		const int utils = pick(random, 0, settings.utilsMax);
+		for (int i = 0; i < utils; i++)
+			level.utils.push_back(MoxySim::simUtilDef{ deal(), pick(random, 0, 1) == 0 ? MoxySim::UtilType::PUSHER : MoxySim::UtilType::SUCKER, MoxySim::UtilState::INACTIVE });
+
+		return level;
+	}
+
+	// The level turned over left to right and/or top to bottom. It plays exactly the same, facings and leashes included.
+	MoxySim::simLevel mirrored(MoxySim::simLevel level, const bool flipX, const bool flipY)
+	{
+		const auto flip = [&](MoxySim::simPoint &pos) {
+			if (flipX)
+				pos.x = MoxySim::gridRowSize - 1 - pos.x;
+			if (flipY)
+				pos.y = MoxySim::gridColSize - 1 - pos.y;
+		};
+		const auto flipFacing = [&](const MoxySim::Facing facing) {
+			switch (facing)
+			{
+			case MoxySim::Facing::LEFT: return flipX ? MoxySim::Facing::RIGHT : facing;
+			case MoxySim::Facing::RIGHT: return flipX ? MoxySim::Facing::LEFT : facing;
+			case MoxySim::Facing::UP: return flipY ? MoxySim::Facing::DOWN : facing;
+			case MoxySim::Facing::DOWN: return flipY ? MoxySim::Facing::UP : facing;
+			default: return facing;
+			}
+		};
+
+		flip(level.player);
+		for (auto *patrollers : { &level.pushers, &level.suckers })
+		{
+			for (auto& def : *patrollers)
+			{
+				flip(def.initial);
+				def.facingInitial = flipFacing(def.facingInitial);
+				if (flipX)
+					std::swap(def.patrolBoundLeft, def.patrolBoundRight);
+				if (flipY)
+					std::swap(def.patrolBoundUp, def.patrolBoundDown);
+			}
+		}
+		for (auto *immobiles : { &level.blocks, &level.keys, &level.gates, &level.hazards, &level.teleports })
+		{
+			for (auto& def : *immobiles)
+				flip(def.initial);
+		}
+		for (auto& def : level.utils)
+			flip(def.initial);
+		return level;
+	}
+
+	// The same for a level and its mirror images, so a level turned over doesn't count as a new one.
+	uint64_t canonicalHash(const MoxySim::simLevel &level)
+	{
+		uint64_t key = MoxySim::getLevelHash(level);
+		key = std::min(key, MoxySim::getLevelHash(mirrored(level, true, false)));
+		key = std::min(key, MoxySim::getLevelHash(mirrored(level, false, true)));
+		key = std::min(key, MoxySim::getLevelHash(mirrored(level, true, true)));
+		return key;
+	}
+
+	// --------------
+	// CHECKING
+	// --------------
+
+	// Solves a candidate, fits its turns to par and checks it against the targets. Fills in accepted and returns true if it's on target.
+	bool checkCandidate(MoxySim::simLevel level, const genSettings &settings, genStats &stats, candidateLevel &accepted)
+	{
+		MoxySolver::solveLimits limits;
+		limits.maxStates = settings.maxStates;
+
+		MoxySolver::solveOutcome outcome = MoxySolver::solve(level, limits);
+		if (outcome.result == MoxySolver::Result::LIMIT_REACHED)
+		{
+			stats.gaveUp++;
+			return false;
+		}
+		if (outcome.result != MoxySolver::Result::SOLVED)
+		{
+			stats.unsolvable++;
+			return false;
+		}
+		if (outcome.turnsUsed < settings.parMin || outcome.turnsUsed > settings.parMax)
+		{
+			stats.offTarget++;
+			return false;
+		}
+
+		// Fewer turns can't make par any lower, and the same solution still fits, so this only ever tightens it.
+		// It's solved again at the new turns so the rating goes by the search the level as written takes.
+		if (outcome.turnsUsed + settings.slack < level.turnsInitial)
+		{
+			level.turnsInitial = outcome.turnsUsed + settings.slack;
+			outcome = MoxySolver::solve(level, limits);
+			if (outcome.result != MoxySolver::Result::SOLVED)
+			{
+				stats.gaveUp++;
+				return false;
+			}
+		}
+
+		const MoxySolver::difficultyRating rating = MoxySolver::rate(level, outcome);
+		if (rating.score < settings.scoreMin || rating.score > settings.scoreMax)
+		{
+			stats.offTarget++;
+			return false;
+		}
+
+		accepted.level = std::move(level);
+		accepted.rating = rating;
+		accepted.key = canonicalHash(accepted.level);
+		return true;
+	}
+
+	// --------------
+	// WRITING
+	// --------------
+
+	const char* facingName(const MoxySim::Facing facing)
+	{
+		switch (facing)
+		{
+		case MoxySim::Facing::UP: return "UP";
+		case MoxySim::Facing::DOWN: return "DOWN";
+		case MoxySim::Facing::LEFT: return "LEFT";
+		case MoxySim::Facing::RIGHT: return "RIGHT";
+		default: return "NEUTRAL";
+		}
+	}
+
+	// The level as a MoxyLvl file, in the layout GameplayScreen::dirIteratorLoadLevelData reads, in grid squares.
+	std::string toMoxyLvl(const candidateLevel &candidate, const std::string &id)
+	{
+		const MoxySim::simLevel& level = candidate.level;
+		std::ostringstream out;
+		const auto point = [&](const MoxySim::simPoint &pos) { out << "(" << pos.x << "," << pos.y << ")"; };
+		const auto immobiles = [&](const char *tag, const std::vector<MoxySim::simImmobileDef> &list) {
+			out << "::" << tag << "=";
+			for (const auto& def : list)
+				point(def.initial);
+		};
+		const auto patrollers = [&](const char *tag, const std::vector<MoxySim::simPatrollerDef> &list) {
+			out << "::" << tag << "=";
+			for (const auto& def : list)
+			{
+				out << "(" << def.initial.x << "," << def.initial.y << "," <<
+					(def.type == MoxySim::PatrollerType::PUSHER ? "PUSHER" : "SUCKER") << "," <<
+					facingName(def.facingInitial) << "," <<
+					(def.patrolDir == MoxySim::PatrolDir::VERTICAL ? "VERTICAL" : "HORIZONTAL") << "," <<
+					def.patrolBoundUp << "," << def.patrolBoundDown << "," << def.patrolBoundLeft << "," << def.patrolBoundRight << ")";
+			}
+			out << "::\r\n";
+		};
+
+		out << "::Id=" << id <<
+			"::CreatorName=MoxyLevelGen" <<
+			"::LevelName=Generated " << id.substr(id.size() - 4) <<
+			"::LevelDifficulty=" << int(candidate.rating.score + 0.5) <<
+			"::TurnsRemaining=" << level.turnsInitial <<
+			"::GridUnits=Cell::\r\n";
+
+		// Gates and keys have to share a line, for the loader to check there's one of each per pair.
+		immobiles("Gate", level.gates);
+		immobiles("Key", level.keys);
+		out << "::\r\n";
+
+		out << "::Player=" << level.player.x << "," << level.player.y << "::\r\n";
+		patrollers("Pusher", level.pushers);
+		patrollers("Sucker", level.suckers);
+
+		out << "::Util=";
+		for (const auto& def : level.utils)
+			out << "(" << def.initial.x << "," << def.initial.y << "," << (def.type == MoxySim::UtilType::PUSHER ? "PUSHER" : "SUCKER") << ",INACTIVE)";
+		out << "::\r\n";
+
+		immobiles("Block", level.blocks);
+		out << "::\r\n";
+		immobiles("Hazard", level.hazards);
+		out << "::\r\n";
+		immobiles("Teleport", level.teleports);
+		out << "::\r\n";
+		return out.str();
+	}
+
+	// Writes the level unless a file by its name is there already (from an earlier run), which makes it a copy.
+	bool writeLevel(const genSettings &settings, const candidateLevel &candidate)
+	{
+		char id[32];
+		snprintf(id, sizeof(id), "Gen%016llX", (unsigned long long)candidate.key);
+		const std::string path = settings.folder + "/" + id + ".MoxyLvl";
+		if (std::ifstream(path).good())
+			return false;
+
+		std::ofstream file(path, std::ios::binary);
+		file << toMoxyLvl(candidate, id);
+		if (!file)
+		{
+			fprintf(stderr, "Couldn't write %s\n", path.c_str());
+			exit(1);
+		}
+		printf("%s  par %d  turns %d  score %.1f  branching %.2f  traps %d\n", path.c_str(),
+			candidate.rating.par, candidate.level.turnsInitial, candidate.rating.score, candidate.rating.branching, candidate.rating.trapUses);
+		return true;
+	}
+
+	// --------------
+	// PIPELINE
+	// --------------
+
+	// Candidates on target, waiting to be written. Each checker numbers its attempts from 0, and the writer is handed candidates
+	// in order of attempt, then checker: attempt a of every checker comes before attempt a + 1 of any. When a checker still working on
+	// an attempt would come first, the writer waits for it, so which levels are written (and which are thrown out as copies) only
+	// depends on the seed and how many checkers there are, never on which thread finishes first.
+	// Each checker has a lane of its own holding a few at most, and waits while its lane is full.
+	class orderedQueue
+	{
+	public:
+		orderedQueue(const int checkers, const size_t newCapacity) : capacity(newCapacity), lanes(checkers) {}
+
+		// The checker's about to try its attempt'th candidate, so nothing it pushes from now on comes before that.
+		void starting(const int checker, const long long attempt)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			lanes[checker].attempt = attempt;
+			changed.notify_all();
+		}
+
+		// The candidate from the attempt the checker last started. False if the queue was closed, in which case the level's dropped.
+		bool push(const int checker, candidateLevel &&candidate)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			lane& own = lanes[checker];
+			changed.wait(lock, [&]() { return closed || own.items.size() < capacity; });
+			if (closed)
+				return false;
+			own.items.push_back(numberedLevel{ own.attempt, std::move(candidate) });
+			changed.notify_all();
+			return true;
+		}
+
+		// False once every checker has finished and nothing's left.
+		bool pop(candidateLevel &candidate)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			int next = -1;
+			changed.wait(lock, [&]() {
+				next = nextLane();
+				return next >= 0 || allFinished();
+			});
+			if (next < 0)
+				return false;
+			candidate = std::move(lanes[next].items.front().candidate);
+			lanes[next].items.pop_front();
+			changed.notify_all();
+			return true;
+		}
+
+		void finished(const int checker)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			lanes[checker].finished = true;
+			changed.notify_all();
+		}
+
+		void close()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+			changed.notify_all();
+		}
+
+		bool isClosed()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return closed;
+		}
+
+	private:
+		struct numberedLevel
+		{
+			long long attempt;
+			candidateLevel candidate;
+		};
+		struct lane
+		{
+			std::deque<numberedLevel> items;
+			long long attempt = 0; // The one it's trying now.
+			bool finished = false;
+		};
+
+		// The lane holding the next candidate in order, or -1 if that candidate isn't there yet (or never will be).
+		// A lane with nothing waiting could still push one from the attempt it's on, so it counts as that attempt.
+		int nextLane() const
+		{
+			int best = -1;
+			long long bestAttempt = 0;
+			const int laneCount = lanes.size();
+			for (int i = 0; i < laneCount; i++)
+			{
+				if (lanes[i].items.empty() && lanes[i].finished)
+					continue;
+				const long long attempt = lanes[i].items.empty() ? lanes[i].attempt : lanes[i].items.front().attempt;
+				if (best < 0 || attempt < bestAttempt)
+				{
+					best = i;
+					bestAttempt = attempt;
+				}
+			}
+			return best >= 0 && !lanes[best].items.empty() ? best : -1;
+		}
+
+		bool allFinished() const
+		{
+			for (const auto& l : lanes)
+			{
+				if (!l.finished || !l.items.empty())
+					return false;
+			}
+			return true;
+		}
+
+		const size_t capacity;
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::vector<lane> lanes;
+		bool closed = false;
+	};
+
+	void checkerThread(const genSettings &settings, const int index, const long long attemptsShare, genStats &stats, orderedQueue &queue)
+	{
+		std::mt19937_64 random(settings.seed * 0x9E3779B97F4A7C15ull + uint64_t(index));
+		for (long long attempt = 0; attempt < attemptsShare && !queue.isClosed(); attempt++)
+		{
+			queue.starting(index, attempt);
+			stats.attempts++;
+			candidateLevel candidate;
+			if (checkCandidate(makeCandidate(settings, random), settings, stats, candidate) && !queue.push(index, std::move(candidate)))
+				break;
+		}
+		queue.finished(index);
+	}
+
+	bool parseRange(const char *text, int &low, int &high)
+	{
+		return sscanf(text, "%d-%d", &low, &high) == 2 && low <= high;
+	}
+
+	bool parseRange(const char *text, double &low, double &high)
+	{
+		return sscanf(text, "%lf-%lf", &low, &high) == 2 && low <= high;
+	}
+
+	bool parseArgs(const int argc, char *argv[], genSettings &settings)
+	{
+		if (argc < 2 || argv[1][0] == '-')
+			return false;
+		settings.folder = argv[1];
+		for (int i = 2; i + 1 < argc; i += 2)
+		{
+			const char* name = argv[i];
+			const char* value = argv[i + 1];
+			bool ok = true;
+			if (strcmp(name, "-count") == 0)
+				ok = (settings.count = atoi(value)) > 0;
+			else if (strcmp(name, "-threads") == 0)
+				ok = (settings.threads = atoi(value)) > 0;
+			else if (strcmp(name, "-seed") == 0)
+				settings.seed = strtoull(value, nullptr, 10);
+			else if (strcmp(name, "-par") == 0)
+				ok = parseRange(value, settings.parMin, settings.parMax);
+			else if (strcmp(name, "-score") == 0)
+				ok = parseRange(value, settings.scoreMin, settings.scoreMax);
+			else if (strcmp(name, "-slack") == 0)
+				ok = (settings.slack = atoi(value)) >= 0;
+			else if (strcmp(name, "-attempts") == 0)
+				ok = (settings.attemptsMax = atoll(value)) > 0;
+			else if (strcmp(name, "-states") == 0)
+				ok = (settings.maxStates = atoll(value)) > 0;
+			else
+				ok = false;
+			if (!ok)
+			{
+				fprintf(stderr, "Bad option %s %s\n", name, value);
+				return false;
+			}
+		}
+		return (argc % 2) == 0;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	genSettings settings;
+	if (!parseArgs(argc, argv, settings))
+	{
+		fprintf(stderr, "Usage: MoxyLevelGen <LevelData folder> [-count N] [-threads N] [-seed N] [-par A-B] [-score A-B] [-slack N] [-attempts N] [-states N]\n");
+		return 2;
+	}
+
+	// The caller's thread writes, so checking gets the rest, but always at least one.
+	const int checkers = std::max(1, settings.threads - 1);
+	const auto startTime = Clock::now();
+	genStats stats;
+	orderedQueue queue(checkers, 2);
+
+	// Attempts are shared out up front rather than taken from a common count, so each checker tries the same candidates every run.
+	std::vector<std::thread> pool;
+	for (int i = 0; i < checkers; i++)
+	{
+		const long long share = (settings.attemptsMax / checkers) + (i < settings.attemptsMax % checkers ? 1 : 0);
+		pool.emplace_back(checkerThread, std::cref(settings), i, share, std::ref(stats), std::ref(queue));
+	}
+
+	// Copies are caught here, where there's only one thread to keep track of what's been written.
+	std::unordered_set<uint64_t> written;
+	candidateLevel candidate;
+	while (stats.accepted < settings.count && queue.pop(candidate))
+	{
+		if (!written.insert(candidate.key).second || !writeLevel(settings, candidate))
+			stats.duplicates++;
+		else
+			stats.accepted++;
+	}
+	queue.close();
+	for (auto& thread : pool)
+		thread.join();
+
+	const double seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+	printf("\n%lld written of %lld tried in %.1f s with %d checking threads: %.1f levels/min\n",
+		stats.accepted, stats.attempts.load(), seconds, checkers, stats.accepted * 60.0 / seconds);
+	printf("thrown out: %lld unsolvable, %lld too big to prove, %lld off target, %lld copies\n",
+		stats.unsolvable.load(), stats.gaveUp.load(), stats.offTarget.load(), stats.duplicates);
+	return stats.accepted < settings.count ? 1 : 0;
+}
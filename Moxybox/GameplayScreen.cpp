@@ -77,7 +77,39 @@ GameplayScreen::GameplayScreen(QWidget *parent)
 		)
 	);
 
+	// The first column is full, so undo/redo start a second one.
+	keybindMap.insert(std::pair<KeybindModifiable, keybindComponent>(
+		KeybindModifiable::UNDO,
+		keybindComponent{ "Undo", Qt::Key::Key_Z, 0, 2, 0, 3, Qt::AlignLeft | Qt::AlignTop }
+		)
+	);
+
+	keybindMap.insert(std::pair<KeybindModifiable, keybindComponent>(
+		KeybindModifiable::REDO,
+		keybindComponent{ "Redo", Qt::Key::Key_X, 1, 2, 1, 3, Qt::AlignLeft | Qt::AlignTop }
+		)
+	);
+
+	keybindMap.insert(std::pair<KeybindModifiable, keybindComponent>(
+		KeybindModifiable::HINT,
+		keybindComponent{ "Hint", Qt::Key::Key_H, 2, 2, 2, 3, Qt::AlignLeft | Qt::AlignTop }
+		)
+	);
+
+	keybindMap.insert(std::pair<KeybindModifiable, keybindComponent>(
+		KeybindModifiable::TOGGLE_DANGER_MAP,
+		keybindComponent{ "Danger Map", Qt::Key::Key_M, 3, 2, 3, 3, Qt::AlignLeft | Qt::AlignTop }
+		)
+	);
+
 	prefLoad();
+	rebuildKeyActionTable();
+	dangerMap.setHorizon(dangerHorizon);
+
+	connect(keyRepeatTimer.get(), &QTimer::timeout, this, &GameplayScreen::keyRepeatTimeout);
+	connect(hintEngine.get(), &MoxyHintEngine::hintReady, this, &GameplayScreen::hintReceived, Qt::QueuedConnection);
+	connect(this, &GameplayScreen::reportReady, this, &GameplayScreen::reportReceived, Qt::QueuedConnection);
+	latencyClock.start();
 
 	if (firstTimeSetup)
 	{
@@ -94,6 +126,7 @@ GameplayScreen::GameplayScreen(QWidget *parent)
 		if (!dirThemeMods.exists())
 			dirThemeMods.mkpath(".");
 	}
+	analysisCache = std::make_unique<MoxyAnalysisCache>(windowsHomePath + "/" + analysisCacheFileName);
 
 	setStyleSheet(styleMap.at("baseStyle"));
 	setAlignment(Qt::AlignTop | Qt::AlignLeft);
@@ -386,6 +419,19 @@ GameplayScreen::GameplayScreen(QWidget *parent)
 		scene.get()->addItem(piece.item.get());
 	}
 
+	// One tint per grid square for the danger overlay, in the same order as MoxySim cells (row by row), hidden until needed.
+	for (const auto& piece : gridPiecesAll)
+	{
+		auto item = std::make_unique<QGraphicsRectItem>(0, 0, gridPieceSize, gridPieceSize);
+		item.get()->setPos(piece.pos);
+		item.get()->setPen(QPen(Qt::NoPen));
+		item.get()->setZValue(dangerOverlayZ);
+		item.get()->setVisible(false);
+		scene.get()->addItem(item.get());
+		dangerOverlayItems.emplace_back(std::move(item));
+	}
+	dangerOverlaySoonest.assign(dangerOverlayItems.size(), 0);
+
 	dirIteratorLoadLevelData(levelDataPath);
 
 	// After loading level data through the main expected area, we also look for any level data coming
@@ -402,6 +448,8 @@ GameplayScreen::GameplayScreen(QWidget *parent)
 	std::sort(levelsAll.begin(), levelsAll.end(), [&](const levelData &lhs, const levelData &rhs) {
 		return lhs.difficulty < rhs.difficulty;
 	});
+	if (orderByRating)
+		levelsOrderByRating();
 
 	// Initialize base parameters for each level.
 	// These are the default states that components get loaded in when a level is first loaded.
@@ -412,7 +460,6 @@ GameplayScreen::GameplayScreen(QWidget *parent)
 
 	addCurrentLevelToScene();
 
-	levelsAll[levelCurrent].players[pIndex].heldKeys = 0;
 	levelsFound = levelsAll.size();
 	levelsRemaining = levelsFound;
 
@@ -421,8 +468,60 @@ GameplayScreen::GameplayScreen(QWidget *parent)
 	turnOwner = TurnOwner::PLAYER;
 }
 
+GameplayScreen::~GameplayScreen()
+{
+	ratingCancel.store(true);
+	reportCancel.store(true);
+	if (ratingWorker.joinable())
+		ratingWorker.join();
+	if (reportWorker.joinable())
+		reportWorker.join();
+}
+
 // protected:
 
+void GameplayScreen::keyPressEvent(QKeyEvent *event)
+{
+	// Any key stops a debug report that's still being worked out.
+	if (!event->isAutoRepeat())
+		reportCancel.store(true);
+
+	// Only moves and undo/redo act on key press. Everything else (menu, level transitions, rebinding) stays on key release.
+	const KeyAction action = keyToAction(event->key());
+	const bool isUndoRedo = action == KeyAction::UNDO || action == KeyAction::REDO;
+	if (!inputOnKeyPress || gameState != GameState::PLAYING || !(keyActionIsMove(action) || isUndoRedo))
+	{
+		QGraphicsView::keyPressEvent(event);
+		return;
+	}
+
+	// OS auto-repeat is ignored, held keys repeat off our own timer instead.
+	if (event->isAutoRepeat())
+		return;
+
+	if (isUndoRedo)
+	{
+		if (turnOwner == TurnOwner::PLAYER)
+		{
+			latencyRecordInput();
+			playerUndo(action == KeyAction::REDO);
+		}
+		return;
+	}
+
+	if (turnOwner == TurnOwner::PLAYER)
+	{
+		latencyRecordInput();
+		playerTurn(keyActionToSimAction(action));
+	}
+
+	if (keyRepeatInterval > 0)
+	{
+		keyRepeatHeld = event->key();
+		keyRepeatTimer.get()->start(keyRepeatDelay);
+	}
+}
+
 void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 {
 	if (event->isAutoRepeat())
@@ -431,6 +530,9 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 	}
 	else
 	{
+		if (event->key() == keyRepeatHeld)
+			keyRepeatStop();
+
 		if (gameState == GameState::TITLE)
 		{
 			scene.get()->removeItem(splashItem.get());
@@ -440,170 +542,43 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 		}
 		else if (gameState == GameState::PLAYING)
 		{
-			if (event->key() == keybindMap.at(KeybindModifiable::MOVE_LEFT).keybind
-				|| event->key() == keybindMap.at(KeybindModifiable::MOVE_RIGHT).keybind
-				|| event->key() == keybindMap.at(KeybindModifiable::MOVE_UP).keybind
-				|| event->key() == keybindMap.at(KeybindModifiable::MOVE_DOWN).keybind)
+			const KeyAction action = keyToAction(event->key());
+			if (action == KeyAction::MOVE_LEFT
+				|| action == KeyAction::MOVE_RIGHT
+				|| action == KeyAction::MOVE_UP
+				|| action == KeyAction::MOVE_DOWN
+				|| action == KeyAction::PLACE_PUSHER_UTIL
+				|| action == KeyAction::PLACE_SUCKER_UTIL)
 			{
-				if (turnOwner == TurnOwner::PLAYER)
+				// With input on key press, the move already happened when the key went down.
+				if (!inputOnKeyPress && turnOwner == TurnOwner::PLAYER)
 				{
-					uiGameplayMessagesTextBox.get()->setText("");
-
-					if (event->key() == keybindMap.at(KeybindModifiable::MOVE_LEFT).keybind)
-						levelsAll[levelCurrent].players[pIndex].facing = tokenPlayer::Facing::LEFT;
-					else if (event->key() == keybindMap.at(KeybindModifiable::MOVE_RIGHT).keybind)
-						levelsAll[levelCurrent].players[pIndex].facing = tokenPlayer::Facing::RIGHT;
-					else if (event->key() == keybindMap.at(KeybindModifiable::MOVE_UP).keybind)
-						levelsAll[levelCurrent].players[pIndex].facing = tokenPlayer::Facing::UP;
-					else if (event->key() == keybindMap.at(KeybindModifiable::MOVE_DOWN).keybind)
-						levelsAll[levelCurrent].players[pIndex].facing = tokenPlayer::Facing::DOWN;
-
-					if (!hitSolidObjectPlayerMoving())
-					{
-						const auto& pItem = levelsAll[levelCurrent].players[pIndex].item.get();
-						switch (levelsAll[levelCurrent].players[pIndex].facing)
-						{
-						case (tokenPlayer::Facing::LEFT):
-							levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-							(
-								pItem->x() - (gridPieceSize * levelsAll[levelCurrent].players[pIndex].movementSpeed),
-								pItem->y()
-							);
-							break;
-						case (tokenPlayer::Facing::RIGHT):
-							levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-							(
-								pItem->x() + (gridPieceSize * levelsAll[levelCurrent].players[pIndex].movementSpeed),
-								pItem->y()
-							);
-							break;
-						case (tokenPlayer::Facing::UP):
-							levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-							(
-								pItem->x(),
-								pItem->y() - (gridPieceSize * levelsAll[levelCurrent].players[pIndex].movementSpeed)
-							);
-							break;
-						case (tokenPlayer::Facing::DOWN):
-							levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-							(
-								pItem->x(),
-								pItem->y() + (gridPieceSize * levelsAll[levelCurrent].players[pIndex].movementSpeed)
-							);
-							break;
-						}
-						levelsAll[levelCurrent].players[pIndex].item.get()->setPixmap
-						(
-							facingToImg(levelsAll[levelCurrent].players[pIndex].facing)
-						);
-						levelsAll[levelCurrent].turnsRemaining--;
-						uiGameplayUpdateStatCounter(StatCounterType::TURNS_REMAINING);
-						teleportHitCheck();
-						turnOwner = TurnOwner::PATROLLER;
-					}
-
-					if (turnOwner == TurnOwner::PATROLLER)
-					{
-						updatePositionPatrollers();
-						suckInRange();
-
-						if (allGatesOpened())
-						{
-							turnOwner = TurnOwner::NONE;
-							levelSetComplete();
-						}
-						else if (levelsAll[levelCurrent].turnsRemaining <= 0)
-						{
-							turnOwner = TurnOwner::NONE;
-							levelSetFailed();
-						}
-						else
-							turnOwner = TurnOwner::PLAYER;
-					}
+					latencyRecordInput();
+					playerTurn(keyActionToSimAction(action));
+				}
+			}
+			else if (action == KeyAction::UNDO || action == KeyAction::REDO)
+			{
+				if (!inputOnKeyPress && turnOwner == TurnOwner::PLAYER)
+				{
+					latencyRecordInput();
+					playerUndo(action == KeyAction::REDO);
 				}
 			}
-			else if (event->key() == keybindMap.at(KeybindModifiable::PLACE_PUSHER_UTIL).keybind ||
-				event->key() == keybindMap.at(KeybindModifiable::PLACE_SUCKER_UTIL).keybind)
+			else if (action == KeyAction::TOGGLE_DANGER_MAP)
+			{
+				dangerOverlayShown = !dangerOverlayShown;
+				syncDangerOverlay();
+			}
+			else if (action == KeyAction::HINT)
 			{
 				if (turnOwner == TurnOwner::PLAYER)
 				{
-					uiGameplayMessagesTextBox.get()->setText("");
-
-					auto& pushI = levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex;
-					auto& suckI = levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex;
-
-					if (event->key() == keybindMap.at(KeybindModifiable::PLACE_PUSHER_UTIL).keybind 
-						&& pushI.size() > 0)
-					{
-						levelsAll[levelCurrent].utils[pushI[0]].item.get()->setPos
-						(
-							levelsAll[levelCurrent].players[pIndex].item.get()->x(),
-							levelsAll[levelCurrent].players[pIndex].item.get()->y()
-						);
-						levelsAll[levelCurrent].utils[pushI[0]].stateModified = tokenUtil::State::ACTIVE;
-						levelsAll[levelCurrent].utils[pushI[0]].item.get()->setPixmap
-						(
-							stateToImg(levelsAll[levelCurrent].utils[pushI[0]].stateModified, levelsAll[levelCurrent].utils[pushI[0]].type)
-						);
-						pushI.erase(pushI.begin() + 0);
-						uiGameplayUpdateStatCounter(StatCounterType::TRAPS_PUSHERS);
-						uiGameplayMessagesTextBox->setText(uiGameplayMessagesTrapPusherDeployed);
-
-						levelsAll[levelCurrent].players[pIndex].facing = tokenPlayer::Facing::NEUTRAL;
-						levelsAll[levelCurrent].players[pIndex].item.get()->setPixmap
-						(
-							facingToImg(levelsAll[levelCurrent].players[pIndex].facing)
-						);
-
-						turnOwner = TurnOwner::PATROLLER;
-					}
-					else if (event->key() == keybindMap.at(KeybindModifiable::PLACE_SUCKER_UTIL).keybind 
-						&& suckI.size() > 0)
-					{
-						levelsAll[levelCurrent].utils[suckI[0]].item.get()->setPos
-						(
-							levelsAll[levelCurrent].players[pIndex].item.get()->x(),
-							levelsAll[levelCurrent].players[pIndex].item.get()->y()
-						);
-						levelsAll[levelCurrent].utils[suckI[0]].stateModified = tokenUtil::State::ACTIVE;
-						levelsAll[levelCurrent].utils[suckI[0]].item.get()->setPixmap
-						(
-							stateToImg(levelsAll[levelCurrent].utils[suckI[0]].stateModified, levelsAll[levelCurrent].utils[suckI[0]].type)
-						);
-						suckI.erase(suckI.begin() + 0);
-						uiGameplayUpdateStatCounter(StatCounterType::TRAPS_SUCKERS);
-						uiGameplayMessagesTextBox->setText(uiGameplayMessagesTrapSuckerDeployed);
-
-						levelsAll[levelCurrent].players[pIndex].facing = tokenPlayer::Facing::NEUTRAL;
-						levelsAll[levelCurrent].players[pIndex].item.get()->setPixmap
-						(
-							facingToImg(levelsAll[levelCurrent].players[pIndex].facing)
-						);
-
-						turnOwner = TurnOwner::PATROLLER;
-					}
-
-					if (turnOwner == TurnOwner::PATROLLER)
-					{
-						updatePositionPatrollers();
-						suckInRange();
-
-						if (allGatesOpened())
-						{
-							turnOwner = TurnOwner::NONE;
-							levelSetComplete();
-						}
-						else if (levelsAll[levelCurrent].turnsRemaining <= 0)
-						{
-							turnOwner = TurnOwner::NONE;
-							levelSetFailed();
-						}
-						else
-							turnOwner = TurnOwner::PLAYER;
-					}
+					hintWanted = true;
+					hintShow();
 				}
 			}
-			else if (event->key() == keybindMap.at(KeybindModifiable::OPEN_MENU).keybind)
+			else if (action == KeyAction::OPEN_MENU)
 			{
 				if (turnOwner == TurnOwner::PLAYER)
 				{
@@ -611,11 +586,29 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 					uiMenuGroup.get()->setVisible(true);
 				}
 			}
-			else if (event->key() == keybindSkipLevel_DEBUG)
+			else if (action == KeyAction::SKIP_LEVEL_DEBUG)
 			{
 				levelSetComplete();
 			}
-			else if (event->key() == keybindLoadLevelByName_DEBUG)
+			else if (action == KeyAction::LATENCY_REPORT_DEBUG)
+			{
+				qDebug() << "**DEBUG** " + latencyReport();
+			}
+			else if (action == KeyAction::SOLVE_LEVEL_DEBUG)
+			{
+				const QString levelId = levelsAll[levelCurrent].id;
+				const MoxySim::simLevel simLevel = levelToSim(levelsAll[levelCurrent]);
+				qDebug() << "**DEBUG** Solving " + levelId + " in the background. Any key cancels.";
+				reportStart([this, levelId, simLevel]() { return solveReport(levelId, simLevel); });
+			}
+			else if (action == KeyAction::PLAYOUT_LEVEL_DEBUG)
+			{
+				const QString levelId = levelsAll[levelCurrent].id;
+				const MoxySim::simLevel simLevel = levelToSim(levelsAll[levelCurrent]);
+				qDebug() << "**DEBUG** Playing " + levelId + " in the background. Any key cancels.";
+				reportStart([this, levelId, simLevel]() { return playoutReport(levelId, simLevel); });
+			}
+			else if (action == KeyAction::LOAD_LEVEL_BY_NAME_DEBUG)
 			{
 				QStringList levelNames;
 				for (const auto& level : levelsAll)
@@ -645,8 +638,6 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 					// What matters most is the jumping to functionally works to enable quick testing.
 					levelSetComplete();
 
-					levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.clear();
-					levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.clear();
 					removeCurrentLevelFromScene();
 					levelCurrent = levelNames.indexOf(level);
 					addCurrentLevelToScene();
@@ -662,7 +653,7 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 		}
 		else if (gameState == GameState::PAUSED)
 		{
-			if (event->key() == keybindMap.at(KeybindModifiable::OPEN_MENU).keybind)
+			if (keyToAction(event->key()) == KeyAction::OPEN_MENU)
 			{
 				uiMenuResumePlay();
 			}
@@ -671,62 +662,18 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 		{
 			Qt::Key newKeybind = Qt::Key(event->key());
 
-			if (newKeybind == keybindMap.at(KeybindModifiable::MOVE_LEFT).keybind ||
-				newKeybind == keybindMap.at(KeybindModifiable::MOVE_RIGHT).keybind ||
-				newKeybind == keybindMap.at(KeybindModifiable::MOVE_UP).keybind ||
-				newKeybind == keybindMap.at(KeybindModifiable::MOVE_DOWN).keybind ||
-				newKeybind == keybindMap.at(KeybindModifiable::PLACE_PUSHER_UTIL).keybind ||
-				newKeybind == keybindMap.at(KeybindModifiable::PLACE_SUCKER_UTIL).keybind ||
-				newKeybind == keybindMap.at(KeybindModifiable::OPEN_MENU).keybind ||
-				newKeybind == keybindNextLevel ||
-				newKeybind == keybindResetLevel ||
-				newKeybind == keybindSkipLevel_DEBUG ||
-				newKeybind == keybindLoadLevelByName_DEBUG)
+			const KeyAction boundAction = keyToAction(newKeybind);
+			if (boundAction != KeyAction::NONE)
 			{
-				// Logic here is a bit redundant. Could maybe be improved.
-
 				QMessageBox qMsg(this->parentWidget());
 				qMsg.setStyleSheet(styleMap.at("uiMessageBoxStyle"));
 				qMsg.setWindowTitle("Keybind In Use");
+				qMsg.setText("\"" + QKeySequence(newKeybind).toString() + "\" is already bound to the \"" + keyActionLabel(boundAction) + "\" command.");
 				qMsg.setStandardButtons(QMessageBox::Ok);
 				qMsg.setDefaultButton(QMessageBox::Ok);
 				qMsg.setFont(uiGameplayFontTextBox);
 				qMsg.button(QMessageBox::Ok)->setFont(uiGameplayFontTextBox);
-
-				for (const auto& k : keybindMap)
-				{
-					if (newKeybind == k.second.keybind)
-					{
-						qMsg.setText("\"" + QKeySequence(newKeybind).toString() + "\" is already bound to the \"" + k.second.labelText + "\" command.");
-						qMsg.exec();
-						return;
-					}
-				}
-
-				if (newKeybind == keybindNextLevel)
-				{
-					qMsg.setText("\"" + QKeySequence(newKeybind).toString() + "\" is already bound to the \"" + "Next Level" + "\" command.");
-					qMsg.exec();
-					return;
-				}
-				else if (newKeybind == keybindResetLevel)
-				{
-					qMsg.setText("\"" + QKeySequence(newKeybind).toString() + "\" is already bound to the \"" + "Reset Level" + "\" command.");
-					qMsg.exec();
-					return;
-				}
-				else if (newKeybind == keybindSkipLevel_DEBUG)
-				{
-					qMsg.setText("\"" + QKeySequence(newKeybind).toString() + "\" is already bound to the \"" + "Skip Level DEBUG" + "\" command.");
-					qMsg.exec();
-					return;
-				}
-				else if (newKeybind == keybindLoadLevelByName_DEBUG)
-				{
-					qMsg.setText("\"" + QKeySequence(newKeybind).toString() + "\" is already bound to the \"" + "Jump To Level DEBUG" + "\" command.");
-					qMsg.exec();
-					return;
-				}
+				qMsg.exec();
 			}
 			else if (newKeybind == Qt::Key_Control || newKeybind == Qt::Key_Shift)
 			{
@@ -743,6 +690,7 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 			else
 			{
 				keybindMap.at(keybindToModify).keybind = newKeybind;
+				rebuildKeyActionTable();
 				keybindMap.at(keybindToModify).uiButton.get()->setStyleSheet(styleMap.at("uiGameplayKeymapBtnStyle"));
 				keybindMap.at(keybindToModify).uiButton.get()->setText(QKeySequence(keybindMap.at(keybindToModify).keybind).toString());
 				uiGameplayKeymapGroup.get()->setTitle(uiGameplayKeymapGroupTitleDefault);
@@ -752,10 +700,8 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 		}
 		else if (gameState == GameState::LEVEL_COMPLETE)
 		{
-			if (event->key() == keybindNextLevel)
+			if (keyToAction(event->key()) == KeyAction::NEXT_LEVEL)
 			{
-				levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.clear();
-				levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.clear();
 				removeCurrentLevelFromScene();
 				levelCurrent++;
 
@@ -774,6 +720,7 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 				qDebug() << "**DEBUG** Current Level Id: " + levelsAll[levelCurrent].id;
 
 				addCurrentLevelToScene();
+				levelSetToDefaults(levelsAll[levelCurrent]);
 				scene.get()->removeItem(splashItem.get());
 				uiGameplaySetToDefaults();
 				uiGameplayGroup->setVisible(true);
@@ -784,7 +731,7 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 		}
 		else if (gameState == GameState::LEVEL_FAILED)
 		{
-			if (event->key() == keybindResetLevel)
+			if (keyToAction(event->key()) == KeyAction::RESET_LEVEL)
 			{
 				levelSetToDefaults(levelsAll[levelCurrent]);
 				scene.get()->removeItem(splashItem.get());
@@ -797,6 +744,468 @@ void GameplayScreen::keyReleaseEvent(QKeyEvent *event)
 	}
 }
 
+void GameplayScreen::focusOutEvent(QFocusEvent *event)
+{
+	// A key let go while we don't have focus never sends us a release, so a held repeat has to end here.
+	keyRepeatStop();
+	QGraphicsView::focusOutEvent(event);
+}
+
+void GameplayScreen::paintEvent(QPaintEvent *event)
+{
+	QGraphicsView::paintEvent(event);
+
+	if (latencyInputStamp >= 0)
+	{
+		const qint64 latency = latencyClock.nsecsElapsed() - latencyInputStamp;
+		if (latencySamples.size() < latencySampleMax)
+			latencySamples.push_back(latency);
+		else
+			latencySamples[latencySampleNext] = latency;
+		latencySampleNext = (latencySampleNext + 1) % latencySampleMax;
+		latencyInputStamp = -1;
+	}
+}
+
+void GameplayScreen::rebuildKeyActionTable()
+{
+	// Fixed keys go in first, and a key already in the table keeps its action, so a config file that
+	// binds something over a fixed key can't take away Next Level/Reset Level.
+	keyActionTable.clear();
+	keyActionTable.emplace(keybindNextLevel, KeyAction::NEXT_LEVEL);
+	keyActionTable.emplace(keybindResetLevel, KeyAction::RESET_LEVEL);
+	keyActionTable.emplace(keybindSkipLevel_DEBUG, KeyAction::SKIP_LEVEL_DEBUG);
+	keyActionTable.emplace(keybindLoadLevelByName_DEBUG, KeyAction::LOAD_LEVEL_BY_NAME_DEBUG);
+	keyActionTable.emplace(keybindLatencyReport_DEBUG, KeyAction::LATENCY_REPORT_DEBUG);
+	keyActionTable.emplace(keybindSolveLevel_DEBUG, KeyAction::SOLVE_LEVEL_DEBUG);
+	keyActionTable.emplace(keybindPlayoutLevel_DEBUG, KeyAction::PLAYOUT_LEVEL_DEBUG);
+	for (const auto& k : keybindMap)
+		keyActionTable.emplace(k.second.keybind, keybindToAction(k.first));
+}
+
+GameplayScreen::KeyAction GameplayScreen::keyToAction(const int key)
+{
+	const auto found = keyActionTable.find(key);
+	if (found == keyActionTable.end())
+		return KeyAction::NONE;
+	return found->second;
+}
+
+GameplayScreen::KeyAction GameplayScreen::keybindToAction(const KeybindModifiable &keybind)
+{
+	switch (keybind)
+	{
+	case KeybindModifiable::MOVE_LEFT:
+		return KeyAction::MOVE_LEFT;
+	case KeybindModifiable::MOVE_RIGHT:
+		return KeyAction::MOVE_RIGHT;
+	case KeybindModifiable::MOVE_UP:
+		return KeyAction::MOVE_UP;
+	case KeybindModifiable::MOVE_DOWN:
+		return KeyAction::MOVE_DOWN;
+	case KeybindModifiable::PLACE_PUSHER_UTIL:
+		return KeyAction::PLACE_PUSHER_UTIL;
+	case KeybindModifiable::PLACE_SUCKER_UTIL:
+		return KeyAction::PLACE_SUCKER_UTIL;
+	case KeybindModifiable::OPEN_MENU:
+		return KeyAction::OPEN_MENU;
+	case KeybindModifiable::UNDO:
+		return KeyAction::UNDO;
+	case KeybindModifiable::REDO:
+		return KeyAction::REDO;
+	case KeybindModifiable::HINT:
+		return KeyAction::HINT;
+	case KeybindModifiable::TOGGLE_DANGER_MAP:
+		return KeyAction::TOGGLE_DANGER_MAP;
+	default:
+		return KeyAction::NONE;
+	}
+}
+
+MoxySim::Action GameplayScreen::keyActionToSimAction(const KeyAction &action)
+{
+	switch (action)
+	{
+	case KeyAction::MOVE_LEFT:
+		return MoxySim::Action::MOVE_LEFT;
+	case KeyAction::MOVE_RIGHT:
+		return MoxySim::Action::MOVE_RIGHT;
+	case KeyAction::MOVE_UP:
+		return MoxySim::Action::MOVE_UP;
+	case KeyAction::MOVE_DOWN:
+		return MoxySim::Action::MOVE_DOWN;
+	case KeyAction::PLACE_PUSHER_UTIL:
+		return MoxySim::Action::PLACE_PUSHER_UTIL;
+	case KeyAction::PLACE_SUCKER_UTIL:
+		return MoxySim::Action::PLACE_SUCKER_UTIL;
+	default:
+		return MoxySim::Action::NONE;
+	}
+}
+
+QString GameplayScreen::keyActionLabel(const KeyAction &action)
+{
+	switch (action)
+	{
+	case KeyAction::NEXT_LEVEL:
+		return "Next Level";
+	case KeyAction::RESET_LEVEL:
+		return "Reset Level";
+	case KeyAction::SKIP_LEVEL_DEBUG:
+		return "Skip Level DEBUG";
+	case KeyAction::LOAD_LEVEL_BY_NAME_DEBUG:
+		return "Jump To Level DEBUG";
+	case KeyAction::LATENCY_REPORT_DEBUG:
+		return "Input Latency DEBUG";
+	case KeyAction::SOLVE_LEVEL_DEBUG:
+		return "Solve Level DEBUG";
+	case KeyAction::PLAYOUT_LEVEL_DEBUG:
+		return "Playout Level DEBUG";
+	default:
+		for (const auto& k : keybindMap)
+		{
+			if (keybindToAction(k.first) == action)
+				return k.second.labelText;
+		}
+		return "";
+	}
+}
+
+bool GameplayScreen::keyActionIsMove(const KeyAction &action)
+{
+	return keyActionToSimAction(action) != MoxySim::Action::NONE;
+}
+
+void GameplayScreen::keyRepeatStop()
+{
+	keyRepeatTimer.get()->stop();
+	keyRepeatHeld = 0;
+}
+
+void GameplayScreen::keyRepeatTimeout()
+{
+	// Anything that takes us out of play (menu, level end, rebinding) ends the repeat,
+	// so it doesn't carry on into the next level or over a menu.
+	const KeyAction action = keyToAction(keyRepeatHeld);
+	if (gameState != GameState::PLAYING || !keyActionIsMove(action))
+	{
+		keyRepeatStop();
+		return;
+	}
+
+	// First repeat waits out the delay, every one after it the interval.
+	keyRepeatTimer.get()->setInterval(keyRepeatInterval);
+	if (turnOwner == TurnOwner::PLAYER)
+		playerTurn(keyActionToSimAction(action));
+}
+
+void GameplayScreen::latencyRecordInput()
+{
+	// A move that changes nothing on screen wouldn't cause a repaint, so we ask for one,
+	// otherwise the sample would stay open until some unrelated frame came along.
+	latencyInputStamp = latencyClock.nsecsElapsed();
+	viewport()->update();
+}
+
+QString GameplayScreen::latencyReport()
+{
+	if (latencySamples.empty())
+		return "No input latency samples yet.";
+
+	std::vector<qint64> sorted = latencySamples;
+	const auto percentileMs = [&sorted](const double percentile) {
+		const size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(percentile * sorted.size()));
+		std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+		return sorted[rank] / 1000000.0;
+	};
+	const double p50 = percentileMs(0.50);
+	const double p99 = percentileMs(0.99);
+	QString report = QString("Input-to-frame latency over %1 moves: p50 %2 ms, p99 %3 ms")
+		.arg(static_cast<qint64>(sorted.size()))
+		.arg(p50, 0, 'f', 2)
+		.arg(p99, 0, 'f', 2);
+
+	if (!hintLatencySamples.empty())
+	{
+		const size_t hintCount = hintLatencySamples.size();
+		sorted = hintLatencySamples;
+		const double hintP50 = percentileMs(0.50);
+		const double hintP99 = percentileMs(0.99);
+		report += QString(". Turn-to-hint latency over %1 hints: p50 %2 ms, p99 %3 ms")
+			.arg(static_cast<qint64>(hintCount))
+			.arg(hintP50, 0, 'f', 2)
+			.arg(hintP99, 0, 'f', 2);
+	}
+	return report;
+}
+
+void GameplayScreen::hintRequest(const bool levelChanged)
+{
+	// A turn that changed nothing (walking into a wall already facing it) leaves the search for this same state running.
+	if (levelChanged)
+	{
+		hintEngine.get()->setLevel(sim.getLevel());
+	}
+	else if (sim.getHash() == hintStateHash)
+	{
+		return;
+	}
+
+	hintStateHash = sim.getHash();
+	hintRequestId = hintEngine.get()->request(sim.getState());
+	hintKnown = false;
+	hintWanted = false;
+}
+
+void GameplayScreen::hintReceived(int requestId, MoxyHintEngine::HintResult result, MoxySim::Action action, int turnsToWin, qint64 latencyNs)
+{
+	// The player has moved since this was asked for.
+	if (requestId != hintRequestId)
+		return;
+
+	hintKnown = true;
+	hintResult = result;
+	hintAction = action;
+	hintTurnsToWin = turnsToWin;
+
+	if (hintLatencySamples.size() < latencySampleMax)
+		hintLatencySamples.push_back(latencyNs);
+	else
+		hintLatencySamples[hintLatencySampleNext] = latencyNs;
+	hintLatencySampleNext = (hintLatencySampleNext + 1) % latencySampleMax;
+
+	if (hintWanted && gameState == GameState::PLAYING)
+		hintShow();
+}
+
+void GameplayScreen::hintShow()
+{
+	// Goes in the messages box, where the next turn's message replaces it.
+	QString text = uiGameplayMessagesHintThinking;
+	if (hintKnown)
+	{
+		switch (hintResult)
+		{
+		case MoxyHintEngine::HintResult::MOVE:
+			for (const auto& k : keybindMap)
+			{
+				if (keyActionToSimAction(keybindToAction(k.first)) == hintAction)
+				{
+					const QString move = k.second.labelText + " (" + QKeySequence(k.second.keybind).toString() + ")";
+					text = uiGameplayMessagesHintMove.arg(move).arg(hintTurnsToWin);
+				}
+			}
+			break;
+		case MoxyHintEngine::HintResult::NO_WIN:
+			text = uiGameplayMessagesHintNoWin;
+			break;
+		case MoxyHintEngine::HintResult::GAVE_UP:
+			text = uiGameplayMessagesHintGaveUp;
+			break;
+		}
+	}
+	uiGameplayMessagesTextBox.get()->setText(text);
+}
+
+void GameplayScreen::reportStart(const std::function<QString()> &work)
+{
+	// Only one report at a time. The last one's told to stop, which a search or playout notices within a state or a game.
+	reportCancel.store(true);
+	if (reportWorker.joinable())
+		reportWorker.join();
+	reportCancel.store(false);
+
+	const int requestId = ++reportRequestId;
+	reportWorker = std::thread([this, requestId, work]() {
+		const QString report = work();
+		if (!report.isEmpty())
+			emit reportReady(requestId, report);
+	});
+}
+
+void GameplayScreen::reportReceived(int requestId, QString report)
+{
+	if (requestId == reportRequestId)
+		qDebug() << "**DEBUG** " + report;
+}
+
+QString GameplayScreen::solveReport(const QString &levelId, const MoxySim::simLevel &simLevel)
+{
+	// Runs on reportWorker. Returns nothing if it was cancelled.
+	// Solves the level from its start, not from wherever the player has got to, so the par is the level's own.
+	// Unless it's been solved before, in which case the stats are from that time.
+	const uint64_t levelHash = MoxySim::getLevelHash(simLevel);
+	MoxySolver::solveOutcome outcome;
+	const bool cached = analysisCache.get()->find(levelHash, outcome) && outcome.result != MoxySolver::Result::LIMIT_REACHED;
+	if (!cached)
+	{
+		MoxySolver::solveLimits limits;
+		limits.cancel = &reportCancel;
+		const int threads = std::max(1, int(std::thread::hardware_concurrency()));
+		outcome = MoxySolver::solveParallel(simLevel, limits, threads);
+		if (outcome.result == MoxySolver::Result::CANCELLED)
+			return QString();
+		analysisCache.get()->store(levelHash, outcome);
+	}
+	const QString searched = QString("(%1%2 states in %3 s on %4 threads, peak memory %5 MB)")
+		.arg(cached ? "cached: " : "")
+		.arg(outcome.stats.expanded)
+		.arg(outcome.stats.seconds, 0, 'f', 2)
+		.arg(outcome.stats.threads)
+		.arg(outcome.stats.peakMemory / 1048576.0, 0, 'f', 1);
+
+	if (outcome.result == MoxySolver::Result::UNSOLVABLE)
+		return levelId + " can't be solved in " + QString::number(simLevel.turnsInitial) + " turns " + searched;
+	if (outcome.result == MoxySolver::Result::LIMIT_REACHED)
+		return levelId + " gave up before finding a solution " + searched;
+
+	QStringList moves;
+	for (const auto& action : outcome.actions)
+	{
+		switch (action)
+		{
+		case MoxySim::Action::MOVE_LEFT:
+			moves.append("L");
+			break;
+		case MoxySim::Action::MOVE_RIGHT:
+			moves.append("R");
+			break;
+		case MoxySim::Action::MOVE_UP:
+			moves.append("U");
+			break;
+		case MoxySim::Action::MOVE_DOWN:
+			moves.append("D");
+			break;
+		case MoxySim::Action::PLACE_PUSHER_UTIL:
+			moves.append("Push");
+			break;
+		case MoxySim::Action::PLACE_SUCKER_UTIL:
+			moves.append("Suck");
+			break;
+		default:
+			break;
+		}
+	}
+	const MoxySolver::difficultyRating rating = MoxySolver::rate(simLevel, outcome);
+	const QString rated = QString("rating %1 (branching %2, %3 traps placed)")
+		.arg(rating.score, 0, 'f', 1)
+		.arg(rating.branching, 0, 'f', 2)
+		.arg(rating.trapUses);
+	return levelId + " par " + QString::number(outcome.turnsUsed) + " of " + QString::number(simLevel.turnsInitial) +
+		" turns, " + rated + ": " + moves.join(" ") + " " + searched;
+}
+
+QString GameplayScreen::playoutReport(const QString &levelId, const MoxySim::simLevel &simLevel)
+{
+	// Runs on reportWorker, like the solve report, and returns nothing if it was cancelled. From the level's start too. The squares are engine grid squares (x, y), where the games that ended badly ended most.
+	// Seeded from the level itself, so pressing it again on the same level gives the same report.
+	const uint64_t levelHash = MoxySim::getLevelHash(simLevel);
+	const int threads = std::max(1, int(std::thread::hardware_concurrency()));
+	const int cellsShown = 3;
+
+	QStringList reports;
+	for (const MoxyPlayout::Policy policy : { MoxyPlayout::Policy::RANDOM, MoxyPlayout::Policy::GREEDY })
+	{
+		const bool greedy = policy == MoxyPlayout::Policy::GREEDY;
+		const MoxyPlayout::playoutStats stats = MoxyPlayout::play(simLevel, greedy ? playoutGamesGreedy : playoutGamesRandom, policy, threads, levelHash, &reportCancel);
+		if (reportCancel.load())
+			return QString();
+		const auto percent = [&](const MoxyPlayout::Ending ending) {
+			return QString::number(100.0 * stats.ends[int(ending)] / std::max(1LL, stats.games), 'f', 1) + "%";
+		};
+		const auto worstCells = [&](const MoxyPlayout::Ending ending) {
+			std::vector<int> cells;
+			for (int cell = 0; cell < MoxySim::gridCellCount; cell++)
+			{
+				if (stats.endsAt(ending, cell) > 0)
+					cells.push_back(cell);
+			}
+			std::sort(cells.begin(), cells.end(), [&](const int lhs, const int rhs) {
+				return stats.endsAt(ending, lhs) > stats.endsAt(ending, rhs);
+			});
+			QStringList shown;
+			for (int i = 0; i < int(cells.size()) && i < cellsShown; i++)
+			{
+				shown.append(QString("(%1,%2) %3")
+					.arg(cells[i] % MoxySim::gridRowSize)
+					.arg(cells[i] / MoxySim::gridRowSize)
+					.arg(stats.endsAt(ending, cells[i])));
+			}
+			return shown.isEmpty() ? QString("none") : shown.join(", ");
+		};
+
+		const int median = stats.medianWinTurns();
+		reports.append(QString("%1 players won %2 of %3 games (%4 s on %5 threads), median win %6 turns. "
+			"Hazards %7 at %8. Out of turns %9 at %10. Stuck %11.")
+			.arg(greedy ? "Greedy" : "Random")
+			.arg(percent(MoxyPlayout::Ending::WON))
+			.arg(stats.games)
+			.arg(stats.seconds, 0, 'f', 2)
+			.arg(stats.threads)
+			.arg(median < 0 ? QString("-") : QString::number(median))
+			.arg(percent(MoxyPlayout::Ending::HAZARD))
+			.arg(worstCells(MoxyPlayout::Ending::HAZARD))
+			.arg(percent(MoxyPlayout::Ending::OUT_OF_TURNS))
+			.arg(worstCells(MoxyPlayout::Ending::OUT_OF_TURNS))
+			.arg(percent(MoxyPlayout::Ending::STUCK)));
+	}
+	return levelId + ": " + reports.join(" ");
+}
+
+void GameplayScreen::levelsOrderByRating()
+{
+	// A cache that can't be opened can't keep ratings either, so there'd be no point solving for them.
+	if (!analysisCache.get()->isOpen())
+		return;
+
+	std::vector<MoxySolver::difficultyRating> ratings;
+	std::vector<MoxySim::simLevel> unrated;
+	std::vector<uint64_t> unratedHashes;
+	for (const auto& level : levelsAll)
+	{
+		const MoxySim::simLevel simLevel = levelToSim(level);
+		const uint64_t levelHash = MoxySim::getLevelHash(simLevel);
+		MoxySolver::solveOutcome outcome;
+		if (analysisCache.get()->find(levelHash, outcome))
+		{
+			ratings.push_back(MoxySolver::rate(simLevel, outcome));
+		}
+		else
+		{
+			unrated.push_back(simLevel);
+			unratedHashes.push_back(levelHash);
+		}
+	}
+
+	if (unrated.empty())
+	{
+		// Stable, so levels that rate the same stay in author order.
+		std::vector<int> order(levelsAll.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](const int lhs, const int rhs) {
+			return ratings[lhs].easierThan(ratings[rhs]);
+		});
+
+		std::vector<levelData> levelsRated;
+		for (const int i : order)
+			levelsRated.emplace_back(std::move(levelsAll[i]));
+		levelsAll = std::move(levelsRated);
+		return;
+	}
+
+	qDebug() << "**DEBUG** Rating " + QString::number(unrated.size()) + " levels in the background. Author order until next time.";
+	ratingWorker = std::thread([this, unrated, unratedHashes]() {
+		MoxySolver::solveLimits limits;
+		limits.maxStates = MoxySolver::ratingMaxStates;
+		limits.cancel = &ratingCancel;
+		const int threads = std::max(1, std::min(ratingThreadsMax, int(std::thread::hardware_concurrency())));
+		MoxySolver::solveEach(unrated, limits, threads, [&](const int i, const MoxySolver::solveOutcome &outcome) {
+			analysisCache.get()->store(unratedHashes[i], outcome);
+		});
+	});
+}
+
 void GameplayScreen::prefSave()
 {
 	QFile fileWrite(windowsHomePath + "/config.txt");
@@ -817,6 +1226,16 @@ void GameplayScreen::prefSave()
 				"\r\n"
 				;
 		}
+
+		qStream << "INPUT: \r\n";
+		qStream << "InputOnKeyPress=" + QString::number(inputOnKeyPress ? 1 : 0) + "\r\n";
+		qStream << "KeyRepeatDelay=" + QString::number(keyRepeatDelay) + "\r\n";
+		qStream << "KeyRepeatInterval=" + QString::number(keyRepeatInterval) + "\r\n";
+		qStream << "GAMEPLAY: \r\n";
+		qStream << "FailWhenLost=" + QString::number(failWhenLost ? 1 : 0) + "\r\n";
+		qStream << "DangerOverlay=" + QString::number(dangerOverlayShown ? 1 : 0) + "\r\n";
+		qStream << "DangerHorizon=" + QString::number(dangerHorizon) + "\r\n";
+		qStream << "OrderByRating=" + QString::number(orderByRating ? 1 : 0) + "\r\n";
 		fileWrite.close();
 	}
 }
@@ -841,1174 +1260,461 @@ void GameplayScreen::prefLoad()
 		{
 			QString line = qStream.readLine();
 
-			for (auto& k : keybindMap)
+			if (line.startsWith("InputOnKeyPress="))
 			{
-				QString identifier = k.second.labelText;
-				if (line.contains(identifier.remove(QChar(' '), Qt::CaseSensitive) + "="))
-				{
-					QString newKey = extractSubstringInbetweenQt("=", "", line);
-					if (!newKey.isEmpty())
-						k.second.keybind = Qt::Key(QKeySequence::fromString(newKey)[0]);
-					continue;
-				}
+				inputOnKeyPress = extractSubstringInbetweenQt("=", "", line).toInt() != 0;
+				continue;
 			}
-		}
-		fileRead.close();
-	}
-}
-
-void GameplayScreen::dirIteratorLoadLevelData(const QString &dirPath)
-{
-	// Get all paths of data files and store them in vectors as strings
-	qDebug() << dirPath;
-	QDirIterator dirIt(dirPath, QDir::AllEntries | QDir::NoDotAndDotDot);
-	while (dirIt.hasNext())
-	{
-		QString filePath = dirIt.next();
-		qDebug() << filePath;
-
-		if (QFileInfo(filePath).suffix() != levelDataFileExtension)
-			continue;
-
-		QString fileContents;
-		QFile fileRead(filePath);
-		if (fileRead.open(QIODevice::ReadOnly))
-		{
-			bool validLevelFound = true;
-			levelData newLevelData;
-			QTextStream qStream(&fileRead);
-			while (!qStream.atEnd())
+			else if (line.startsWith("KeyRepeatDelay="))
 			{
-				QString line = qStream.readLine();
-				if (line.contains("::Id="))
-				{
-					newLevelData.id = extractSubstringInbetweenQt("::Id=", "::", line);
-					newLevelData.creator = extractSubstringInbetweenQt("::CreatorName=", "::", line);
-					newLevelData.name = extractSubstringInbetweenQt("::LevelName=", "::", line);
-					newLevelData.difficulty = extractSubstringInbetweenQt("::LevelDifficulty=", "::", line).toInt();
-					newLevelData.turnsInitial = extractSubstringInbetweenQt("::TurnsRemaining=", "::", line).toInt();
-					newLevelData.turnsRemaining = newLevelData.turnsInitial;
-				}
-				else if (line.contains("::Gate=") && line.contains("::Key="))
-				{
-					// Need checks here to make sure number of Gate and number of Key is the same
-					// Failing checks means NOT a valid level, leave out of level list
-
-					QString gateData = extractSubstringInbetweenQt("::Gate=", "::", line);
-					QString keyData = extractSubstringInbetweenQt("::Key=", "::", line);
-
-					QStringList gateList = extractSubstringInbetweenQtLoopList("(", ")", gateData);
-					QStringList keyList = extractSubstringInbetweenQtLoopList("(", ")", keyData);
-
-					if (gateList.length() != keyList.length())
-						validLevelFound = false;
-
-					for (const auto& gate : gateList)
-					{
-						QStringList coords = gate.split(",", QString::SkipEmptyParts);
-						newLevelData.gates.emplace_back
-						(
-							tokenImmobile
-							{
-								coords[0].toInt(),
-								coords[1].toInt(),
-								tokenImmobile::Type::GATE
-							}
-						);
-					}
-					for (const auto& key : keyList)
-					{
-						QStringList coords = key.split(",", QString::SkipEmptyParts);
-						newLevelData.keys.emplace_back
-						(
-							tokenImmobile
-							{
-								coords[0].toInt(),
-								coords[1].toInt(),
-								tokenImmobile::Type::KEY
-							}
-						);
-					}
-				}
-				else if (line.contains("::Player="))
-				{
-					QStringList coords = extractSubstringInbetweenQt("::Player=", "::", line).split(",", QString::SkipEmptyParts);
-					newLevelData.players.emplace_back
-					(
-						tokenPlayer
-						{
-							coords[0].toInt(),
-							coords[1].toInt()
-						}
-					);
-				}
-				else if (line.contains("::Pusher="))
-				{
-					QString pusherData = extractSubstringInbetweenQt("::Pusher=", "::", line);
-					QStringList pusherList = extractSubstringInbetweenQtLoopList("(", ")", pusherData);
-					for (const auto& pusher : pusherList)
-					{
-						QStringList components = pusher.split(",", QString::SkipEmptyParts);
-						newLevelData.pushers.emplace_back
-						(
-							tokenPatroller
-							{
-								components[0].toInt(),
-								components[1].toInt(),
-								tokenPatroller::typeToEnum(components[2]),
-								tokenPatroller::facingToEnum(components[3]),
-								tokenPatroller::facingToEnum(components[3]),
-								tokenPatroller::patrolDirToEnum(components[4]),
-								components[5].toInt(),
-								components[6].toInt(),
-								components[7].toInt(),
-								components[8].toInt()
-							}
-						);
-					}
-				}
-				else if (line.contains("::Sucker="))
-				{
-					QString suckerData = extractSubstringInbetweenQt("::Sucker=", "::", line);
-					QStringList suckerList = extractSubstringInbetweenQtLoopList("(", ")", suckerData);
-					for (const auto& pusher : suckerList)
-					{
-						QStringList components = pusher.split(",", QString::SkipEmptyParts);
-						newLevelData.suckers.emplace_back
-						(
-							tokenPatroller
-							{
-								components[0].toInt(),
-								components[1].toInt(),
-								tokenPatroller::typeToEnum(components[2]),
-								tokenPatroller::facingToEnum(components[3]),
-								tokenPatroller::facingToEnum(components[3]),
-								tokenPatroller::patrolDirToEnum(components[4]),
-								components[5].toInt(),
-								components[6].toInt(),
-								components[7].toInt(),
-								components[8].toInt()
-							}
-						);
-					}
-				}
-				else if (line.contains("::Util="))
-				{
-					QString utilData = extractSubstringInbetweenQt("::Util=", "::", line);
-					QStringList utilList = extractSubstringInbetweenQtLoopList("(", ")", utilData);
-					for (const auto& util : utilList)
-					{
-						// When loading a level for the first time, utils should always be INACTIVE.
-						// For reusability of code and loading procedures, we look for state regardless.
-						// This way for loading an in-progress level, varying state can be loaded as needed.
-						QStringList components = util.split(",", QString::SkipEmptyParts);
-						newLevelData.utils.emplace_back
-						(
-							tokenUtil
-							{
-								components[0].toInt(),
-								components[1].toInt(),
-								tokenUtil::typeToEnum(components[2]),
-								tokenUtil::stateToEnum(components[3])
-							}
-						);
-					}
-				}
-				else if (line.contains("::Block="))
-				{
-					QString blockData = extractSubstringInbetweenQt("::Block=", "::", line);
-					QStringList blockList = extractSubstringInbetweenQtLoopList("(", ")", blockData);
-					for (const auto& block : blockList)
-					{
-						QStringList coords = block.split(",", QString::SkipEmptyParts);
-						newLevelData.blocks.emplace_back
-						(
-							tokenImmobile
-							{
-								coords[0].toInt(),
-								coords[1].toInt(),
-								tokenImmobile::Type::BLOCK
-							}
-						);
-					}
-				}
-				else if (line.contains("::Hazard="))
-				{
-					QString hazardData = extractSubstringInbetweenQt("::Hazard=", "::", line);
-					QStringList hazardList = extractSubstringInbetweenQtLoopList("(", ")", hazardData);
-					for (const auto& hazard : hazardList)
-					{
-						QStringList coords = hazard.split(",", QString::SkipEmptyParts);
-						newLevelData.hazards.emplace_back
-						(
-							tokenImmobile
-							{
-								coords[0].toInt(),
-								coords[1].toInt(),
-								tokenImmobile::Type::HAZARD
-							}
-						);
-					}
-				}
-				else if (line.contains("::Teleport="))
-				{
-					QString teleportData = extractSubstringInbetweenQt("::Teleport=", "::", line);
-					QStringList teleportList = extractSubstringInbetweenQtLoopList("(", ")", teleportData);
-					for (const auto& teleport : teleportList)
-					{
-						QStringList coords = teleport.split(",", QString::SkipEmptyParts);
-						newLevelData.teleports.emplace_back
-						(
-							tokenImmobile
-							{
-								coords[0].toInt(),
-								coords[1].toInt(),
-								tokenImmobile::Type::TELEPORT
-							}
-						);
-					}
-				}
-			}
-
-			if (validLevelFound)
-				levelsAll.emplace_back(std::move(newLevelData));
-		}
-		fileRead.close();
-	}
-}
-
-bool GameplayScreen::hitSolidObjectPlayerMoving()
-{
-	// Areas beyond grid edges are solid objects
-	// Patroller and player are solid objects
-	// Gate is considered solid, unless a player with a key is hitting it
-	// Keys are not solid for player, and are solid for enemies
-
-	const auto& pItem = levelsAll[levelCurrent].players[pIndex].item.get();
-	const auto& pAtIndex = levelsAll[levelCurrent].players[pIndex];
-
-	int nextY;
-	int nextX;
-
-	switch (levelsAll[levelCurrent].players[pIndex].facing)
-	{
-	case (tokenPlayer::Facing::UP):
-		nextY = pItem->y() - (gridPieceSize * pAtIndex.movementSpeed);
-		nextX = pItem->x();
-		if (nextY < gridBoundUp)
-		{
-			return true;
-		}
-		break;
-	case (tokenPlayer::Facing::DOWN):
-		nextY = pItem->y() + (gridPieceSize * pAtIndex.movementSpeed);
-		nextX = pItem->x();
-		if (nextY > gridBoundDown)
-		{
-			return true;
-		}
-		break;
-	case (tokenPlayer::Facing::LEFT):
-		nextY = pItem->y();
-		nextX = pItem->x() - (gridPieceSize * pAtIndex.movementSpeed);
-		if (nextX < gridBoundLeft)
-		{
-			return true;
-		}
-		break;
-	case (tokenPlayer::Facing::RIGHT):
-		nextY = pItem->y();
-		nextX = pItem->x() + (gridPieceSize * pAtIndex.movementSpeed);
-		if (nextX > gridBoundRight)
-		{
-			return true;
-		}
-		break;
-	}
-
-
-	if (hitImmobileObject(levelsAll[levelCurrent].blocks, nextY, nextX))
-	{
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesObstacle);
-		return true;
-	}
-	else if (hitImmobileObject(levelsAll[levelCurrent].hazards, nextY, nextX))
-	{
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesHazard);
-		return true;
-	}
-	else if (hitImmobileObject(levelsAll[levelCurrent].teleports, nextY, nextX))
-	{
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesTeleport);
-		return false;
-	}
-	else if (hitEnemy(levelsAll[levelCurrent].suckers, nextY, nextX))
-	{
-		return true;
-	}
-	else if (hitEnemy(levelsAll[levelCurrent].pushers, nextY, nextX))
-	{
-		for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].knockbackAmount; i++)
-		{
-			knockbackPlayerMoving();
-		}
-		hazardHitCheck();
-		teleportHitCheck();
-		turnOwner = TurnOwner::PATROLLER;
-		return true;
-	}
-	else if (hitEnemy(levelsAll[levelCurrent].suckers, nextY, nextX))
-	{
-		turnOwner = TurnOwner::PATROLLER;
-		return true;
-	}
-	else if (hitUtil(nextY, nextX))
-	{
-		return false;
-	}
-	else if (hitImmobileObject(levelsAll[levelCurrent].gates, nextY, nextX))
-	{
-		if (levelsAll[levelCurrent].players[pIndex].heldKeys > 0)
-		{
-			hitImmobileObjectAndDelete(levelsAll[levelCurrent].gates, nextY, nextX);
-			levelsAll[levelCurrent].players[pIndex].heldKeys--;
-			uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-			return false;
-		}
-		else
-		{
-			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyNeeded);
-			return true;
-		}
-	}
-	else if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].keys, nextY, nextX))
-	{
-		levelsAll[levelCurrent].players[pIndex].heldKeys++;
-		uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyObtained);
-		return false;
-	}
-	else
-	{
-		return false;
-	}
-}
-
-bool GameplayScreen::hitImmobileObject(const std::vector<tokenImmobile>& immobiles, const int playerNextY, const int playerNextX)
-{
-	const int numImmobiles = immobiles.size();
-	for (int i = 0; i < numImmobiles; i++)
-	{
-		if (playerNextY == immobiles[i].item.get()->y()
-			&& playerNextX == immobiles[i].item.get()->x()
-			&& immobiles[i].state != tokenImmobile::State::INVISIBLE)
-		{
-			return true;
-		}
-	}
-	return false;
-}
-
-bool GameplayScreen::hitImmobileObjectAndDelete(std::vector<tokenImmobile>& immobiles, const int playerNextY, const int playerNextX)
-{
-	const int numImmobiles = immobiles.size();
-	for (int i = 0; i < numImmobiles; i++)
-	{
-		if (playerNextY == immobiles[i].item.get()->y()
-			&& playerNextX == immobiles[i].item.get()->x()
-			&& immobiles[i].state == tokenImmobile::State::ACTIVE)
-		{
-			if (immobiles[i].type == tokenImmobile::Type::KEY)
-				immobiles[i].state = tokenImmobile::State::HELD;
-			else
-				immobiles[i].state = tokenImmobile::State::INVISIBLE;
-			immobiles[i].item.get()->setPixmap
-			(
-				stateToImg(immobiles[i].state, immobiles[i].type)
-			);
-			return true;
-		}
-	}
-	return false;
-}
-
-bool GameplayScreen::hitEnemy(const std::vector<tokenPatroller>& patrollers, const int playerNextY, const int playerNextX)
-{
-	const int tokens = patrollers.size();
-	for (int i = 0; i < tokens; i++)
-	{
-		if (playerNextY == patrollers[i].item.get()->y() && playerNextX == patrollers[i].item.get()->x())
-		{
-			return true;
-		}
-	}
-	return false;
-}
-
-bool GameplayScreen::hitUtil(const int playerNextY, const int playerNextX)
-{
-	const int numUtils = levelsAll[levelCurrent].utils.size();
-	for (int i = 0; i < numUtils; i++)
-	{
-		if (playerNextY == levelsAll[levelCurrent].utils[i].item.get()->y()
-			&& playerNextX == levelsAll[levelCurrent].utils[i].item.get()->x())
-		{
-			if (levelsAll[levelCurrent].utils[i].stateModified != tokenUtil::State::HELD)
-			{
-				if (levelsAll[levelCurrent].utils[i].type == tokenUtil::Type::PUSHER)
-				{
-					levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.push_back(i);
-					uiGameplayUpdateStatCounter(StatCounterType::TRAPS_PUSHERS);
-					uiGameplayMessagesTextBox->setText(uiGameplayMessagesTrapPusherObtained);
-				}
-				else if (levelsAll[levelCurrent].utils[i].type == tokenUtil::Type::SUCKER)
-				{
-					levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.push_back(i);
-					uiGameplayUpdateStatCounter(StatCounterType::TRAPS_SUCKERS);
-					uiGameplayMessagesTextBox->setText(uiGameplayMessagesTrapSuckerObtained);
-				}
-				levelsAll[levelCurrent].utils[i].stateModified = tokenUtil::State::HELD;
-				levelsAll[levelCurrent].utils[i].item.get()->setPixmap
-				(
-					stateToImg(levelsAll[levelCurrent].utils[i].stateModified, levelsAll[levelCurrent].utils[i].type)
-				);
-
-				return true;
-			}
-		}
-	}
-	return false;
-}
-
-void GameplayScreen::knockbackPlayerMoving()
-{
-	// If player is moving into enemy, we knockback player in the opposite direction
-
-	const auto& pItem = levelsAll[levelCurrent].players[pIndex].item.get();
-	const auto& pAtIndex = levelsAll[levelCurrent].players[pIndex];
-
-	int nextY;
-	int nextX;
-
-	switch (levelsAll[levelCurrent].players[pIndex].facing)
-	{
-	case (tokenPlayer::Facing::UP):
-		nextY = pItem->y() + (gridPieceSize * pAtIndex.movementSpeed);
-		nextX = pItem->x();
-		if (nextY < gridBoundDown)
-		{
-			pItem->setPos(nextX, nextY);
-		}
-		else
-		{
-			pItem->setPos(nextX, gridBoundDown - gridPieceSize + (gridPieceSize / 4));
-		}
-		break;
-	case (tokenPlayer::Facing::DOWN):
-		nextY = pItem->y() - (gridPieceSize * pAtIndex.movementSpeed);
-		nextX = pItem->x();
-		if (nextY > gridBoundUp)
-		{
-			pItem->setPos(nextX, nextY);
-		}
-		else
-		{
-			pItem->setPos(nextX, gridBoundUp + (gridPieceSize / 4));
-		}
-		break;
-	case (tokenPlayer::Facing::LEFT):
-		nextY = pItem->y();
-		nextX = pItem->x() + (gridPieceSize * pAtIndex.movementSpeed);
-		if (nextX < gridBoundRight)
-		{
-			pItem->setPos(nextX, nextY);
-		}
-		else
-		{
-			pItem->setPos(gridBoundRight - gridPieceSize + (gridPieceSize / 4), nextY);
-		}
-		break;
-	case (tokenPlayer::Facing::RIGHT):
-		nextY = pItem->y();
-		nextX = pItem->x() - (gridPieceSize * pAtIndex.movementSpeed);
-		if (nextX > gridBoundLeft)
-		{
-			pItem->setPos(nextX, nextY);
-		}
-		else
-		{
-			pItem->setPos(gridBoundLeft + (gridPieceSize / 4), nextY);
-		}
-		break;
-	}
-
-	nextY = pItem->y();
-	nextX = pItem->x();
-
-	if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].blocks, nextY, nextX)
-		|| hitEnemy(levelsAll[levelCurrent].pushers, nextY, nextX)
-		|| hitEnemy(levelsAll[levelCurrent].suckers, nextY, nextX))
-	{
-		return;
-	}
-	else if (hitImmobileObject(levelsAll[levelCurrent].gates, nextY, nextX))
-	{
-		if (levelsAll[levelCurrent].players[pIndex].heldKeys > 0)
-		{
-			hitImmobileObjectAndDelete(levelsAll[levelCurrent].gates, nextY, nextX);
-			levelsAll[levelCurrent].players[pIndex].heldKeys--;
-			uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-			return;
-		}
-		else
-		{
-			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyNeeded);
-			return;
-		}
-	}
-	else if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].keys, nextY, nextX))
-	{
-		levelsAll[levelCurrent].players[pIndex].heldKeys++;
-		uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyObtained);
-		return;
-	}
-}
-
-void GameplayScreen::updatePositionPatrollers()
-{
-	const int numPushers = levelsAll[levelCurrent].pushers.size();
-	for (int i = 0; i < numPushers; i++)
-	{
-		updatePositionPatrollerMoves(levelsAll[levelCurrent].pushers, i);
-	}
-
-	const int numSuckers = levelsAll[levelCurrent].suckers.size();
-	for (int i = 0; i < numSuckers; i++)
-	{
-		updatePositionPatrollerMoves(levelsAll[levelCurrent].suckers, i);
-	}
-}
-
-void GameplayScreen::updatePositionPatrollerMoves(std::vector<tokenPatroller>& patrollers, const int enemyNum)
-{
-	const auto& eItem = patrollers[enemyNum].item.get();
-
-	switch (patrollers[enemyNum].patrolDir)
-	{
-	case tokenPatroller::PatrolDir::VERTICAL:
-	{
-		switch (patrollers[enemyNum].facing)
-		{
-		case tokenPatroller::Facing::UP:
-			if (patrollers[enemyNum].item.get()->y() - gridPieceSize
-				< patrollers[enemyNum].initialY - (patrollers[enemyNum].patrolBoundUp * gridPieceSize))
-			{
-				patrollers[enemyNum].facing = tokenPatroller::Facing::DOWN;
-				patrollers[enemyNum].item.get()->setPixmap
-				(
-					facingToImg(patrollers[enemyNum].facing, patrollers[enemyNum].type)
-				);
-			}
-			else
-			{
-				int nextY = eItem->y() - (gridPieceSize * patrollers[enemyNum].movementSpeed);
-				int nextX = eItem->x();
-				if (patrollerHitTrapPush(patrollers, enemyNum, nextY, nextX))
-				{
-					for (int i = 0; i < 2; i++)
-					{
-						knockbackHitTrap(patrollers, enemyNum);
-					}
-				}
-				else
-				{
-					eItem->setPos(eItem->x(), nextY);
-					suckInHitTrap(patrollers, enemyNum);
-					if (hitPlayer(patrollers, enemyNum))
-					{
-						if (patrollers[enemyNum].type == tokenPatroller::Type::PUSHER)
-						{
-							for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].knockbackAmount; i++)
-							{
-								knockbackEnemyMoving(enemyNum);
-							}
-							hazardHitCheck();
-							teleportHitCheck();
-						}
-					}
-				}
+				keyRepeatDelay = std::max(0, extractSubstringInbetweenQt("=", "", line).toInt());
+				continue;
 			}
-			break;
-		case tokenPatroller::Facing::DOWN:
-			if (eItem->y() + gridPieceSize
-							> patrollers[enemyNum].initialY + (patrollers[enemyNum].patrolBoundDown * gridPieceSize))
+			else if (line.startsWith("KeyRepeatInterval="))
 			{
-				patrollers[enemyNum].facing = tokenPatroller::Facing::UP;
-				patrollers[enemyNum].item.get()->setPixmap
-				(
-					facingToImg(patrollers[enemyNum].facing, patrollers[enemyNum].type)
-				);
+				keyRepeatInterval = std::max(0, extractSubstringInbetweenQt("=", "", line).toInt());
+				continue;
 			}
-			else
+			else if (line.startsWith("FailWhenLost="))
 			{
-				int nextY = eItem->y() + (gridPieceSize * patrollers[enemyNum].movementSpeed);
-				int nextX = eItem->x();
-				if (patrollerHitTrapPush(patrollers, enemyNum, nextY, nextX))
-				{
-					for (int i = 0; i < 2; i++)
-					{
-						knockbackHitTrap(patrollers, enemyNum);
-					}
-				}
-				else
-				{
-					eItem->setPos(eItem->x(), nextY);
-					suckInHitTrap(patrollers, enemyNum);
-					if (hitPlayer(patrollers, enemyNum))
-					{
-						if (patrollers[enemyNum].type == tokenPatroller::Type::PUSHER)
-						{
-							for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].knockbackAmount; i++)
-							{
-								knockbackEnemyMoving(enemyNum);
-							}
-							hazardHitCheck();
-							teleportHitCheck();
-						}
-					}
-				}
+				failWhenLost = extractSubstringInbetweenQt("=", "", line).toInt() != 0;
+				continue;
 			}
-			break;
-		}
-	}
-	break;
-	case tokenPatroller::PatrolDir::HORIZONTAL:
-	{
-		switch (patrollers[enemyNum].facing)
-		{
-		case tokenPatroller::Facing::LEFT:
-			if (eItem->x() - gridPieceSize
-				< patrollers[enemyNum].initialX - (patrollers[enemyNum].patrolBoundLeft * gridPieceSize))
+			else if (line.startsWith("DangerOverlay="))
 			{
-				patrollers[enemyNum].facing = tokenPatroller::Facing::RIGHT;
-				patrollers[enemyNum].item.get()->setPixmap
-				(
-					facingToImg(patrollers[enemyNum].facing, patrollers[enemyNum].type)
-				);
+				dangerOverlayShown = extractSubstringInbetweenQt("=", "", line).toInt() != 0;
+				continue;
 			}
-			else
+			else if (line.startsWith("DangerHorizon="))
 			{
-				int nextY = eItem->y();
-				int nextX = eItem->x() - (gridPieceSize * patrollers[enemyNum].movementSpeed);
-				if (patrollerHitTrapPush(patrollers, enemyNum, nextY, nextX))
-				{
-					for (int i = 0; i < 2; i++)
-					{
-						knockbackHitTrap(patrollers, enemyNum);
-					}
-				}
-				else
-				{
-					eItem->setPos(nextX, eItem->y());
-					suckInHitTrap(patrollers, enemyNum);
-					if (hitPlayer(patrollers, enemyNum))
-					{
-						if (patrollers[enemyNum].type == tokenPatroller::Type::PUSHER)
-						{
-							for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].knockbackAmount; i++)
-							{
-								knockbackEnemyMoving(enemyNum);
-							}
-							hazardHitCheck();
-							teleportHitCheck();
-						}
-					}
-				}
+				dangerHorizon = std::max(1, std::min(int(MoxyDangerMap::horizonMax), extractSubstringInbetweenQt("=", "", line).toInt()));
+				continue;
 			}
-			break;
-		case tokenPatroller::Facing::RIGHT:
-			if (eItem->x() + gridPieceSize
-							> patrollers[enemyNum].initialX + (patrollers[enemyNum].patrolBoundRight * gridPieceSize))
+			else if (line.startsWith("OrderByRating="))
 			{
-				patrollers[enemyNum].facing = tokenPatroller::Facing::LEFT;
-				patrollers[enemyNum].item.get()->setPixmap
-				(
-					facingToImg(patrollers[enemyNum].facing, patrollers[enemyNum].type)
-				);
+				orderByRating = extractSubstringInbetweenQt("=", "", line).toInt() != 0;
+				continue;
 			}
-			else
+
+			for (auto& k : keybindMap)
 			{
-				int nextY = eItem->y();
-				int nextX = eItem->x() + (gridPieceSize * patrollers[enemyNum].movementSpeed);
-				if (patrollerHitTrapPush(patrollers, enemyNum, nextY, nextX))
-				{
-					for (int i = 0; i < 2; i++)
-					{
-						knockbackHitTrap(patrollers, enemyNum);
-					}
-				}
-				else
+				QString identifier = k.second.labelText;
+				if (line.contains(identifier.remove(QChar(' '), Qt::CaseSensitive) + "="))
 				{
-					eItem->setPos(nextX, eItem->y());
-					suckInHitTrap(patrollers, enemyNum);
-					if (hitPlayer(patrollers, enemyNum))
-					{
-						if (patrollers[enemyNum].type == tokenPatroller::Type::PUSHER)
-						{
-							for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].knockbackAmount; i++)
-							{
-								knockbackEnemyMoving(enemyNum);
-							}
-							hazardHitCheck();
-							teleportHitCheck();
-						}
-					}
+					QString newKey = extractSubstringInbetweenQt("=", "", line);
+					if (!newKey.isEmpty())
+						k.second.keybind = Qt::Key(QKeySequence::fromString(newKey)[0]);
+					continue;
 				}
 			}
-			break;
 		}
-	}
-	break;
+		fileRead.close();
 	}
 }
 
-void GameplayScreen::knockbackEnemyMoving(int enemyNum)
+void GameplayScreen::dirIteratorLoadLevelData(const QString &dirPath)
 {
-	// If enemy is moving into player, we knockback player in the direction enemy is moving
-
-	const auto& pItem = levelsAll[levelCurrent].players[pIndex].item.get();
-	const auto& pAtIndex = levelsAll[levelCurrent].players[pIndex];
-
-	int nextY;
-	int nextX;
+	// Get all paths of data files and store them in vectors as strings
+	qDebug() << dirPath;
 
-	switch (levelsAll[levelCurrent].pushers[enemyNum].facing)
+	// Every file is parsed into the same fileLevel, so its lists only grow to the biggest level and are reused after that.
+	MoxyLevelFile::fileLevel fileLevel;
+	QDirIterator dirIt(dirPath, QDir::AllEntries | QDir::NoDotAndDotDot);
+	while (dirIt.hasNext())
 	{
-	case (tokenPatroller::Facing::UP):
-		nextY = pItem->y() - (gridPieceSize * pAtIndex.movementSpeed);
-		nextX = pItem->x();
-		if (nextY > gridBoundUp)
-		{
-			pItem->setPos(pItem->x(), nextY);
-		}
-		else
-		{
-			pItem->setPos(pItem->x(), gridBoundUp + (gridPieceSize / 4));
-		}
-		break;
-	case (tokenPatroller::Facing::DOWN):
-		nextY = pItem->y() + (gridPieceSize * pAtIndex.movementSpeed);
-		nextX = pItem->x();
-		if (nextY < gridBoundDown)
-		{
-			pItem->setPos(pItem->x(), nextY);
-		}
-		else
-		{
-			pItem->setPos(pItem->x(), gridBoundDown - gridPieceSize + (gridPieceSize / 4));
-		}
-		break;
-	case (tokenPatroller::Facing::LEFT):
-		nextY = pItem->y();
-		nextX = pItem->x() - (gridPieceSize * pAtIndex.movementSpeed);
-		if (nextX > gridBoundLeft)
-		{
-			pItem->setPos(nextX, pItem->y());
-		}
-		else
-		{
-			pItem->setPos(gridBoundLeft + (gridPieceSize / 4), pItem->y());
-		}
-		break;
-	case (tokenPatroller::Facing::RIGHT):
-		nextY = pItem->y();
-		nextX = pItem->x() + (gridPieceSize * pAtIndex.movementSpeed);
-		if (nextX < gridBoundRight)
-		{
-			pItem->setPos(nextX, pItem->y());
-		}
-		else
-		{
-			pItem->setPos(gridBoundRight - gridPieceSize + (gridPieceSize / 4), pItem->y());
-		}
-		break;
-	}
+		QString filePath = dirIt.next();
+		qDebug() << filePath;
 
-	nextY = pItem->y();
-	nextX = pItem->x();
+		if (QFileInfo(filePath).suffix() != levelDataFileExtension)
+			continue;
 
-	if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].blocks, nextY, nextX))
-	{
-		return;
-	}
-	else if (hitImmobileObject(levelsAll[levelCurrent].gates, nextY, nextX))
-	{
-		if (pAtIndex.heldKeys > 0)
-		{
-			hitImmobileObjectAndDelete(levelsAll[levelCurrent].gates, nextY, nextX);
-			levelsAll[levelCurrent].players[pIndex].heldKeys--;
-			uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-			return;
-		}
-		else
+		QFile fileRead(filePath);
+		if (fileRead.open(QIODevice::ReadOnly))
 		{
-			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyNeeded);
-			return;
+			// The file is parsed where it's mapped, without reading it into a buffer or decoding it into a QString first.
+			// Mapping can fail (an empty file can't be mapped, for one), and then it's read in the usual way.
+			// Levels the parser finds invalid (e.g. a gate without a key) are left out of the level list.
+			const qint64 fileSize = fileRead.size();
+			uchar *mapped = fileSize > 0 ? fileRead.map(0, fileSize) : nullptr;
+			QByteArray fileContents;
+			if (mapped == nullptr)
+				fileContents = fileRead.readAll();
+			const char *bytes = mapped != nullptr ? reinterpret_cast<const char*>(mapped) : fileContents.constData();
+			const qint64 byteCount = mapped != nullptr ? fileSize : fileContents.size();
+
+			if (MoxyLevelFile::parse(bytes, bytes + byteCount, fileLevel))
+				levelsAll.emplace_back(levelFromFile(fileLevel));
+			if (mapped != nullptr)
+				fileRead.unmap(mapped);
 		}
-	}
-	else if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].keys, nextY, nextX))
-	{
-		levelsAll[levelCurrent].players[pIndex].heldKeys++;
-		uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyObtained);
-		return;
-	}
-	else
-	{
-		return;
+		fileRead.close();
 	}
 }
 
-bool GameplayScreen::patrollerHitTrapPush(const std::vector<tokenPatroller>& patrollers, const int enemyNum, const int patrollerNextY, const int patrollerNextX)
+GameplayScreen::levelData GameplayScreen::levelFromFile(const MoxyLevelFile::fileLevel &fileLevel)
 {
-	const int tokens = levelsAll[levelCurrent].utils.size();
-	for (int i = 0; i < tokens; i++)
-	{
-		if (patrollerNextY == levelsAll[levelCurrent].utils[i].item.get()->y()
-			&& patrollerNextX == levelsAll[levelCurrent].utils[i].item.get()->x())
-		{
-			if (levelsAll[levelCurrent].utils[i].type == tokenUtil::Type::PUSHER)
-			{
-				if (levelsAll[levelCurrent].utils[i].stateModified == tokenUtil::State::ACTIVE)
+	const bool inCells = fileLevel.inCells;
+	levelData newLevelData;
+	newLevelData.id = QString::fromUtf8(fileLevel.id.begin, fileLevel.id.size());
+	newLevelData.creator = QString::fromUtf8(fileLevel.creator.begin, fileLevel.creator.size());
+	newLevelData.name = QString::fromUtf8(fileLevel.name.begin, fileLevel.name.size());
+	newLevelData.difficulty = fileLevel.difficulty;
+	newLevelData.turnsInitial = fileLevel.turnsInitial;
+
+	const auto immobiles = [&](const std::vector<MoxySim::simImmobileDef> &defs, std::vector<tokenImmobile> &tokens) {
+		tokens.reserve(defs.size());
+		for (const auto& def : defs)
+			tokens.emplace_back(tokenImmobile{ fileCoordsToCell(def.initial, inCells), def.type });
+	};
+	const auto patrollers = [&](const std::vector<MoxySim::simPatrollerDef> &defs, std::vector<tokenPatroller> &tokens) {
+		tokens.reserve(defs.size());
+		for (const auto& def : defs)
+		{
+			tokens.emplace_back
+			(
+				tokenPatroller
 				{
-					return true;
+					fileCoordsToCell(def.initial, inCells),
+					def.type,
+					def.facingInitial,
+					def.patrolDir,
+					def.patrolBoundUp,
+					def.patrolBoundDown,
+					def.patrolBoundLeft,
+					def.patrolBoundRight
 				}
-			}
+			);
 		}
-	}
-	return false;
+	};
+
+	for (const auto& player : fileLevel.players)
+		newLevelData.players.emplace_back(tokenPlayer{ fileCoordsToCell(player, inCells) });
+	patrollers(fileLevel.pushers, newLevelData.pushers);
+	patrollers(fileLevel.suckers, newLevelData.suckers);
+	immobiles(fileLevel.blocks, newLevelData.blocks);
+	immobiles(fileLevel.keys, newLevelData.keys);
+	immobiles(fileLevel.gates, newLevelData.gates);
+	immobiles(fileLevel.hazards, newLevelData.hazards);
+	immobiles(fileLevel.teleports, newLevelData.teleports);
+
+	// When loading a level for the first time, utils should always be INACTIVE.
+	// For reusability of code and loading procedures, we look for state regardless.
+	// This way for loading an in-progress level, varying state can be loaded as needed.
+	newLevelData.utils.reserve(fileLevel.utils.size());
+	for (const auto& util : fileLevel.utils)
+		newLevelData.utils.emplace_back(tokenUtil{ fileCoordsToCell(util.initial, inCells), util.type, util.stateBase });
+
+	return newLevelData;
 }
 
-void GameplayScreen::knockbackHitTrap(std::vector<tokenPatroller>& patrollers, const int enemyNum)
+void GameplayScreen::playerTurn(const MoxySim::Action action)
 {
-	// Logistics of this feature:
-	// Follow the same logic as player knockback (e.g. check for knockback hit BEFORE enemy is moved)
-	// If there's a collision with a knockback trap, knockback patroller one square (do this twice)
-
-	// If patroller is moving into knockback trap, we knockback patroller in the opposite direction
-
-	const auto& eItem = patrollers[enemyNum].item.get();
-
-	int nextY;
-	int nextX;
-
-	switch (patrollers[enemyNum].facing)
+	// The engine resolves the whole turn (player, then patrollers), then we bring the scene and UI up to date with it.
+	const MoxySim::TurnResult result = sim.playerTurn(action);
+	syncSceneFromTurnEvents();
+	if (result != MoxySim::TurnResult::BLOCKED)
 	{
-	case (tokenPatroller::Facing::UP):
-		nextY = eItem->y() + (gridPieceSize * patrollers[enemyNum].movementSpeed);
-		nextX = eItem->x();
-		if (nextY < gridBoundDown)
-		{
-			eItem->setPos(eItem->x(), nextY);
-		}
-		else
-		{
-			eItem->setPos(eItem->x(), gridBoundDown - gridPieceSize + (gridPieceSize / 4));
-		}
-		break;
-	case (tokenPatroller::Facing::DOWN):
-		nextY = eItem->y() - (gridPieceSize * patrollers[enemyNum].movementSpeed);
-		nextX = eItem->x();
-		if (nextY > gridBoundUp)
-		{
-			eItem->setPos(eItem->x(), nextY);
-		}
-		else
-		{
-			eItem->setPos(eItem->x(), gridBoundUp + (gridPieceSize / 4));
-		}
-		break;
-	case (tokenPatroller::Facing::LEFT):
-		nextY = eItem->y();
-		nextX = eItem->x() + (gridPieceSize * patrollers[enemyNum].movementSpeed);
-		if (nextX < gridBoundRight)
-		{
-			eItem->setPos(nextX, eItem->y());
-		}
-		else
-		{
-			eItem->setPos(gridBoundRight - gridPieceSize + (gridPieceSize / 4), eItem->y());
-		}
-		break;
-	case (tokenPatroller::Facing::RIGHT):
-		nextY = eItem->y();
-		nextX = eItem->x() - (gridPieceSize * patrollers[enemyNum].movementSpeed);
-		if (nextX > gridBoundLeft)
-		{
-			eItem->setPos(nextX, eItem->y());
-		}
-		else
-		{
-			eItem->setPos(gridBoundLeft + (gridPieceSize / 4), eItem->y());
-		}
-		break;
+		dangerMap.advance(sim);
+		syncDangerOverlay();
 	}
 
-	nextY = eItem->y();
-	nextX = eItem->x();
-
-	if (hitPlayer(patrollers, enemyNum))
+	switch (result)
 	{
-		if (patrollers[enemyNum].type == tokenPatroller::Type::PUSHER)
+	case MoxySim::TurnResult::COMPLETE:
+		turnOwner = TurnOwner::NONE;
+		hintEngine.get()->cancel();
+		levelSetComplete();
+		break;
+	case MoxySim::TurnResult::FAILED:
+		turnOwner = TurnOwner::NONE;
+		hintEngine.get()->cancel();
+		levelSetFailed();
+		break;
+	case MoxySim::TurnResult::PLAYING:
+	case MoxySim::TurnResult::BLOCKED:
+		if (playerIsLost())
 		{
-			for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].knockbackAmount; i++)
+			if (failWhenLost)
 			{
-				knockbackPlayerMoving();
+				turnOwner = TurnOwner::NONE;
+				hintEngine.get()->cancel();
+				levelSetFailed();
+				break;
 			}
+			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesLost);
 		}
+		turnOwner = TurnOwner::PLAYER;
+		hintRequest(false);
+		break;
 	}
 }
 
-bool GameplayScreen::hitPlayer(const std::vector<tokenPatroller>& patrollers, const int enemyNum)
+void GameplayScreen::playerUndo(const bool redo)
 {
-	if (patrollers[enemyNum].item.get()->y() == levelsAll[levelCurrent].players[pIndex].item.get()->y()
-		&& patrollers[enemyNum].item.get()->x() == levelsAll[levelCurrent].players[pIndex].item.get()->x())
+	// The engine puts back only what the turn changed and reports it the same way a turn does,
+	// so the scene catches up the same way too. A level can't be won or lost by stepping through history.
+	const bool stepped = redo ? sim.redo() : sim.undo();
+	if (stepped)
 	{
-		return true;
-	}
-	else
-	{
-		return false;
+		syncSceneFromTurnEvents();
+		dangerMapRebuild();
+		if (playerIsLost())
+			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesLost);
+		hintRequest(false);
 	}
 }
 
-void GameplayScreen::suckInHitTrap(std::vector<tokenPatroller>& patrollers, const int enemyNum)
+void GameplayScreen::dangerMapRebuild()
 {
-	const auto& eItem = patrollers[enemyNum].item.get();
-
-	const int suckRange = 2;
-	const int numSuckers = levelsAll[levelCurrent].utils.size();
-	for (int i = 0; i < numSuckers; i++)
-	{
-		const auto& uAtIndex = levelsAll[levelCurrent].utils[i];
-
-		if (uAtIndex.type == tokenUtil::Type::SUCKER
-			&& uAtIndex.stateModified == tokenUtil::State::ACTIVE)
-		{
-			if (eItem->y() == uAtIndex.item.get()->y())
-			{
-				if (eItem->x() < uAtIndex.item.get()->x())
-				{
-					// player is to the LEFT of sucker
-					if (abs(uAtIndex.item.get()->x() - eItem->x()) / gridPieceSize == suckRange)
-					{
-						// move player one to the RIGHT
-						eItem->setPos(eItem->x() + patrollers[enemyNum].movementSpeed * gridPieceSize, eItem->y());
-						suckInHitCheck();
-						return;
-					}
-				}
-				else if (eItem->x() > uAtIndex.item.get()->x())
-				{
-					// player is to the RIGHT of sucker
-					if (abs(uAtIndex.item.get()->x() - eItem->x()) / gridPieceSize == suckRange)
-					{
-						// move player one to the LEFT
-						eItem->setPos(eItem->x() - patrollers[enemyNum].movementSpeed * gridPieceSize, eItem->y());
-						suckInHitCheck();
-						return;
-					}
-				}
-			}
-			else if (eItem->x() == uAtIndex.item.get()->x())
-			{
-				if (eItem->y() < uAtIndex.item.get()->y())
-				{
-					// player is UP of sucker
-					if (abs(uAtIndex.item.get()->y() - eItem->y()) / gridPieceSize == suckRange)
-					{
-						// move player one DOWN
-						eItem->setPos(eItem->x(), eItem->y() + patrollers[enemyNum].movementSpeed * gridPieceSize);
-						suckInHitCheck();
-						return;
-					}
-				}
-				else if (eItem->y() > uAtIndex.item.get()->y())
-				{
-					// player is DOWN of sucker
-					if (abs(uAtIndex.item.get()->y() - eItem->y()) / gridPieceSize == suckRange)
-					{
-						// move player one UP
-						eItem->setPos(eItem->x(), eItem->y() - patrollers[enemyNum].movementSpeed * gridPieceSize);
-						suckInHitCheck();
-						return;
-					}
-				}
-			}
-		}
-	}
+	dangerMap.rebuild(sim);
+	syncDangerOverlay();
 }
 
-void GameplayScreen::suckInHitCheck()
+void GameplayScreen::syncDangerOverlay()
 {
-	const int nextY = levelsAll[levelCurrent].players[pIndex].item.get()->y();
-	const int nextX = levelsAll[levelCurrent].players[pIndex].item.get()->x();
-
-	if (hitEnemy(levelsAll[levelCurrent].pushers, nextY, nextX)
-		|| hitEnemy(levelsAll[levelCurrent].suckers, nextY, nextX))
+	const int numCells = dangerOverlayItems.size();
+	const int horizon = dangerMap.getHorizon();
+	for (int cell = 0; cell < numCells; cell++)
 	{
-		return;
-	}
-	else if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].blocks, nextY, nextX))
-	{
-		return;
-	}
-	else if (hitImmobileObject(levelsAll[levelCurrent].gates, nextY, nextX))
-	{
-		if (levelsAll[levelCurrent].players[pIndex].heldKeys > 0)
-		{
-			hitImmobileObjectAndDelete(levelsAll[levelCurrent].gates, nextY, nextX);
-			levelsAll[levelCurrent].players[pIndex].heldKeys--;
-			uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-			return;
-		}
-		else
+		const int soonest = dangerOverlayShown ? dangerMap.getSoonest(cell) : 0;
+		if (soonest == dangerOverlaySoonest[cell])
+			continue;
+
+		dangerOverlaySoonest[cell] = soonest;
+		QGraphicsRectItem* item = dangerOverlayItems[cell].get();
+		if (soonest == 0)
 		{
-			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyNeeded);
-			return;
-		}
-	}
-	else if (hitImmobileObjectAndDelete(levelsAll[levelCurrent].keys, nextY, nextX))
-	{
-		levelsAll[levelCurrent].players[pIndex].heldKeys++;
-		uiGameplayUpdateStatCounter(StatCounterType::KEYS_HELD);
-		uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesKeyObtained);
-		return;
+			item->setVisible(false);
+			continue;
+		}
+		const int alpha = dangerOverlayAlphaMax * (horizon - soonest + 1) / horizon;
+		item->setBrush(QBrush(QColor(200, 40, 40, alpha)));
+		item->setVisible(true);
 	}
 }
 
-void GameplayScreen::suckInRange()
+bool GameplayScreen::playerIsLost()
 {
-	const auto& pItem = levelsAll[levelCurrent].players[pIndex].item.get();
-	const auto& pAtIndex = levelsAll[levelCurrent].players[pIndex];
+	return lostCheck && lostCheck.get()->isLost(sim.getState());
+}
 
-	const int suckRange = 2;
-	const int numSuckers = levelsAll[levelCurrent].suckers.size();
-	for (int i = 0; i < numSuckers; i++)
-	{
-		const auto& sItem = levelsAll[levelCurrent].suckers[i].item.get();
+MoxySim::simLevel GameplayScreen::levelToSim(const levelData &level)
+{
+	// Copies the static parts of a level over to the engine's representation.
+	// Only the first player is used, same as everywhere else (see pIndex).
+	MoxySim::simLevel simLevel;
+	simLevel.turnsInitial = level.turnsInitial;
+	if (!level.players.empty())
+		simLevel.player = level.players[pIndex].initial;
 
-		if (pItem->y() == sItem->y())
-		{
-			if (pItem->x() < sItem->x())
-			{
-				// player is to the LEFT of sucker
-				if (abs(sItem->x() - pItem->x()) / gridPieceSize == suckRange)
-				{
-					// move player one to the RIGHT
-					pItem->setPos(pItem->x() + pAtIndex.movementSpeed * gridPieceSize, pItem->y());
-					suckInHitCheck();
-					hazardHitCheck();
-					teleportHitCheck();
-					return;
-				}
-			}
-			else if (pItem->x() > sItem->x())
-			{
-				// player is to the RIGHT of sucker
-				if (abs(sItem->x() - pItem->x()) / gridPieceSize == suckRange)
-				{
-					// move player one to the LEFT
-					pItem->setPos(pItem->x() - pAtIndex.movementSpeed * gridPieceSize, pItem->y());
-					suckInHitCheck();
-					hazardHitCheck();
-					teleportHitCheck();
-					return;
-				}
-			}
-		}
-		else if (pItem->x() == sItem->x())
-		{
-			if (pItem->y() < sItem->y())
+	for (const auto& pusher : level.pushers)
+	{
+		simLevel.pushers.emplace_back
+		(
+			MoxySim::simPatrollerDef
 			{
-				// player is UP of sucker
-				if (abs(sItem->y() - pItem->y()) / gridPieceSize == suckRange)
-				{
-					// move player one DOWN
-					pItem->setPos(pItem->x(), pItem->y() + pAtIndex.movementSpeed * gridPieceSize);
-					suckInHitCheck();
-					hazardHitCheck();
-					teleportHitCheck();
-					return;
-				}
+				pusher.initial,
+				pusher.type,
+				pusher.facingInitial,
+				pusher.patrolDir,
+				pusher.patrolBoundUp,
+				pusher.patrolBoundDown,
+				pusher.patrolBoundLeft,
+				pusher.patrolBoundRight,
+				pusher.movementSpeed
 			}
-			else if (pItem->y() > sItem->y())
+		);
+	}
+	for (const auto& sucker : level.suckers)
+	{
+		simLevel.suckers.emplace_back
+		(
+			MoxySim::simPatrollerDef
 			{
-				// player is DOWN of sucker
-				if (abs(sItem->y() - pItem->y()) / gridPieceSize == suckRange)
-				{
-					// move player one UP
-					pItem->setPos(pItem->x(), pItem->y() - pAtIndex.movementSpeed * gridPieceSize);
-					suckInHitCheck();
-					hazardHitCheck();
-					teleportHitCheck();
-					return;
-				}
+				sucker.initial,
+				sucker.type,
+				sucker.facingInitial,
+				sucker.patrolDir,
+				sucker.patrolBoundUp,
+				sucker.patrolBoundDown,
+				sucker.patrolBoundLeft,
+				sucker.patrolBoundRight,
+				sucker.movementSpeed
 			}
-		}
+		);
 	}
+
+	const auto immobilesToSim = [](const std::vector<tokenImmobile> &immobiles, std::vector<MoxySim::simImmobileDef> &defs) {
+		for (const auto& immobile : immobiles)
+			defs.emplace_back(MoxySim::simImmobileDef{ immobile.initial, immobile.type });
+	};
+	immobilesToSim(level.blocks, simLevel.blocks);
+	immobilesToSim(level.keys, simLevel.keys);
+	immobilesToSim(level.gates, simLevel.gates);
+	immobilesToSim(level.hazards, simLevel.hazards);
+	immobilesToSim(level.teleports, simLevel.teleports);
+
+	for (const auto& util : level.utils)
+		simLevel.utils.emplace_back(MoxySim::simUtilDef{ util.initial, util.type, util.stateBase });
+
+	return simLevel;
 }
 
-void GameplayScreen::hazardHitCheck()
+void GameplayScreen::syncSceneFromSim()
 {
-	// Hazards are instant level-ending penalty if you land on them.
-	// This gives a reason in design for player to be more careful about how far they are getting pushed
-	// by pushers. Pushed two squares could get them past a hazard. Pushed one square right into it.
-	// (expands on what kind of challenges you can present in level design, in other words)
-	for (const auto& hazard : levelsAll[levelCurrent].hazards)
+	// Scene items are only a picture of the engine state, so we just copy position and look across for every token.
+	// This is for when everything may have changed (load, reset). After a turn, syncSceneFromTurnEvents does only what changed.
+	auto& level = levelsAll[levelCurrent];
+	const auto& state = sim.getState();
+
+	syncPlayerItem();
+
+	const int numPushers = level.pushers.size();
+	for (int i = 0; i < numPushers; i++)
+		syncPatrollerItem(level.pushers[i], state.pushers[i]);
+
+	const int numSuckers = level.suckers.size();
+	for (int i = 0; i < numSuckers; i++)
+		syncPatrollerItem(level.suckers[i], state.suckers[i]);
+
+	const auto syncImmobiles = [&](std::vector<tokenImmobile> &immobiles, const std::vector<MoxySim::ImmobileState> &states) {
+		const int numImmobiles = immobiles.size();
+		for (int i = 0; i < numImmobiles; i++)
+			syncImmobileItem(immobiles[i], states[i]);
+	};
+	syncImmobiles(level.blocks, state.blocks);
+	syncImmobiles(level.keys, state.keys);
+	syncImmobiles(level.gates, state.gates);
+	syncImmobiles(level.hazards, state.hazards);
+	syncImmobiles(level.teleports, state.teleports);
+
+	const int numUtils = level.utils.size();
+	for (int i = 0; i < numUtils; i++)
+		syncUtilItem(i);
+}
+
+void GameplayScreen::syncSceneFromTurnEvents()
+{
+	// A turn usually touches a handful of tokens and maybe a counter or two. The engine tells us which,
+	// so we update those items and counters once each, rather than every item and every widget on every keypress.
+	auto& level = levelsAll[levelCurrent];
+	const auto& state = sim.getState();
+
+	bool playerChanged = false;
+	std::set<StatCounterType> countersChanged;
+
+	for (const auto& event : sim.getEvents())
 	{
-		if (levelsAll[levelCurrent].players[pIndex].item.get()->x() == hazard.item.get()->x() &&
-			levelsAll[levelCurrent].players[pIndex].item.get()->y() == hazard.item.get()->y())
+		switch (event.type)
 		{
-			levelsAll[levelCurrent].turnsRemaining = 0;
-			return;
+		case MoxySim::EventType::PLAYER_MOVED:
+			countersChanged.insert(StatCounterType::TURNS_REMAINING);
+			playerChanged = true;
+			break;
+		case MoxySim::EventType::PLAYER_FACED:
+		case MoxySim::EventType::PLAYER_KNOCKED_BACK:
+		case MoxySim::EventType::PLAYER_PULLED:
+		case MoxySim::EventType::PLAYER_TELEPORTED:
+			playerChanged = true;
+			break;
+		case MoxySim::EventType::HAZARD_HIT:
+			countersChanged.insert(StatCounterType::TURNS_REMAINING);
+			break;
+		case MoxySim::EventType::KEY_OBTAINED:
+			syncImmobileItem(level.keys[event.index], state.keys[event.index]);
+			countersChanged.insert(StatCounterType::KEYS_HELD);
+			break;
+		case MoxySim::EventType::GATE_OPENED:
+			syncImmobileItem(level.gates[event.index], state.gates[event.index]);
+			countersChanged.insert(StatCounterType::KEYS_HELD);
+			break;
+		case MoxySim::EventType::BLOCK_DESTROYED:
+			syncImmobileItem(level.blocks[event.index], state.blocks[event.index]);
+			break;
+		case MoxySim::EventType::TRAP_OBTAINED:
+		case MoxySim::EventType::TRAP_DEPLOYED:
+			syncUtilItem(event.index);
+			if (level.utils[event.index].type == tokenUtil::Type::PUSHER)
+				countersChanged.insert(StatCounterType::TRAPS_PUSHERS);
+			else
+				countersChanged.insert(StatCounterType::TRAPS_SUCKERS);
+			break;
+		case MoxySim::EventType::PUSHER_MOVED:
+			syncPatrollerItem(level.pushers[event.index], state.pushers[event.index]);
+			break;
+		case MoxySim::EventType::SUCKER_MOVED:
+			syncPatrollerItem(level.suckers[event.index], state.suckers[event.index]);
+			break;
 		}
 	}
+
+	if (playerChanged)
+		syncPlayerItem();
+	for (const auto& counter : countersChanged)
+		uiGameplayUpdateStatCounter(counter);
+
+	// Setting the same text again still makes the text box lay itself out again, so only touch it if the words change.
+	const QString messageText = messageToText(sim.getMessage());
+	if (uiGameplayMessagesTextBox.get()->toPlainText() != messageText)
+		uiGameplayMessagesTextBox.get()->setText(messageText);
+}
+
+void GameplayScreen::syncPlayerItem()
+{
+	auto& level = levelsAll[levelCurrent];
+	if (level.players.empty())
+		return;
+
+	const auto& player = sim.getState().player;
+	level.players[pIndex].item.get()->setPos(cellToScenePos(player.pos));
+	level.players[pIndex].item.get()->setPixmap(facingToImg(player.facing));
 }
 
-void GameplayScreen::teleportHitCheck()
+void GameplayScreen::syncPatrollerItem(tokenPatroller &token, const MoxySim::simPatroller &patroller)
 {
-	// There should only ever be two teleports on the grid.
-	// With this expected, when player lands on a teleport square,
-	// we can move player to whichever teleport square they are NOT on.
-	// This enables the possibility in design of getting the player across the board a little faster,
-	// rather than always having to walk long distances.
-	for (int i = 0; i < levelsAll[levelCurrent].teleports.size(); i++)
+	token.item.get()->setPos(cellToScenePos(patroller.pos));
+	token.item.get()->setPixmap(facingToImg(patroller.facing, token.type));
+}
+
+void GameplayScreen::syncImmobileItem(tokenImmobile &token, const MoxySim::ImmobileState &state)
+{
+	token.item.get()->setPos(cellToScenePos(token.initial));
+	token.item.get()->setPixmap(stateToImg(state, token.type));
+}
+
+void GameplayScreen::syncUtilItem(const int utilNum)
+{
+	auto& token = levelsAll[levelCurrent].utils[utilNum];
+	const auto& util = sim.getState().utils[utilNum];
+	token.item.get()->setPos(cellToScenePos(util.pos));
+	token.item.get()->setPixmap(stateToImg(util.state, token.type));
+}
+
+QPointF GameplayScreen::cellToScenePos(const MoxySim::simPoint &cell)
+{
+	return QPointF(gridAnchorX + (cell.x * gridPieceSize) + tokenOffset, gridAnchorY + (cell.y * gridPieceSize) + tokenOffset);
+}
+
+MoxySim::simPoint GameplayScreen::scenePosToCell(const int x, const int y)
+{
+	// Whichever grid square the position falls in. Rounds down, so positions left of or above the grid stay off it.
+	return MoxySim::simPoint
 	{
-		if (levelsAll[levelCurrent].players[pIndex].item.get()->x() == levelsAll[levelCurrent].teleports[i].item.get()->x() &&
-			levelsAll[levelCurrent].players[pIndex].item.get()->y() == levelsAll[levelCurrent].teleports[i].item.get()->y())
-		{
-			if (i == 0)
-			{
-				levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-				(
-					levelsAll[levelCurrent].teleports[i + 1].item.get()->x(),
-					levelsAll[levelCurrent].teleports[i + 1].item.get()->y()
-				);
-			}
-			else if (i == 1)
-			{
-				levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-				(
-					levelsAll[levelCurrent].teleports[i - 1].item.get()->x(),
-					levelsAll[levelCurrent].teleports[i - 1].item.get()->y()
-				);
-			}
-			uiGameplayMessagesTextBox.get()->setText(uiGameplayMessagesTeleport);
-			return;
-		}
-	}
+		static_cast<int>(std::floor(static_cast<double>(x - gridAnchorX) / gridPieceSize)),
+		static_cast<int>(std::floor(static_cast<double>(y - gridAnchorY) / gridPieceSize))
+	};
+}
+
+MoxySim::simPoint GameplayScreen::fileCoordsToCell(const QString &x, const QString &y, const bool inCells)
+{
+	return fileCoordsToCell(MoxySim::simPoint{ x.toInt(), y.toInt() }, inCells);
+}
+
+MoxySim::simPoint GameplayScreen::fileCoordsToCell(const MoxySim::simPoint &pos, const bool inCells)
+{
+	if (inCells)
+		return pos;
+	return scenePosToCell(pos.x, pos.y);
 }
 
 void GameplayScreen::levelSetFailed()
@@ -2021,117 +1727,36 @@ void GameplayScreen::levelSetFailed()
 
 void GameplayScreen::levelSetToDefaults(levelData& level)
 {
-	levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.clear();
-	levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.clear();
-	levelsAll[levelCurrent].turnsRemaining = levelsAll[levelCurrent].turnsInitial;
-	levelsAll[levelCurrent].state = levelData::State::UNTOUCHED;
+	// Resets the engine to the level's starting state and brings the scene items along with it.
+	// Z values never change during play, but items are reused between levels, so we set them here too.
+	level.state = levelData::State::UNTOUCHED;
 	for (auto& key : level.keys)
-	{
-		key.state = tokenImmobile::State::ACTIVE;
-		key.item.get()->setPixmap
-		(
-			stateToImg(key.state, key.type)
-		);
-		key.item.get()->setPos(key.initialX, key.initialY);
 		key.item.get()->setZValue(tokenImmobileZ);
-		qDebug() << "key: " << key.initialX;
-		qDebug() << "key: " << key.initialY;
-	}
 	for (auto& gate : level.gates)
-	{
-		gate.state = tokenImmobile::State::ACTIVE;
-		gate.item.get()->setPixmap
-		(
-			stateToImg(gate.state, gate.type)
-		);
-		gate.item.get()->setPos(gate.initialX, gate.initialY);
 		gate.item.get()->setZValue(tokenImmobileZ);
-		qDebug() << "gate: " << gate.initialX;
-		qDebug() << "gate: " << gate.initialY;
-	}
 	for (auto& player : level.players)
-	{
-		player.heldKeys = 0;
-		player.item.get()->setPixmap
-		(
-			facingToImg(player.facing)
-		);
-		player.item.get()->setPos(player.initialX, player.initialY);
 		player.item.get()->setZValue(tokenMobileZ);
-		qDebug() << "player: " << player.initialX;
-		qDebug() << "player: " << player.initialY;
-	}
 	for (auto& pusher : level.pushers)
-	{
-		pusher.facing = pusher.facingInitial;
-		pusher.item.get()->setPixmap
-		(
-			facingToImg(pusher.facing, pusher.type)
-		);
-		pusher.item.get()->setPos(pusher.initialX, pusher.initialY);
 		pusher.item.get()->setZValue(tokenMobileZ);
-		qDebug() << "pusher: " << pusher.initialX;
-		qDebug() << "pusher: " << pusher.initialY;
-	}
 	for (auto& sucker : level.suckers)
-	{
-		sucker.facing = sucker.facingInitial;
-		sucker.item.get()->setPixmap
-		(
-			facingToImg(sucker.facing, sucker.type)
-		);
-		sucker.item.get()->setPos(sucker.initialX, sucker.initialY);
 		sucker.item.get()->setZValue(tokenMobileZ);
-		qDebug() << "sucker: " << sucker.initialX;
-		qDebug() << "sucker: " << sucker.initialY;
-	}
 	for (auto& util : level.utils)
-	{
-		util.stateModified = util.stateBase;
-		util.item.get()->setPixmap
-		(
-			stateToImg(util.stateModified, util.type)
-		);
-		util.item.get()->setPos(util.initialX, util.initialY);
 		util.item.get()->setZValue(tokenImmobileZ);
-		qDebug() << "util: " << util.initialX;
-		qDebug() << "util: " << util.initialY;
-	}
 	for (auto& block : level.blocks)
-	{
-		block.state = tokenImmobile::State::ACTIVE;
-		block.item.get()->setPixmap
-		(
-			stateToImg(block.state, block.type)
-		);
-		block.item.get()->setPos(block.initialX, block.initialY);
 		block.item.get()->setZValue(tokenImmobileZ);
-		qDebug() << block.initialX;
-		qDebug() << block.initialY;
-	}
 	for (auto& hazard : level.hazards)
-	{
-		hazard.state = tokenImmobile::State::ACTIVE;
-		hazard.item.get()->setPixmap
-		(
-			stateToImg(hazard.state, hazard.type)
-		);
-		hazard.item.get()->setPos(hazard.initialX, hazard.initialY);
 		hazard.item.get()->setZValue(tokenImmobileZ);
-		qDebug() << hazard.initialX;
-		qDebug() << hazard.initialY;
-	}
 	for (auto& teleport : level.teleports)
-	{
-		teleport.state = tokenImmobile::State::ACTIVE;
-		teleport.item.get()->setPixmap
-		(
-			stateToImg(teleport.state, teleport.type)
-		);
-		teleport.item.get()->setPos(teleport.initialX, teleport.initialY);
 		teleport.item.get()->setZValue(tokenImmobileZ);
-		qDebug() << teleport.initialX;
-		qDebug() << teleport.initialY;
+
+	if (&level == &levelsAll[levelCurrent])
+	{
+		sim.load(levelToSim(level));
+		lostCheck = std::make_unique<MoxySolver::distanceHeuristic>(sim.getLevel());
+		syncSceneFromSim();
+		dangerMapRebuild();
+		hintRequest(true);
+		reportCancel.store(true);
 	}
 }
 
@@ -2189,16 +1814,6 @@ int GameplayScreen::levelFoundInList(const QString &id)
 	return false;
 }
 
-bool GameplayScreen::allGatesOpened()
-{
-	for (const auto& gate : levelsAll[levelCurrent].gates)
-	{
-		if (gate.state != tokenImmobile::State::INVISIBLE)
-			return false;
-	}
-	return true;
-}
-
 void GameplayScreen::addCurrentLevelToScene()
 {
 	for (const auto& key : levelsAll[levelCurrent].keys)
@@ -2293,16 +1908,16 @@ void GameplayScreen::uiGameplayUpdateStatCounter(const StatCounterType &statCoun
 	switch (statCounterType)
 	{
 	case StatCounterType::TURNS_REMAINING:
-		statCounterMap.at(statCounterType).updateCounter(levelsAll[levelCurrent].turnsRemaining);
+		statCounterMap.at(statCounterType).updateCounter(sim.getState().turnsRemaining);
 		break;
 	case StatCounterType::KEYS_HELD:
-		statCounterMap.at(statCounterType).updateCounter(levelsAll[levelCurrent].players[pIndex].heldKeys);
+		statCounterMap.at(statCounterType).updateCounter(sim.getState().player.heldKeys);
 		break;
 	case StatCounterType::TRAPS_PUSHERS:
-		statCounterMap.at(statCounterType).updateCounter(levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.size());
+		statCounterMap.at(statCounterType).updateCounter(sim.getState().player.heldUtilPushIndex.size());
 		break;
 	case StatCounterType::TRAPS_SUCKERS:
-		statCounterMap.at(statCounterType).updateCounter(levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.size());
+		statCounterMap.at(statCounterType).updateCounter(sim.getState().player.heldUtilSuckIndex.size());
 		break;
 	}
 }
@@ -2334,6 +1949,8 @@ void GameplayScreen::uiMenuBtnClickSave()
 			QFile fileWrite(fpath);
 			if (fileWrite.open(QIODevice::WriteOnly))
 			{
+				const auto& state = sim.getState();
+
 				QTextStream qStream(&fileWrite);
 				qStream <<
 					"::"
@@ -2341,24 +1958,24 @@ void GameplayScreen::uiMenuBtnClickSave()
 					"::" +
 					"Difficulty=" + QString::number(levelsAll[levelCurrent].difficulty) +
 					"::" +
-					"TurnsRemaining=" + QString::number(levelsAll[levelCurrent].turnsRemaining) +
+					"TurnsRemaining=" + QString::number(state.turnsRemaining) +
 					"::"
-					"KeysHeld=" + QString::number(levelsAll[levelCurrent].players[pIndex].heldKeys) +
+					"KeysHeld=" + QString::number(state.player.heldKeys) +
 					"::"
-					"TrapsPusherHeldNum=" + QString::number(levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.size()) +
+					"TrapsPusherHeldNum=" + QString::number(state.player.heldUtilPushIndex.size()) +
 					"::"
-					"TrapsSuckerHeldNum=" + QString::number(levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.size()) +
-					"::";
+					"TrapsSuckerHeldNum=" + QString::number(state.player.heldUtilSuckIndex.size()) +
+					gridUnitsCellTag;
 
 				qStream << "TrapsPusherHeldIndices=";
-				for (const auto& heldIndex : levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex)
+				for (const auto& heldIndex : state.player.heldUtilPushIndex)
 				{
 					qStream << "(" + QString::number(heldIndex) + ")";
 				}
 				qStream << "::";
 
 				qStream << "TrapsSuckerHeldIndices=";
-				for (const auto& heldIndex : levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex)
+				for (const auto& heldIndex : state.player.heldUtilSuckIndex)
 				{
 					qStream << "(" + QString::number(heldIndex) + ")";
 				}
@@ -2366,128 +1983,85 @@ void GameplayScreen::uiMenuBtnClickSave()
 
 				qStream << "\r\n";
 
+				const auto writeImmobiles = [&](const std::vector<tokenImmobile> &immobiles, const std::vector<MoxySim::ImmobileState> &states) {
+					const int numImmobiles = immobiles.size();
+					for (int i = 0; i < numImmobiles; i++)
+					{
+						qStream <<
+							"(" +
+							QString::number(immobiles[i].initial.x) +
+							"," +
+							QString::number(immobiles[i].initial.y) +
+							"," +
+							tokenImmobile::stateToString(states[i]) +
+							")";
+					}
+				};
+
+				const auto writePatrollers = [&](const std::vector<MoxySim::simPatroller> &patrollers) {
+					for (const auto& patroller : patrollers)
+					{
+						qStream <<
+							"(" +
+							QString::number(patroller.pos.x) +
+							"," +
+							QString::number(patroller.pos.y) +
+							"," +
+							tokenPatroller::facingToString(patroller.facing) +
+							")";
+					}
+				};
+
 				qStream << "::Gate=";
-				for (const auto& gate : levelsAll[levelCurrent].gates)
-				{
-					qStream <<
-						"(" +
-						QString::number(gate.item.get()->x()) +
-						"," +
-						QString::number(gate.item.get()->y()) +
-						"," +
-						tokenImmobile::stateToString(gate.state) +
-						")";
-				}
+				writeImmobiles(levelsAll[levelCurrent].gates, state.gates);
 				qStream << "::\r\n";
 
 				qStream << "::Key=";
-				for (const auto& key : levelsAll[levelCurrent].keys)
-				{
-					qStream <<
-						"(" +
-						QString::number(key.item.get()->x()) +
-						"," +
-						QString::number(key.item.get()->y()) +
-						"," +
-						tokenImmobile::stateToString(key.state) +
-						")";
-				}
+				writeImmobiles(levelsAll[levelCurrent].keys, state.keys);
 				qStream << "::\r\n";
 
 				qStream << "::Player=";
-				for (const auto& player : levelsAll[levelCurrent].players)
-				{
-					qStream <<
-						QString::number(player.item.get()->x()) +
-						"," +
-						QString::number(player.item.get()->y());
-				}
+				qStream <<
+					QString::number(state.player.pos.x) +
+					"," +
+					QString::number(state.player.pos.y);
 				qStream << "::\r\n";
 
 				qStream << "::Pusher=";
-				for (auto& pusher : levelsAll[levelCurrent].pushers)
-				{
-					qStream <<
-						"(" +
-						QString::number(pusher.item.get()->x()) +
-						"," +
-						QString::number(pusher.item.get()->y()) +
-						"," +
-						tokenPatroller::facingToString(pusher.facing) +
-						")";
-				}
+				writePatrollers(state.pushers);
 				qStream << "::\r\n";
 
 				qStream << "::Sucker=";
-				for (auto& sucker : levelsAll[levelCurrent].suckers)
-				{
-					qStream <<
-						"(" +
-						QString::number(sucker.item.get()->x()) +
-						"," +
-						QString::number(sucker.item.get()->y()) +
-						"," +
-						tokenPatroller::facingToString(sucker.facing) +
-						")";
-				}
+				writePatrollers(state.suckers);
 				qStream << "::\r\n";
 
 				qStream << "::Util=";
-				for (auto& util : levelsAll[levelCurrent].utils)
+				const int numUtils = levelsAll[levelCurrent].utils.size();
+				for (int i = 0; i < numUtils; i++)
 				{
 					qStream <<
 						"(" +
-						QString::number(util.item.get()->x()) +
+						QString::number(state.utils[i].pos.x) +
 						"," +
-						QString::number(util.item.get()->y()) +
+						QString::number(state.utils[i].pos.y) +
 						"," +
-						tokenUtil::typeToString(util.type) +
+						tokenUtil::typeToString(levelsAll[levelCurrent].utils[i].type) +
 						"," +
-						tokenUtil::stateToString(util.stateModified) +
+						tokenUtil::stateToString(state.utils[i].state) +
 						")";
 				}
 				qStream << "::\r\n";
 
 				qStream << "::Block=";
-				for (auto& block : levelsAll[levelCurrent].blocks)
-				{
-					qStream <<
-						"(" +
-						QString::number(block.item.get()->x()) +
-						"," +
-						QString::number(block.item.get()->y()) +
-						"," +
-						tokenImmobile::stateToString(block.state) +
-						")";
-				}
+				writeImmobiles(levelsAll[levelCurrent].blocks, state.blocks);
 				qStream << "::\r\n";
 
 				qStream << "::Hazard=";
-				for (auto& hazard : levelsAll[levelCurrent].hazards)
-				{
-					qStream <<
-						"(" +
-						QString::number(hazard.item.get()->x()) +
-						"," +
-						QString::number(hazard.item.get()->y()) +
-						"," +
-						tokenImmobile::stateToString(hazard.state) +
-						")";
-				}
+				writeImmobiles(levelsAll[levelCurrent].hazards, state.hazards);
 				qStream << "::\r\n";
 
 				qStream << "::Teleport=";
-				for (auto& teleport : levelsAll[levelCurrent].teleports)
-				{
-					qStream <<
-						"(" +
-						QString::number(teleport.item.get()->x()) +
-						"," +
-						QString::number(teleport.item.get()->y()) +
-						"," +
-						tokenImmobile::stateToString(teleport.state) +
-						")";
-				}
+				writeImmobiles(levelsAll[levelCurrent].teleports, state.teleports);
 				qStream << "::\r\n";
 
 				qStream << "::LevelsComplete=";
@@ -2543,213 +2117,121 @@ void GameplayScreen::uiMenuBtnClickLoad()
 						levelCurrent = levelPos;
 						qDebug() << "Current level ID: " << levelsAll[levelCurrent].id;
 						addCurrentLevelToScene();
+						levelSetToDefaults(levelsAll[levelCurrent]);
 					}
 
 					qDebug() << "Loaded level ID: " << levelsAll[levelPos].id;
 					qDebug() << "Current level ID: " << levelsAll[levelCurrent].id;
+
+					// Saved state is read into a copy of the engine state, then handed back in one go.
+					// Static token positions in the save are the same as the level data's, so only their state is read back.
+					MoxySim::simState state = sim.getState();
+
+					// Saves from before positions were stored as grid squares have no tag on their first (Id) line, and are in pixels.
+					bool inCells = false;
+
+					const auto readImmobiles = [&](const QString &identifier, const QString &line, std::vector<MoxySim::ImmobileState> &states) {
+						QString dataLine = extractSubstringInbetweenQt(identifier, "::", line);
+						QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
+
+						const int numImmobiles = std::min<int>(dataList.length(), states.size());
+						for (int i = 0; i < numImmobiles; i++)
+						{
+							QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
+							states[i] = tokenImmobile::stateToEnum(components[2]);
+						}
+					};
+
+					const auto readPatrollers = [&](const QString &identifier, const QString &line, std::vector<MoxySim::simPatroller> &patrollers) {
+						QString dataLine = extractSubstringInbetweenQt(identifier, "::", line);
+						QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
+
+						const int numPatrollers = std::min<int>(dataList.length(), patrollers.size());
+						for (int i = 0; i < numPatrollers; i++)
+						{
+							QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
+							patrollers[i].pos = fileCoordsToCell(components[0], components[1], inCells);
+							patrollers[i].facing = tokenPatroller::facingToEnum(components[2]);
+						}
+					};
+
 					QTextStream qStream(&fileRead);
 					while (!qStream.atEnd())
 					{
 						QString line = qStream.readLine();
 						if (line.contains("::Id="))
 						{
-							levelsAll[levelCurrent].turnsRemaining = extractSubstringInbetweenQt("::TurnsRemaining=", "::", line).toInt();
+							inCells = line.contains(gridUnitsCellTag);
+							state.turnsRemaining = extractSubstringInbetweenQt("::TurnsRemaining=", "::", line).toInt();
 							levelsAll[levelCurrent].difficulty = extractSubstringInbetweenQt("::Difficulty=", "::", line).toInt();
-							levelsAll[levelCurrent].players[pIndex].heldKeys = extractSubstringInbetweenQt("::KeysHeld=", "::", line).toInt();
+							state.player.heldKeys = extractSubstringInbetweenQt("::KeysHeld=", "::", line).toInt();
 
-							levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.clear();
-							levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.clear();
-							levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.resize(extractSubstringInbetweenQt("::TrapsPusherHeldNum=", "::", line).toInt());
-							levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.resize(extractSubstringInbetweenQt("::TrapsSuckerHeldNum=", "::", line).toInt());
+							state.player.heldUtilPushIndex.clear();
+							state.player.heldUtilSuckIndex.clear();
+							state.player.heldUtilPushIndex.resize(extractSubstringInbetweenQt("::TrapsPusherHeldNum=", "::", line).toInt());
+							state.player.heldUtilSuckIndex.resize(extractSubstringInbetweenQt("::TrapsSuckerHeldNum=", "::", line).toInt());
 
 							QString utilPushLine = extractSubstringInbetweenQt("::TrapsPusherHeldIndices=", "::", line);
 							QStringList utilPushList = extractSubstringInbetweenQtLoopList("(", ")", utilPushLine);
 
-							for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex.size(); i++)
+							for (int i = 0; i < state.player.heldUtilPushIndex.size(); i++)
 							{
-								levelsAll[levelCurrent].players[pIndex].heldUtilPushIndex[i] = utilPushList[i].toInt();
+								state.player.heldUtilPushIndex[i] = utilPushList[i].toInt();
 							}
 
 							QString utilSuckLine = extractSubstringInbetweenQt("::TrapsSuckerHeldIndices=", "::", line);
 							QStringList utilSuckList = extractSubstringInbetweenQtLoopList("(", ")", utilSuckLine);
 
-							for (int i = 0; i < levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex.size(); i++)
+							for (int i = 0; i < state.player.heldUtilSuckIndex.size(); i++)
 							{
-								levelsAll[levelCurrent].players[pIndex].heldUtilSuckIndex[i] = utilSuckList[i].toInt();
+								state.player.heldUtilSuckIndex[i] = utilSuckList[i].toInt();
 							}
-
-							for (auto& entry : statCounterMap)
-								uiGameplayUpdateStatCounter(entry.first);
 						}
 						else if (line.contains("::Gate="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Gate=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].gates[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].gates[i].state = tokenImmobile::stateToEnum(components[2]);
-								levelsAll[levelCurrent].gates[i].item.get()->setPixmap
-								(
-									stateToImg(levelsAll[levelCurrent].gates[i].state, levelsAll[levelCurrent].gates[i].type)
-								);
-							}
+							readImmobiles("::Gate=", line, state.gates);
 						}
 						else if (line.contains("::Key="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Key=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].keys[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].keys[i].state = tokenImmobile::stateToEnum(components[2]);
-								levelsAll[levelCurrent].keys[i].item.get()->setPixmap
-								(
-									stateToImg(levelsAll[levelCurrent].keys[i].state, levelsAll[levelCurrent].keys[i].type)
-								);
-							}
+							readImmobiles("::Key=", line, state.keys);
 						}
 						else if (line.contains("::Player="))
 						{
 							QStringList components = extractSubstringInbetweenQt("::Player=", "::", line).split(",", QString::SkipEmptyParts);
-							levelsAll[levelCurrent].players[pIndex].item.get()->setPos
-							(
-								components[0].toInt(),
-								components[1].toInt()
-							);
+							state.player.pos = fileCoordsToCell(components[0], components[1], inCells);
 						}
 						else if (line.contains("::Pusher="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Pusher=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].pushers[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].pushers[i].facing = tokenPatroller::facingToEnum(components[2]);
-								levelsAll[levelCurrent].pushers[i].item.get()->setPixmap
-								(
-									facingToImg(levelsAll[levelCurrent].pushers[i].facing, levelsAll[levelCurrent].pushers[i].type)
-								);
-							}
+							readPatrollers("::Pusher=", line, state.pushers);
 						}
 						else if (line.contains("::Sucker="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Sucker=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].suckers[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].suckers[i].facing = tokenPatroller::facingToEnum(components[2]);
-								levelsAll[levelCurrent].suckers[i].item.get()->setPixmap
-								(
-									facingToImg(levelsAll[levelCurrent].suckers[i].facing, levelsAll[levelCurrent].suckers[i].type)
-								);
-							}
+							readPatrollers("::Sucker=", line, state.suckers);
 						}
 						else if (line.contains("::Util="))
 						{
 							QString dataLine = extractSubstringInbetweenQt("::Util=", "::", line);
 							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
 
-							for (int i = 0; i < dataList.length(); i++)
+							const int numUtils = std::min<int>(dataList.length(), state.utils.size());
+							for (int i = 0; i < numUtils; i++)
 							{
 								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].utils[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].utils[i].type = levelsAll[levelCurrent].utils[i].typeToEnum(components[2]);
-								levelsAll[levelCurrent].utils[i].stateModified = tokenUtil::stateToEnum(components[3]);
-								levelsAll[levelCurrent].utils[i].item.get()->setPixmap
-								(
-									stateToImg(levelsAll[levelCurrent].utils[i].stateModified, levelsAll[levelCurrent].utils[i].type)
-								);
+								state.utils[i].pos = fileCoordsToCell(components[0], components[1], inCells);
+								state.utils[i].state = tokenUtil::stateToEnum(components[3]);
 							}
 						}
 						else if (line.contains("::Block="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Block=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].blocks[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].blocks[i].state = tokenImmobile::stateToEnum(components[2]);
-								levelsAll[levelCurrent].blocks[i].item.get()->setPixmap
-								(
-									stateToImg(levelsAll[levelCurrent].blocks[i].state, levelsAll[levelCurrent].blocks[i].type)
-								);
-							}
+							readImmobiles("::Block=", line, state.blocks);
 						}
 						else if (line.contains("::Hazard="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Hazard=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].hazards[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].hazards[i].state = tokenImmobile::stateToEnum(components[2]);
-								levelsAll[levelCurrent].hazards[i].item.get()->setPixmap
-								(
-									stateToImg(levelsAll[levelCurrent].hazards[i].state, levelsAll[levelCurrent].hazards[i].type)
-								);
-							}
+							readImmobiles("::Hazard=", line, state.hazards);
 						}
 						else if (line.contains("::Teleport="))
 						{
-							QString dataLine = extractSubstringInbetweenQt("::Teleport=", "::", line);
-							QStringList dataList = extractSubstringInbetweenQtLoopList("(", ")", dataLine);
-
-							for (int i = 0; i < dataList.length(); i++)
-							{
-								QStringList components = dataList[i].split(",", QString::SkipEmptyParts);
-								levelsAll[levelCurrent].teleports[i].item.get()->setPos
-								(
-									components[0].toInt(),
-									components[1].toInt()
-								);
-								levelsAll[levelCurrent].teleports[i].state = tokenImmobile::stateToEnum(components[2]);
-								levelsAll[levelCurrent].teleports[i].item.get()->setPixmap
-								(
-									stateToImg(levelsAll[levelCurrent].teleports[i].state, levelsAll[levelCurrent].teleports[i].type)
-								);
-							}
+							readImmobiles("::Teleport=", line, state.teleports);
 						}
 						else if (line.contains("::LevelsComplete="))
 						{
@@ -2766,6 +2248,14 @@ void GameplayScreen::uiMenuBtnClickLoad()
 							}
 						}
 					}
+					sim.setState(state);
+					lostCheck = std::make_unique<MoxySolver::distanceHeuristic>(sim.getLevel());
+					syncSceneFromSim();
+					dangerMapRebuild();
+					hintRequest(true);
+					reportCancel.store(true);
+					for (auto& entry : statCounterMap)
+						uiGameplayUpdateStatCounter(entry.first);
 					fileRead.close();
 					uiMenuResumePlay();
 				}
@@ -2923,6 +2413,33 @@ QPixmap GameplayScreen::facingToImg(const tokenPatroller::Facing &facing, const
 		return imgError;
 }
 
+QString GameplayScreen::messageToText(const MoxySim::Message &message)
+{
+	switch (message)
+	{
+	case MoxySim::Message::OBSTACLE:
+		return uiGameplayMessagesObstacle;
+	case MoxySim::Message::HAZARD:
+		return uiGameplayMessagesHazard;
+	case MoxySim::Message::TELEPORT:
+		return uiGameplayMessagesTeleport;
+	case MoxySim::Message::KEY_OBTAINED:
+		return uiGameplayMessagesKeyObtained;
+	case MoxySim::Message::KEY_NEEDED:
+		return uiGameplayMessagesKeyNeeded;
+	case MoxySim::Message::TRAP_PUSHER_OBTAINED:
+		return uiGameplayMessagesTrapPusherObtained;
+	case MoxySim::Message::TRAP_PUSHER_DEPLOYED:
+		return uiGameplayMessagesTrapPusherDeployed;
+	case MoxySim::Message::TRAP_SUCKER_OBTAINED:
+		return uiGameplayMessagesTrapSuckerObtained;
+	case MoxySim::Message::TRAP_SUCKER_DEPLOYED:
+		return uiGameplayMessagesTrapSuckerDeployed;
+	default:
+		return "";
+	}
+}
+
 const QFont::StyleStrategy GameplayScreen::fontStrategyToEnum(const QString &str)
 {
 	// Default to antialias strat if string received is unexpected.
@@ -18,6 +18,7 @@ This file is part of Moxybox.
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QGraphicsPixmapItem>
+#include <QGraphicsRectItem>
 #include <QDirIterator>
 #include <QTextStream>
 #include <QShortcut>
@@ -35,7 +36,24 @@ This file is part of Moxybox.
 #include <QDebug>
 #include <QFileInfo>
 #include <QInputDialog>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPaintEvent>
+#include <QFocusEvent>
 #include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include "MoxySim.h"
+#include "MoxySolver.h"
+#include "MoxyHintEngine.h"
+#include "MoxyDangerMap.h"
+#include "MoxyAnalysisCache.h"
+#include "MoxyPlayout.h"
+#include "MoxyLevelFile.h"
 
 class GameplayScreen : public QGraphicsView
 {
@@ -43,10 +61,18 @@ class GameplayScreen : public QGraphicsView
 
 public:
 	GameplayScreen(QWidget *parent = nullptr);
+	~GameplayScreen();
 	void prefSave();
 
+signals:
+	// A debug report worked out on reportWorker, for the request reportStart numbered requestId.
+	void reportReady(int requestId, QString report);
+
 protected:
+	void keyPressEvent(QKeyEvent *event);
 	void keyReleaseEvent(QKeyEvent *event);
+	void focusOutEvent(QFocusEvent *event);
+	void paintEvent(QPaintEvent *event);
 
 private:
 
@@ -64,6 +90,10 @@ private:
 	const QString levelDataPath = appExecutablePath + "/" + levelFolderName;
 	const QString levelDataPathMods = windowsHomePath + "/Mods/" + levelFolderName;
 	const QString levelDataFileExtension = "MoxyLvl";
+
+	// Level and save files used to store token positions in scene pixels. Files carrying this tag store grid squares instead.
+	// Anything without it is treated as the old pixel format and converted on load, so existing files keep working.
+	const QString gridUnitsCellTag = "::GridUnits=Cell::";
 	const QString themePathMods = windowsHomePath + "/Mods/Theme";
 
 	QString fileDirLastSaved = windowsHomePath + "/" + savesFolderName;
@@ -233,17 +263,13 @@ private:
 	const int tokenImmobileZ = 1;
 
 	const int tokenSize = 20; // Standard image size of all tokens. Unused, from SDL2 version of game.
+	// Tokens only hold what was read from level data, plus the scene item that displays them.
+	// Anything that changes while a level is played (positions, facing, state, inventory) lives in MoxySim,
+	// and items are synced from it after each turn. Enums are aliases of the engine's, so they convert for free.
 	struct tokenPlayer
 	{
-		const int initialX;
-		const int initialY;
-		enum class Facing { NEUTRAL, UP, DOWN, LEFT, RIGHT };
-		Facing facing = Facing::NEUTRAL;
-		int heldKeys = 0;
-		std::vector<int> heldUtilPushIndex;
-		std::vector<int> heldUtilSuckIndex;
-		int movementSpeed = 1; // This only checks collision for square landed on, so keep this in mind if changing it (it could break level design)
-		int knockbackAmount = 2; // Be careful about what this is set to. Collision detection is likely expensive and runs for each square pushed back
+		const MoxySim::simPoint initial; // Grid square (column, row). Only turned into scene pixels when the item is placed.
+		using Facing = MoxySim::Facing;
 		std::unique_ptr<QGraphicsPixmapItem> item = std::make_unique<QGraphicsPixmapItem>(nullptr);
 	};
 	struct tokenPatroller
@@ -258,14 +284,12 @@ private:
 		// we don't need to save or load them as part of save game file.
 		// (not to be confused with level data file)
 
-		const int initialX;
-		const int initialY;
-		enum class Type { PUSHER, SUCKER, ERROR };
+		const MoxySim::simPoint initial; // Grid square (column, row). Only turned into scene pixels when the item is placed.
+		using Type = MoxySim::PatrollerType;
 		const Type type = Type::PUSHER;
-		enum class Facing { UP, DOWN, LEFT, RIGHT, ERROR };
+		using Facing = MoxySim::Facing;
 		const Facing facingInitial = Facing::UP;
-		Facing facing = Facing::UP;
-		enum class PatrolDir { VERTICAL, HORIZONTAL, ERROR };
+		using PatrolDir = MoxySim::PatrolDir;
 		const PatrolDir patrolDir = PatrolDir::VERTICAL;
 		const int patrolBoundUp = 3;
 		const int patrolBoundDown = 3;
@@ -344,12 +368,10 @@ private:
 	};
 	struct tokenImmobile
 	{
-		const int initialX;
-		const int initialY;
-		enum class Type { BLOCK, KEY, GATE, HAZARD, TELEPORT, ERROR };
+		const MoxySim::simPoint initial; // Grid square (column, row). Only turned into scene pixels when the item is placed.
+		using Type = MoxySim::ImmobileType;
 		Type type = Type::BLOCK;
-		enum class State { ACTIVE, INVISIBLE, HELD, ERROR };
-		State state = State::ACTIVE;
+		using State = MoxySim::ImmobileState;
 		std::unique_ptr<QGraphicsPixmapItem> item = std::make_unique<QGraphicsPixmapItem>(nullptr);
 
 		static const State stateToEnum(const QString &str)
@@ -417,13 +439,11 @@ private:
 		// They will stay on that Y unless sucked again in another Y direction,
 		// because their patrol route is leashed to X axis, not to Y axis.
 
-		const int initialX;
-		const int initialY;
-		enum class Type { PUSHER, SUCKER, ERROR };
+		const MoxySim::simPoint initial; // Grid square (column, row). Only turned into scene pixels when the item is placed.
+		using Type = MoxySim::UtilType;
 		Type type = Type::PUSHER;
-		enum class State { INACTIVE, ACTIVE, HELD, ERROR };
+		using State = MoxySim::UtilState;
 		const State stateBase = State::INACTIVE; // Unchanged state, pulled from level data file, reset state to this.
-		State stateModified = State::INACTIVE; // Changeable state, for use in the middle of playing a level.
 		std::unique_ptr<QGraphicsPixmapItem> item = std::make_unique<QGraphicsPixmapItem>(nullptr);
 
 		static Type typeToEnum(const QString &str)
@@ -503,6 +523,7 @@ private:
 	const int gridBoundDown = gridHeight + gridAnchorY;
 	const int gridBoundLeft = gridAnchorX;
 	const int gridBoundRight = gridWidth + gridAnchorX;
+	const int tokenOffset = gridPieceSize / 4; // Tokens sit this far in from the top left of their grid square.
 
 	const int screenWidth = 800;
 	const int screenHeight = 600;
@@ -521,7 +542,6 @@ private:
 		QString name;
 		int difficulty;
 		int turnsInitial;
-		int turnsRemaining;
 		enum class State { COMPLETE, STARTED, UNTOUCHED };
 		State state = State::UNTOUCHED;
 
@@ -537,6 +557,20 @@ private:
 	};
 	std::vector<levelData> levelsAll;
 
+	// Game state of the level currently being played. Reloaded from levelsAll whenever the current level changes or resets.
+	MoxySim sim;
+
+	// Squares patrollers will threaten over the next dangerHorizon turns, kept up to date with sim whether or not it's shown.
+	// The overlay tints each threatened grid square, more strongly the sooner the threat. It's turned on and off with a keybind,
+	// and the config remembers both. dangerOverlaySoonest is what each square last showed, so a turn only touches squares that changed.
+	MoxyDangerMap dangerMap;
+	int dangerHorizon = MoxyDangerMap::horizonDefault;
+	bool dangerOverlayShown = false;
+	const qreal dangerOverlayZ = 0.5; // Above grid pieces, under tokens.
+	const int dangerOverlayAlphaMax = 140;
+	std::vector<std::unique_ptr<QGraphicsRectItem>> dangerOverlayItems;
+	std::vector<int> dangerOverlaySoonest;
+
 	// --------------
 	// SPLASHSCREEN
 	// --------------
@@ -592,6 +626,9 @@ private:
 	// Otherwise, it's going to be hard for people to test new levels they make with the level creator.
 	const Qt::Key keybindSkipLevel_DEBUG = Qt::Key::Key_F1;
 	const Qt::Key keybindLoadLevelByName_DEBUG = Qt::Key::Key_F2;
+	const Qt::Key keybindLatencyReport_DEBUG = Qt::Key::Key_F3;
+	const Qt::Key keybindSolveLevel_DEBUG = Qt::Key::Key_F4;
+	const Qt::Key keybindPlayoutLevel_DEBUG = Qt::Key::Key_F5;
 
 	// We set up an enum ID for each modifiable keybind, so that when the UI is clicked
 	// to modify a key, we know which one to apply the modification to after key input.
@@ -604,10 +641,106 @@ private:
 		MOVE_DOWN,
 		PLACE_PUSHER_UTIL,
 		PLACE_SUCKER_UTIL,
-		OPEN_MENU
+		OPEN_MENU,
+		UNDO,
+		REDO,
+		HINT,
+		TOGGLE_DANGER_MAP
 	};
 	KeybindModifiable keybindToModify = KeybindModifiable::NONE;
 
+	// Everything a key can do, modifiable or not. keyActionTable maps each bound key straight to its action,
+	// so handling a key press is a single lookup however many commands there are.
+	// It's rebuilt whenever a keybind changes (startup after prefLoad, rebinding through the UI), never on key press.
+	enum class KeyAction
+	{
+		NONE,
+		MOVE_LEFT,
+		MOVE_RIGHT,
+		MOVE_UP,
+		MOVE_DOWN,
+		PLACE_PUSHER_UTIL,
+		PLACE_SUCKER_UTIL,
+		OPEN_MENU,
+		UNDO,
+		REDO,
+		HINT,
+		TOGGLE_DANGER_MAP,
+		NEXT_LEVEL,
+		RESET_LEVEL,
+		SKIP_LEVEL_DEBUG,
+		LOAD_LEVEL_BY_NAME_DEBUG,
+		LATENCY_REPORT_DEBUG,
+		SOLVE_LEVEL_DEBUG,
+		PLAYOUT_LEVEL_DEBUG
+	};
+	std::unordered_map<int, KeyAction> keyActionTable;
+
+	// Moves happen as soon as the key goes down, rather than when it comes back up, unless inputOnKeyPress is turned off
+	// in the config. Holding a move key repeats it after keyRepeatDelay ms, then every keyRepeatInterval ms.
+	// An interval of 0 means no repeat. We run our own timer rather than using the OS auto-repeat, so the rate is ours to set.
+	bool inputOnKeyPress = true;
+	int keyRepeatDelay = 300;
+	int keyRepeatInterval = 0;
+
+	// A level is lost as soon as lostCheck can prove no win is left (too few keys for the pods, or too far to go in the turns remaining),
+	// rather than when the turns run out. With failWhenLost set in the config that fails the level there and then,
+	// otherwise the player is told and can undo their way back. lostCheck is built for each level as it's loaded into the engine.
+	bool failWhenLost = false;
+	std::unique_ptr<MoxySolver::distanceHeuristic> lostCheck;
+	std::unique_ptr<QTimer> keyRepeatTimer = std::make_unique<QTimer>();
+	int keyRepeatHeld = 0;
+
+	// Input-to-frame latency. A move key is timestamped when its QKeyEvent arrives and the sample closes when the view
+	// next finishes painting. That's as close to the screen as we can see from here, so it's a lower bound on input-to-photon.
+	// Only the most recent latencySampleMax samples are kept. The debug key reports p50/p99.
+	QElapsedTimer latencyClock;
+	qint64 latencyInputStamp = -1;
+	std::vector<qint64> latencySamples;
+	size_t latencySampleNext = 0;
+	const size_t latencySampleMax = 1000;
+
+	// Hints are worked out in the background after every turn (see MoxyHintEngine), so one is usually ready before it's asked for.
+	// hintRequestId is the newest request, and answers to any other are stale. hintWanted means the player asked
+	// and is waiting, so the answer goes up as soon as it comes in. Hint latencies are kept like input ones and reported with them.
+	std::unique_ptr<MoxyHintEngine> hintEngine = std::make_unique<MoxyHintEngine>();
+	int hintRequestId = 0;
+	uint64_t hintStateHash = 0;
+	bool hintKnown = false;
+	bool hintWanted = false;
+	MoxyHintEngine::HintResult hintResult = MoxyHintEngine::HintResult::GAVE_UP;
+	MoxySim::Action hintAction = MoxySim::Action::NONE;
+	int hintTurnsToWin = 0;
+	std::vector<qint64> hintLatencySamples;
+	size_t hintLatencySampleNext = 0;
+
+	// What's been worked out about levels, kept in a file in the home folder between runs and looked up by level content (see MoxyAnalysisCache),
+	// so the solve report only solves a level the first time it's asked, or after the level is edited.
+	const QString analysisCacheFileName = "AnalysisCache.dat";
+	std::unique_ptr<MoxyAnalysisCache> analysisCache;
+
+	// With orderByRating set in the config, the campaign goes easiest first by MoxySolver::rate instead of by ::LevelDifficulty=.
+	// Ratings are only ever read from analysisCache at startup. Levels without one yet are solved by ratingWorker in the background
+	// and the rated order starts the next run, so startup never waits on a search. The player's playing meanwhile, so it only
+	// takes ratingThreadsMax threads, leaving the rest of the machine to the game.
+	bool orderByRating = false;
+	const int ratingThreadsMax = 2;
+	std::thread ratingWorker;
+	std::atomic<bool> ratingCancel{ false };
+
+	// The debug reports (solve and playout) are worked out on reportWorker, one at a time, so the window keeps drawing while they run.
+	// A report comes back through reportReady, connected with Qt::QueuedConnection like hints are. Starting another report,
+	// pressing any key or going to another level cancels the one running, and reportRequestId tells a stale answer apart.
+	std::thread reportWorker;
+	std::atomic<bool> reportCancel{ false };
+	int reportRequestId = 0;
+
+	// Games the playout debug key plays of the current level with each kind of made-up player (see MoxyPlayout).
+	// Greedy players look at every action before each turn, so they get fewer games. On one core the whole report takes minutes,
+	// which is fine on reportWorker, and pressing any key stops it.
+	const long long playoutGamesRandom = 1000000;
+	const long long playoutGamesGreedy = 100000;
+
 	struct keybindComponent
 	{
 		const QString labelText;
@@ -637,6 +770,11 @@ private:
 	const QString uiGameplayMessagesTrapSuckerObtained = "You picked up a Magnet Trap! Magnet Traps will pull in patrollers who come near.";
 	const QString uiGameplayMessagesTrapSuckerDeployed = "Magnet Trap deployed.";
 	const QString uiGameplayMessagesLevelReset = "Level Reset.";
+	const QString uiGameplayMessagesLost = "There's no way to win from here anymore. Undo, or reset the level.";
+	const QString uiGameplayMessagesHintThinking = "Thinking about a hint...";
+	const QString uiGameplayMessagesHintMove = "Hint: %1. You can still win in %2 turns.";
+	const QString uiGameplayMessagesHintNoWin = "Hint: There's no way to win from here. Try undoing, or reset the level.";
+	const QString uiGameplayMessagesHintGaveUp = "Hint: Couldn't find one from here, sorry.";
 
 	// ---------
 	// UI MENU
@@ -675,31 +813,48 @@ private:
 	// FUNCTIONS
 	// -----------
 	void prefLoad();
+	void rebuildKeyActionTable();
+	KeyAction keyToAction(const int key);
+	KeyAction keybindToAction(const KeybindModifiable &keybind);
+	MoxySim::Action keyActionToSimAction(const KeyAction &action);
+	QString keyActionLabel(const KeyAction &action);
+	bool keyActionIsMove(const KeyAction &action);
+	void keyRepeatStop();
+	void keyRepeatTimeout();
+	void latencyRecordInput();
+	QString latencyReport();
+	void hintRequest(const bool levelChanged);
+	void hintReceived(int requestId, MoxyHintEngine::HintResult result, MoxySim::Action action, int turnsToWin, qint64 latencyNs);
+	void hintShow();
+	void reportStart(const std::function<QString()> &work);
+	void reportReceived(int requestId, QString report);
+	QString solveReport(const QString &levelId, const MoxySim::simLevel &simLevel);
+	QString playoutReport(const QString &levelId, const MoxySim::simLevel &simLevel);
+	void levelsOrderByRating();
 	void dirIteratorLoadLevelData(const QString &dirPath);
-	bool hitSolidObjectPlayerMoving();
-	bool hitImmobileObject(const std::vector<tokenImmobile>& immobiles, const int playerNextY, const int playerNextX);
-	bool hitImmobileObjectAndDelete(std::vector<tokenImmobile>& immobiles, const int playerNextY, const int playerNextX);
-	bool hitUtil(const int playerNextY, const int playerNextX);
-	bool hitEnemy(const std::vector<tokenPatroller>& patrollers, const int playerNextY, const int playerNextX);
-	void knockbackPlayerMoving();
-	void updatePositionPatrollers();
-	void updatePositionPatrollerMoves(std::vector<tokenPatroller>& patrollers, const int enemyNum);
-	void knockbackEnemyMoving(int enemyNum);
-	bool patrollerHitTrapPush(const std::vector<tokenPatroller>& patrollers, const int enemyNum, const int patrollerNextY, const int patrollerNextX);
-	void knockbackHitTrap(std::vector<tokenPatroller>& patrollers, const int enemyNum);
-	bool hitPlayer(const std::vector<tokenPatroller>& patrollers, const int enemyNum);
-	void suckInHitTrap(std::vector<tokenPatroller>& patrollers, const int enemyNum);
-	void suckInHitCheck();
-	void suckInRange();
-	void hazardHitCheck();
-	void teleportHitCheck();
+	levelData levelFromFile(const MoxyLevelFile::fileLevel &fileLevel);
+	void playerTurn(const MoxySim::Action action);
+	void playerUndo(const bool redo);
+	bool playerIsLost();
+	void dangerMapRebuild();
+	void syncDangerOverlay();
+	MoxySim::simLevel levelToSim(const levelData &level);
+	void syncSceneFromSim();
+	void syncSceneFromTurnEvents();
+	void syncPlayerItem();
+	void syncPatrollerItem(tokenPatroller &token, const MoxySim::simPatroller &patroller);
+	void syncImmobileItem(tokenImmobile &token, const MoxySim::ImmobileState &state);
+	void syncUtilItem(const int utilNum);
+	QPointF cellToScenePos(const MoxySim::simPoint &cell);
+	MoxySim::simPoint scenePosToCell(const int x, const int y);
+	MoxySim::simPoint fileCoordsToCell(const QString &x, const QString &y, const bool inCells);
+	MoxySim::simPoint fileCoordsToCell(const MoxySim::simPoint &pos, const bool inCells);
 	void levelSetFailed();
 	void levelSetToDefaults(levelData& level);
 	void levelSetComplete();
 	int levelLoadValidateId(QFile &file);
 	int levelFoundInListAtPos(const QString &id);
 	int levelFoundInList(const QString &id);
-	bool allGatesOpened();
 	void addCurrentLevelToScene();
 	void removeCurrentLevelFromScene();
 	void uiGameplaySetToDefaults();
@@ -715,6 +870,7 @@ private:
 	QPixmap stateToImg(const tokenUtil::State &state, const tokenUtil::Type &type);
 	QPixmap facingToImg(const tokenPlayer::Facing &facing);
 	QPixmap facingToImg(const tokenPatroller::Facing &facing, const tokenPatroller::Type &type);
+	QString messageToText(const MoxySim::Message &message);
 	const QFont::StyleStrategy fontStrategyToEnum(const QString &str);
 	const QString fontStrategyToString(const QFont::StyleStrategy &strat);
 	const QFont::Weight fontWeightToEnum(const QString &str);
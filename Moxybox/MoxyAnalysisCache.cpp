@@ -0,0 +1,207 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyAnalysisCache.h"
+#include <cstring>
+#include <thread>
+
+// Records are read and written through atomics sitting in the mapped file, which only works if they're plain 64-bit words with no lock of their own.
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Cache words must be the size of the values in them");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Cache words must be lock free, so other processes see the same atomics");
+
+MoxyAnalysisCache::MoxyAnalysisCache(const QString &path)
+	: file(path), writeLock(path + ".lock")
+{
+	if (!open())
+		file.close();
+}
+
+MoxyAnalysisCache::~MoxyAnalysisCache()
+{
+	if (mapped)
+		file.unmap(mapped);
+	file.close();
+}
+
+bool MoxyAnalysisCache::open()
+{
+	if (!file.open(QIODevice::ReadWrite))
+		return false;
+
+	const auto map = [this]() {
+		mapped = file.map(0, fileSize());
+		words = reinterpret_cast<std::atomic<uint64_t>*>(mapped);
+		return mapped != nullptr;
+	};
+
+	// Usually the file's there already and only needs mapping.
+	if (file.size() == fileSize() && map() && headerMatches())
+		return true;
+	if (mapped)
+		file.unmap(mapped);
+	mapped = nullptr;
+	words = nullptr;
+
+	// Otherwise it's new or from another version. Looked at again once we're the writer, in case another instance was making it just now.
+	if (!writeLock.tryLock(lockWaitMs))
+		return false;
+	bool ready = file.size() == fileSize() && map() && headerMatches();
+	if (!ready)
+	{
+		// Another instance may have it mapped already (it maps before checking the header), and truncating it would pull the pages
+		// out from under that instance, so a file that's the right size keeps it. It's cleared in place instead: the magic goes first,
+		// so the header stops matching, then every record is zeroed (empty), and the magic goes back in last, so the header is only ever whole or not there.
+		if (!mapped)
+			ready = (file.size() == fileSize() || file.resize(fileSize())) && map();
+		else
+			ready = true;
+		if (ready)
+		{
+			words[0].store(0, std::memory_order_release);
+			const size_t wordCount = size_t(fileSize() / sizeof(uint64_t));
+			for (size_t i = 1; i < wordCount; i++)
+				words[i].store(0, std::memory_order_relaxed);
+			words[1].store(formatVersion, std::memory_order_relaxed);
+			words[2].store(capacity, std::memory_order_relaxed);
+			words[3].store(recordWords, std::memory_order_relaxed);
+			words[0].store(magic, std::memory_order_release);
+		}
+	}
+	writeLock.unlock();
+	return ready;
+}
+
+bool MoxyAnalysisCache::headerMatches() const
+{
+	return words[0].load(std::memory_order_acquire) == magic &&
+		words[1].load(std::memory_order_relaxed) == formatVersion &&
+		words[2].load(std::memory_order_relaxed) == uint64_t(capacity) &&
+		words[3].load(std::memory_order_relaxed) == uint64_t(recordWords);
+}
+
+bool MoxyAnalysisCache::find(const uint64_t levelHash, MoxySolver::solveOutcome &outcome) const
+{
+	if (!words)
+		return false;
+
+	const uint64_t key = keyOf(levelHash);
+	uint64_t copy[recordWords];
+	for (int probe = 0; probe < probeLimit; probe++)
+	{
+		const int slot = int((key + probe) & (capacity - 1));
+		if (!readRecord(recordAt(slot), copy))
+			return false; // Being written over and over. Cheaper to work it out than keep waiting.
+		if (copy[KEY] == 0)
+			return false;
+		if (copy[KEY] != key)
+			continue;
+
+		const uint64_t summary = copy[SUMMARY];
+		outcome = MoxySolver::solveOutcome();
+		outcome.result = static_cast<MoxySolver::Result>(summary & 0xFFFF);
+		outcome.turnsUsed = int((summary >> 16) & 0xFFFF);
+		const int numActions = int((summary >> 32) & 0xFFFF);
+		outcome.stats.threads = int((summary >> 48) & 0xFFFF);
+		outcome.stats.expanded = static_cast<long long>(copy[EXPANDED]);
+		outcome.stats.generated = static_cast<long long>(copy[GENERATED]);
+		std::memcpy(&outcome.stats.seconds, &copy[SECONDS], sizeof(double));
+		outcome.stats.peakMemory = size_t(copy[PEAK_MEMORY]);
+
+		outcome.actions.reserve(numActions);
+		for (int i = 0; i < numActions; i++)
+		{
+			const uint64_t word = copy[firstActionWord + (i / actionsPerWord)];
+			outcome.actions.push_back(static_cast<MoxySim::Action>((word >> ((i % actionsPerWord) * 3)) & 7));
+		}
+		return true;
+	}
+	return false;
+}
+
+bool MoxyAnalysisCache::store(const uint64_t levelHash, const MoxySolver::solveOutcome &outcome)
+{
+	if (!words)
+		return false;
+	if (outcome.result == MoxySolver::Result::CANCELLED)
+		return false;
+	const int numActions = outcome.actions.size();
+	if (numActions > actionsMax)
+		return false;
+
+	const uint64_t key = keyOf(levelHash);
+	uint64_t copy[recordWords] = {};
+	copy[KEY] = key;
+	copy[SUMMARY] = uint64_t(outcome.result) | (uint64_t(uint16_t(outcome.turnsUsed)) << 16) |
+		(uint64_t(numActions) << 32) | (uint64_t(uint16_t(outcome.stats.threads)) << 48);
+	copy[EXPANDED] = uint64_t(outcome.stats.expanded);
+	copy[GENERATED] = uint64_t(outcome.stats.generated);
+	std::memcpy(&copy[SECONDS], &outcome.stats.seconds, sizeof(double));
+	copy[PEAK_MEMORY] = uint64_t(outcome.stats.peakMemory);
+	for (int i = 0; i < numActions; i++)
+		copy[firstActionWord + (i / actionsPerWord)] |= uint64_t(outcome.actions[i]) << ((i % actionsPerWord) * 3);
+
+	std::lock_guard<std::mutex> guard(writeMutex);
+	if (!writeLock.tryLock(lockWaitMs))
+		return false;
+
+	// Goes in the level's own record if it has one, or else the first empty one. With every probe taken, it pushes out whatever is in the first.
+	// Records are never emptied, so pushing one out never cuts off the records for other levels further along.
+	const int home = int(key & (capacity - 1));
+	std::atomic<uint64_t> *target = recordAt(home);
+	for (int probe = 0; probe < probeLimit; probe++)
+	{
+		std::atomic<uint64_t> *record = recordAt(int((key + probe) & (capacity - 1)));
+		const uint64_t recordKey = record[KEY].load(std::memory_order_relaxed);
+		if (recordKey == key || recordKey == 0)
+		{
+			target = record;
+			break;
+		}
+	}
+	writeRecord(target, copy);
+
+	writeLock.unlock();
+	return true;
+}
+
+bool MoxyAnalysisCache::readRecord(const std::atomic<uint64_t> *record, uint64_t *copy) const
+{
+	for (int attempt = 0; attempt < readAttempts; attempt++)
+	{
+		const uint64_t before = record[SEQUENCE].load(std::memory_order_acquire);
+		if (before & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		for (int i = 1; i < recordWords; i++)
+			copy[i] = record[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (record[SEQUENCE].load(std::memory_order_relaxed) == before)
+			return true;
+	}
+	return false;
+}
+
+void MoxyAnalysisCache::writeRecord(std::atomic<uint64_t> *record, const uint64_t *copy)
+{
+	// Odd for as long as the words are a mix of old and new, so no reader takes them as they are.
+	// It may be odd already if an instance was closed part way through writing it, and this evens it out again.
+	const uint64_t writing = record[SEQUENCE].load(std::memory_order_relaxed) | 1;
+	record[SEQUENCE].store(writing, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (int i = 1; i < recordWords; i++)
+		record[i].store(copy[i], std::memory_order_relaxed);
+	record[SEQUENCE].store(writing + 1, std::memory_order_release);
+}
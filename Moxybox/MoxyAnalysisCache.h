@@ -0,0 +1,98 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QLockFile>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include "MoxySim.h"
+#include "MoxySolver.h"
+
+// MoxyAnalysisCache keeps what's been worked out about levels in a file, so each level only has to be worked out once, not every time it's asked for.
+// For now that's MoxySolver's answer from the level's start: whether it can be solved, its par, the way to get it and what the search took,
+// which is also all a difficulty rating (MoxySolver::rate) needs.
+// Levels are looked up by MoxySim::getLevelHash, which goes by what's in a level rather than its ::Id=, so an edited level
+// is a new entry and gets worked out again, while an unchanged one is found in the one or two records its hash points at.
+//
+// The file is memory mapped and everything in it is a fixed size: a header, then a table of records using open addressing.
+// Readers never lock, from any thread or any instance of the game. Each record has a sequence number that's odd while it's being written,
+// and a reader that finds it odd, or changed by the time it's finished copying, copies again. Writes take a lock file, so there's only
+// ever one writer at a time, across instances too. A cache that can't be opened or locked just doesn't find or keep anything.
+class MoxyAnalysisCache
+{
+public:
+
+	// Bump whenever the record layout changes, MoxySim::getLevelHash changes, or the solver could give a different answer for the same level.
+	// A file from another version is started over.
+	// 2: Teleport order went into level hashes.
+	static const uint64_t formatVersion = 2;
+
+	explicit MoxyAnalysisCache(const QString &path);
+	~MoxyAnalysisCache();
+
+	bool isOpen() const { return words != nullptr; }
+
+	// Fills in outcome with what solving from the level's start gave last time, if it's kept.
+	bool find(const uint64_t levelHash, MoxySolver::solveOutcome &outcome) const;
+
+	// CANCELLED isn't kept, and nor are solutions of more than actionsMax actions. Returns whether it was kept.
+	// LIMIT_REACHED is, with the stats saying how far the search got, so a search that gave up isn't run over and over.
+	// It only holds for the limits it was given, and anything searching with bigger ones can go ahead and store over it.
+	bool store(const uint64_t levelHash, const MoxySolver::solveOutcome &outcome);
+
+private:
+
+	// Records are 32 words (256 bytes), and the header takes up one record's worth so the rest line up.
+	// Actions are 3 bits each, 21 to a word.
+	static const int capacity = 4096; // A power of two, well over the number of levels anyone has.
+	static const int probeLimit = 8;
+	static const int recordWords = 32;
+	static const int actionsPerWord = 21;
+	static const int firstActionWord = 7;
+	static const int actionsMax = (recordWords - firstActionWord) * actionsPerWord;
+	static const int readAttempts = 64;
+	static const int lockWaitMs = 100;
+	static const uint64_t magic = 0x5A4C4E4159584F4Dull; // Reads "MOXYANLZ" at the start of the file on little-endian machines.
+
+	// Word offsets within a record.
+	enum Word
+	{
+		SEQUENCE,
+		KEY, // Level hash, never 0. 0 is an empty record.
+		SUMMARY, // Result, turns used, number of actions and threads searched with, 16 bits each.
+		EXPANDED,
+		GENERATED,
+		SECONDS, // A double's bits.
+		PEAK_MEMORY
+	};
+
+	QFile file;
+	QLockFile writeLock;
+	std::mutex writeMutex; // QLockFile keeps out other instances. This keeps out other threads in this one.
+	uchar *mapped = nullptr;
+	std::atomic<uint64_t> *words = nullptr;
+
+	bool open();
+	bool headerMatches() const;
+	std::atomic<uint64_t>* recordAt(const int slot) const { return words + ((slot + 1) * recordWords); }
+	bool readRecord(const std::atomic<uint64_t> *record, uint64_t *copy) const;
+	void writeRecord(std::atomic<uint64_t> *record, const uint64_t *copy);
+
+	static qint64 fileSize() { return qint64(capacity + 1) * recordWords * sizeof(uint64_t); }
+	static uint64_t keyOf(const uint64_t levelHash) { return levelHash == 0 ? 1 : levelHash; }
+};
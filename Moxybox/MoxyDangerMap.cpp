@@ -0,0 +1,162 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyDangerMap.h"
+
+MoxyDangerMap::MoxyDangerMap(const int newHorizon)
+{
+	setHorizon(newHorizon);
+}
+
+void MoxyDangerMap::setHorizon(const int newHorizon)
+{
+	horizon = newHorizon < 1 ? 1 : (newHorizon > horizonMax ? horizonMax : newHorizon);
+	head = 0;
+	slices.clear();
+	patrollers.clear();
+	threatened = MoxySim::simBitboard();
+}
+
+void MoxyDangerMap::rebuild(const MoxySim &sim)
+{
+	const auto& state = sim.getState();
+	head = 0;
+	slices.assign(horizon, MoxySim::simLayer());
+	patrollers.clear();
+	for (size_t i = 0; i < state.pushers.size(); i++)
+		patrollers.emplace_back(tracked{ false, {} });
+	for (size_t i = 0; i < state.suckers.size(); i++)
+		patrollers.emplace_back(tracked{ true, {} });
+
+	const int numPatrollers = patrollers.size();
+	for (int i = 0; i < numPatrollers; i++)
+		predict(patrollerDef(sim, i), i, patrollerNow(sim, i));
+	collect();
+}
+
+void MoxyDangerMap::advance(const MoxySim &sim)
+{
+	const auto& state = sim.getState();
+	if (int(slices.size()) != horizon || patrollers.size() != state.pushers.size() + state.suckers.size())
+	{
+		rebuild(sim);
+		return;
+	}
+
+	const auto same = [](const MoxySim::simPatroller &a, const MoxySim::simPatroller &b) {
+		return a.pos == b.pos && a.facing == b.facing;
+	};
+
+	// The slice for the turn just played becomes the one for the new furthest turn, a step on from the old furthest.
+	const int arrived = head;
+	const int furthest = slot(horizon);
+	const int numPatrollers = patrollers.size();
+	std::vector<int> strayed;
+	for (int i = 0; i < numPatrollers; i++)
+	{
+		tracked& t = patrollers[i];
+		const MoxySim::simPatroller predicted = t.ahead[arrived];
+		const MoxySim::simPatroller next = MoxySim::patrolStep(patrollerDef(sim, i), t.ahead[furthest]);
+		mark(slices[arrived], predicted, t.sucker, false);
+		t.ahead[arrived] = next;
+		mark(slices[arrived], next, t.sucker, true);
+		if (!same(predicted, patrollerNow(sim, i)))
+			strayed.push_back(i);
+	}
+	head = (head + 1) % horizon;
+
+	for (const int i : strayed)
+		predict(patrollerDef(sim, i), i, patrollerNow(sim, i));
+	collect();
+}
+
+int MoxyDangerMap::getSoonest(const int cell) const
+{
+	if (cell < 0 || slices.empty())
+		return 0;
+	for (int turns = 1; turns <= horizon; turns++)
+	{
+		if (slices[slot(turns)].test(cell))
+			return turns;
+	}
+	return 0;
+}
+
+void MoxyDangerMap::mark(MoxySim::simLayer &layer, const MoxySim::simPatroller &patroller, const bool sucker, const bool add)
+{
+	const auto apply = [&](const int cell) {
+		if (add)
+			layer.add(cell);
+		else
+			layer.remove(cell);
+	};
+
+	const MoxySim::simPoint& pos = patroller.pos;
+	const int cell = MoxySim::cellIndex(pos);
+	apply(cell);
+	if (!sucker || cell < 0)
+		return;
+
+	// A magnet pulls from exactly suckRange away along a row or column.
+	const int range = MoxySim::suckRange;
+	if (pos.x - range >= 0)
+		apply(cell - range);
+	if (pos.x + range < MoxySim::gridRowSize)
+		apply(cell + range);
+	if (pos.y - range >= 0)
+		apply(cell - (range * MoxySim::gridRowSize));
+	if (pos.y + range < MoxySim::gridColSize)
+		apply(cell + (range * MoxySim::gridRowSize));
+}
+
+void MoxyDangerMap::predict(const MoxySim::simPatrollerDef &def, const int index, const MoxySim::simPatroller &from)
+{
+	tracked& t = patrollers[index];
+	if (!t.ahead.empty())
+	{
+		for (int turns = 1; turns <= horizon; turns++)
+			mark(slices[slot(turns)], t.ahead[slot(turns)], t.sucker, false);
+	}
+
+	t.ahead.resize(horizon);
+	MoxySim::simPatroller step = from;
+	for (int turns = 1; turns <= horizon; turns++)
+	{
+		step = MoxySim::patrolStep(def, step);
+		t.ahead[slot(turns)] = step;
+		mark(slices[slot(turns)], step, t.sucker, true);
+	}
+}
+
+void MoxyDangerMap::collect()
+{
+	threatened = MoxySim::simBitboard();
+	for (const auto& slice : slices)
+	{
+		for (int i = 0; i < MoxySim::simBitboard::wordCount; i++)
+			threatened.words[i] |= slice.bits.words[i];
+	}
+}
+
+const MoxySim::simPatrollerDef& MoxyDangerMap::patrollerDef(const MoxySim &sim, const int index)
+{
+	const int numPushers = sim.getLevel().pushers.size();
+	return index < numPushers ? sim.getLevel().pushers[index] : sim.getLevel().suckers[index - numPushers];
+}
+
+const MoxySim::simPatroller& MoxyDangerMap::patrollerNow(const MoxySim &sim, const int index)
+{
+	const int numPushers = sim.getState().pushers.size();
+	return index < numPushers ? sim.getState().pushers[index] : sim.getState().suckers[index - numPushers];
+}
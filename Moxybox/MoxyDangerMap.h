@@ -0,0 +1,77 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MoxySim.h"
+#include <vector>
+
+// MoxyDangerMap marks the squares patrollers threaten over the next few turns: wherever a pusher will be (it knocks the player back),
+// and wherever a magnet patroller will be or pull the player from (exactly MoxySim::suckRange away in line with it).
+// Predictions follow each patroller's patrol as it goes when nothing disturbs it. A trap can change that, and the map catches up the turn it does.
+//
+// It's kept up to date a turn at a time, not worked out again from scratch. Each turn ahead is a layer of the grid, and the layers are a ring:
+// once a turn is played, the layer for the turn just reached is cleared out and reused for the new furthest turn, so that's the only turn
+// predicted, at one patrol step per patroller. A patroller that didn't end up where it was predicted to is the only one predicted all over again.
+class MoxyDangerMap
+{
+public:
+
+	static const int horizonDefault = 4;
+	static const int horizonMax = 32;
+
+	explicit MoxyDangerMap(const int newHorizon = horizonDefault);
+
+	// After a turn that used up the player's turn (playerTurn returned anything but BLOCKED), so the patrollers have moved.
+	void advance(const MoxySim &sim);
+
+	// After anything else that moves patrollers: load, reset, setState, undo, redo.
+	void rebuild(const MoxySim &sim);
+
+	// Turns looked ahead, from 1 to horizonMax. Empties the map until the next rebuild.
+	void setHorizon(const int newHorizon);
+	int getHorizon() const { return horizon; }
+
+	// Squares threatened on any turn up to the horizon.
+	const MoxySim::simBitboard& getThreatened() const { return threatened; }
+
+	// Squares threatened exactly this many turns from now (1 to getHorizon()).
+	const MoxySim::simBitboard& getThreatenedIn(const int turns) const { return slices[slot(turns)].bits; }
+
+	// How many turns until a square is first threatened, or 0 if it isn't within the horizon.
+	int getSoonest(const int cell) const;
+
+private:
+
+	// Every patroller in the level, pushers then suckers, with where it's predicted to be in the same ring order as slices.
+	struct tracked
+	{
+		bool sucker;
+		std::vector<MoxySim::simPatroller> ahead;
+	};
+
+	int horizon = horizonDefault;
+	int head = 0; // The slice for one turn from now.
+	std::vector<MoxySim::simLayer> slices;
+	std::vector<tracked> patrollers;
+	MoxySim::simBitboard threatened;
+
+	int slot(const int turns) const { return (head + turns - 1) % horizon; }
+	void mark(MoxySim::simLayer &layer, const MoxySim::simPatroller &patroller, const bool sucker, const bool add);
+	void predict(const MoxySim::simPatrollerDef &def, const int index, const MoxySim::simPatroller &from);
+	void collect();
+
+	static const MoxySim::simPatrollerDef& patrollerDef(const MoxySim &sim, const int index);
+	static const MoxySim::simPatroller& patrollerNow(const MoxySim &sim, const int index);
+};
@@ -0,0 +1,530 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyExternalSearch.h"
+#include "MoxySolver.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+
+
+// A file of seen states, and where its blocks start. The index is one record a block, so a few hundredths of a byte a state.
+struct MoxyExternalSearch::seenFile
+{
+	std::string name;
+	long long records = 0;
+	std::vector<long long> blockOffsets;
+	std::vector<uint8_t> blockFirsts; // Each block's first record, one after another.
+};
+
+// Writes records in sorted order, each as the number of bytes it shares with the one before and then the rest.
+// Every blockBytes or so a block starts, whose first record is written whole so reading can start there.
+struct MoxyExternalSearch::runWriter
+{
+	std::vector<char> buffer;
+	std::vector<uint8_t> previous;
+	FILE *file;
+	const int recordSize;
+	seenFile *index; // Where to note where blocks start, if anywhere.
+	long long records = 0;
+	long long bytes = 0;
+	long long blockStart = 0;
+
+	runWriter(const std::string &path, const int newRecordSize, seenFile *newIndex = nullptr)
+		: buffer(fileBufferSize), previous(newRecordSize), file(fopen(path.c_str(), "wb")), recordSize(newRecordSize), index(newIndex)
+	{
+		if (file)
+			setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+	}
+	~runWriter() { close(); }
+
+	void write(const uint8_t *record)
+	{
+		int shared = 0;
+		if (records == 0 || bytes - blockStart >= blockBytes)
+		{
+			blockStart = bytes;
+			if (index)
+			{
+				index->blockOffsets.push_back(bytes);
+				index->blockFirsts.insert(index->blockFirsts.end(), record, record + recordSize);
+			}
+		}
+		else
+		{
+			// The count is a byte, so states longer than 255 bytes share at most that much.
+			const int sharedMax = std::min(recordSize, 255);
+			while (shared < sharedMax && record[shared] == previous[shared])
+				shared++;
+		}
+		fputc(shared, file);
+		fwrite(record + shared, 1, recordSize - shared, file);
+		std::memcpy(previous.data(), record, recordSize);
+		records++;
+		bytes += 1 + recordSize - shared;
+	}
+
+	// False if anything along the way failed to write.
+	bool close()
+	{
+		if (!file)
+			return false;
+		const bool written = !ferror(file);
+		const bool closed = fclose(file) == 0;
+		file = nullptr;
+		if (index)
+			index->records = records;
+		return written && closed;
+	}
+};
+
+struct MoxyExternalSearch::runReader
+{
+	std::vector<char> buffer;
+	std::vector<uint8_t> current;
+	FILE *file;
+	const int recordSize;
+	long long position = 0; // Where the record after current starts.
+	long long bytes = 0;
+	bool failed;
+
+	runReader(const std::string &path, const int newRecordSize, const size_t bufferSize = fileBufferSize)
+		: buffer(bufferSize), current(newRecordSize), file(fopen(path.c_str(), "rb")), recordSize(newRecordSize), failed(file == nullptr)
+	{
+		if (file)
+			setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+	}
+	~runReader()
+	{
+		if (file)
+			fclose(file);
+	}
+
+	// Reads the next record into current. False at the end of the file, or if it's cut short (failed is then set).
+	bool next()
+	{
+		if (failed)
+			return false;
+		const int shared = fgetc(file);
+		if (shared == EOF)
+		{
+			failed = ferror(file) != 0;
+			return false;
+		}
+		const size_t rest = size_t(recordSize - shared);
+		if (shared > recordSize || fread(current.data() + shared, 1, rest, file) != rest)
+		{
+			failed = true;
+			return false;
+		}
+		position += 1 + rest;
+		bytes += 1 + rest;
+		return true;
+	}
+
+	// Moves on to the start of a block, which has to be ahead of where it's got to.
+	void skipTo(const long long blockOffset)
+	{
+		// Plain fseek only takes a long, which is 32 bits on Windows, and seen files can be bigger than that.
+#ifdef _WIN32
+		if (!failed && _fseeki64(file, blockOffset, SEEK_SET) != 0)
+#else
+		if (!failed && fseeko(file, off_t(blockOffset), SEEK_SET) != 0)
+#endif
+			failed = true;
+		position = blockOffset;
+	}
+};
+
+// Everything one enumerate call works with.
+struct MoxyExternalSearch::search
+{
+	const searchLimits &limits;
+	searchStats &stats;
+	MoxySim sim;
+	const int recordSize;
+
+	// States waiting to go into the next run, and the order to write them in.
+	std::vector<uint8_t> pending;
+	std::vector<uint32_t> order;
+	size_t pendingMax;
+	size_t pendingCount = 0;
+
+	// Sorted, and no state is in more than one. The newest is the layer being expanded.
+	std::vector<seenFile> seen;
+	std::vector<std::string> runs;
+	long long filesNamed = 0;
+	std::map<std::string, long long> fileBytes; // Every search file on disk now, for diskPeak and cleaning up.
+	bool failed = false;
+
+	search(const MoxySim::simLevel &level, const searchLimits &newLimits, searchStats &newStats)
+		: limits(newLimits), stats(newStats), sim(level), recordSize(1 + sim.getPackedSize())
+	{
+		pendingMax = std::max(size_t(1024), limits.bufferMemory / (size_t(recordSize) + sizeof(uint32_t)));
+		pending.resize(pendingMax * recordSize);
+		order.reserve(pendingMax);
+	}
+
+	std::string newName(const char *kind) { return kind + std::to_string(filesNamed++); }
+	std::string path(const std::string &name) const { return limits.folder + "/moxybfs_" + name; }
+
+	void closed(const std::string &name, runWriter &writer)
+	{
+		if (!writer.close())
+			failed = true;
+		fileBytes[name] = writer.bytes;
+		stats.bytesWritten += writer.bytes;
+
+		long long onDisk = 0;
+		for (const auto& file : fileBytes)
+			onDisk += file.second;
+		stats.diskPeak = std::max(stats.diskPeak, onDisk);
+	}
+
+	void read(runReader &reader)
+	{
+		if (reader.failed)
+			failed = true;
+		stats.bytesRead += reader.bytes;
+	}
+
+	void remove(const std::string &name)
+	{
+		std::remove(path(name).c_str());
+		fileBytes.erase(name);
+	}
+
+	// What's held in memory besides the sim: pending states, the seen files' indexes, and a buffer for every file open at once.
+	void noteMemory(const int filesOpen)
+	{
+		size_t memory = pending.size() + (pendingMax * sizeof(uint32_t)) + (filesOpen * fileBufferSize);
+		for (const auto& file : seen)
+			memory += file.blockFirsts.size() + (file.blockOffsets.size() * sizeof(long long));
+		stats.peakMemory = std::max(stats.peakMemory, memory);
+	}
+
+	bool less(const uint8_t *a, const uint8_t *b) const { return std::memcmp(a, b, recordSize) < 0; }
+	bool same(const uint8_t *a, const uint8_t *b) const { return std::memcmp(a, b, recordSize) == 0; }
+
+	void add(const Ending ending)
+	{
+		uint8_t* record = &pending[pendingCount * recordSize];
+		record[0] = ending;
+		sim.packState(record + 1);
+		if (++pendingCount == pendingMax)
+			writeRun();
+	}
+
+	// Sorts what's pending and writes it out as a run, once each.
+	void writeRun()
+	{
+		if (pendingCount == 0)
+			return;
+		order.resize(pendingCount);
+		for (size_t i = 0; i < pendingCount; i++)
+			order[i] = uint32_t(i);
+		const uint8_t* base = pending.data();
+		std::sort(order.begin(), order.end(), [&](const uint32_t a, const uint32_t b) { return less(base + (size_t(a) * recordSize), base + (size_t(b) * recordSize)); });
+
+		const std::string name = newName("run");
+		runWriter writer(path(name), recordSize);
+		if (!writer.file)
+		{
+			failed = true;
+			return;
+		}
+		const uint8_t* previous = nullptr;
+		for (const uint32_t i : order)
+		{
+			const uint8_t* record = base + (size_t(i) * recordSize);
+			if (previous == nullptr || !same(previous, record))
+				writer.write(record);
+			previous = record;
+		}
+		closed(name, writer);
+		runs.push_back(name);
+		stats.runs++;
+		pendingCount = 0;
+		noteMemory(1);
+	}
+
+	// Streams the union of some sorted files, in order and once each, deleting them as it goes.
+	void mergeFiles(const std::vector<std::string> &names, const std::function<void(const uint8_t*)> &emit)
+	{
+		std::vector<std::unique_ptr<runReader>> readers;
+		for (const auto& name : names)
+			readers.emplace_back(new runReader(path(name), recordSize));
+
+		const auto later = [&](const int a, const int b) { return less(readers[b]->current.data(), readers[a]->current.data()); };
+		std::priority_queue<int, std::vector<int>, decltype(later)> heads(later);
+		for (int i = 0; i < int(readers.size()); i++)
+		{
+			if (readers[i]->next())
+				heads.push(i);
+		}
+
+		std::vector<uint8_t> last(recordSize);
+		bool any = false;
+		while (!heads.empty())
+		{
+			const int i = heads.top();
+			heads.pop();
+			const uint8_t* record = readers[i]->current.data();
+			if (!any || !same(last.data(), record))
+			{
+				emit(record);
+				std::memcpy(last.data(), record, recordSize);
+				any = true;
+			}
+			if (readers[i]->next())
+				heads.push(i);
+		}
+
+		for (auto& reader : readers)
+			read(*reader);
+		readers.clear();
+		for (const auto& name : names)
+			remove(name);
+	}
+
+	// Seen files are kept few by merging the newest two whenever the newer has grown to half the size of the older,
+	// like carrying in binary addition. So there are only ever about log2(states) of them, and a state is rewritten about that many times,
+	// rather than every seen state being rewritten every layer.
+	void mergeSeen()
+	{
+		while (seen.size() >= 2 && seen[seen.size() - 1].records * 2 >= seen[seen.size() - 2].records)
+		{
+			const std::vector<std::string> pair = { seen[seen.size() - 2].name, seen[seen.size() - 1].name };
+			seen.pop_back();
+			seen.pop_back();
+
+			seenFile merged;
+			merged.name = newName("seen");
+			runWriter writer(path(merged.name), recordSize, &merged);
+			if (!writer.file)
+			{
+				failed = true;
+				return;
+			}
+			mergeFiles(pair, [&](const uint8_t *record) { writer.write(record); });
+			closed(merged.name, writer);
+			seen.push_back(std::move(merged));
+		}
+	}
+
+	// Reads through a seen file alongside states coming in order, to say whether each is in it.
+	// States coming in are often far apart in the file (a small layer checked against millions of states),
+	// so it skips ahead to the block a state would be in rather than reading everything before it. It never goes back.
+	struct seenCursor
+	{
+		const seenFile &file;
+		runReader reader;
+		bool valid;
+
+		seenCursor(const search &s, const seenFile &newFile)
+			: file(newFile), reader(s.path(newFile.name), s.recordSize, cursorBufferSize)
+		{
+			valid = reader.next();
+		}
+	};
+
+	bool contains(seenCursor &cursor, const uint8_t *record) const
+	{
+		runReader& reader = cursor.reader;
+		if (cursor.valid && less(reader.current.data(), record))
+		{
+			// The last block starting at or before the record. There's one, since the cursor's already past the first.
+			const seenFile& file = cursor.file;
+			size_t low = 0;
+			size_t high = file.blockOffsets.size();
+			while (high - low > 1)
+			{
+				const size_t middle = (low + high) / 2;
+				if (less(record, &file.blockFirsts[middle * recordSize]))
+					high = middle;
+				else
+					low = middle;
+			}
+			if (file.blockOffsets[low] > reader.position)
+			{
+				reader.skipTo(file.blockOffsets[low]);
+				cursor.valid = reader.next();
+			}
+			while (cursor.valid && less(reader.current.data(), record))
+				cursor.valid = reader.next();
+		}
+		return cursor.valid && same(reader.current.data(), record);
+	}
+
+	// Merges the layer's runs together and checks them against every seen file. States in none of them are the next layer,
+	// which becomes the newest seen file. Returns how many there were.
+	long long nextLayer(long long &won, long long &lost)
+	{
+		// Too many runs to have open at once are merged a group at a time into fewer, bigger runs first.
+		while (int(runs.size()) > mergeWidth)
+		{
+			const std::vector<std::string> group(runs.begin(), runs.begin() + mergeWidth);
+			runs.erase(runs.begin(), runs.begin() + mergeWidth);
+
+			const std::string name = newName("run");
+			runWriter writer(path(name), recordSize);
+			if (!writer.file)
+			{
+				failed = true;
+				return 0;
+			}
+			mergeFiles(group, [&](const uint8_t *record) { writer.write(record); });
+			closed(name, writer);
+			runs.push_back(name);
+		}
+
+		std::vector<std::unique_ptr<seenCursor>> cursors;
+		for (const auto& file : seen)
+			cursors.emplace_back(new seenCursor(*this, file));
+
+		seenFile layer;
+		layer.name = newName("seen");
+		runWriter writer(path(layer.name), recordSize, &layer);
+		if (!writer.file)
+		{
+			failed = true;
+			return 0;
+		}
+		noteMemory(int(runs.size()) + 1 + int((cursors.size() * cursorBufferSize) / fileBufferSize));
+
+		const std::vector<std::string> layerRuns = std::move(runs);
+		runs.clear();
+		mergeFiles(layerRuns, [&](const uint8_t *record) {
+			for (auto& cursor : cursors)
+			{
+				if (contains(*cursor, record))
+					return;
+			}
+			writer.write(record);
+			if (record[0] == WON)
+				won++;
+			else if (record[0] == LOST)
+				lost++;
+		});
+
+		for (auto& cursor : cursors)
+			read(cursor->reader);
+		closed(layer.name, writer);
+		const long long added = layer.records;
+		if (added > 0)
+			seen.push_back(std::move(layer));
+		else
+			remove(layer.name);
+		return added;
+	}
+
+	void cleanUp()
+	{
+		std::vector<std::string> names;
+		for (const auto& file : fileBytes)
+			names.push_back(file.first);
+		for (const auto& name : names)
+			remove(name);
+	}
+};
+
+MoxyExternalSearch::searchStats MoxyExternalSearch::enumerate(const MoxySim::simLevel &level, const searchLimits &limits)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	searchStats stats;
+	search s(level, limits, stats);
+
+	// The start is the first layer, and the first state seen.
+	{
+		std::vector<uint8_t> start(s.recordSize);
+		start[0] = PLAYING;
+		s.sim.packState(start.data() + 1);
+
+		seenFile first;
+		first.name = s.newName("seen");
+		runWriter writer(s.path(first.name), s.recordSize, &first);
+		if (writer.file)
+			writer.write(start.data());
+		s.closed(first.name, writer);
+		s.seen.push_back(std::move(first));
+		stats.states = 1;
+		stats.layerStates.push_back(1);
+	}
+
+	while (!s.failed)
+	{
+		// Expands the layer with undo, like MoxySolver, and only keeps what changed something.
+		// States that ended the level are kept (so they're counted once each) but go no further.
+		{
+			runReader layer(s.path(s.seen.back().name), s.recordSize);
+			while (layer.next())
+			{
+				if (limits.cancel != nullptr && limits.cancel->load(std::memory_order_relaxed))
+				{
+					stats.result = Result::CANCELLED;
+					break;
+				}
+				if (layer.current[0] != PLAYING)
+					continue;
+
+				s.sim.unpackState(layer.current.data() + 1);
+				for (const MoxySim::Action action : MoxySolver::actionsAll)
+				{
+					const MoxySim::TurnResult result = s.sim.playerTurn(action);
+					if (!s.sim.canUndo())
+						continue;
+					s.add(result == MoxySim::TurnResult::COMPLETE ? WON : result == MoxySim::TurnResult::FAILED ? LOST : PLAYING);
+					s.sim.undo();
+				}
+			}
+			s.read(layer);
+		}
+		if (stats.result == Result::CANCELLED)
+			break;
+		s.writeRun();
+
+		// The layer's been expanded, so it can be merged in with older seen states now.
+		s.mergeSeen();
+
+		long long won = 0;
+		long long lost = 0;
+		const long long added = s.nextLayer(won, lost);
+		if (s.failed || added == 0)
+			break;
+
+		if (won > 0 && stats.shortestWin < 0)
+			stats.shortestWin = int(stats.layerStates.size());
+		stats.layerStates.push_back(added);
+		stats.states += added;
+		stats.wonStates += won;
+		stats.lostStates += lost;
+
+		if (limits.maxStates > 0 && stats.states >= limits.maxStates)
+		{
+			stats.result = Result::LIMIT_REACHED;
+			break;
+		}
+	}
+
+	if (s.failed)
+		stats.result = Result::FILE_ERROR;
+	s.cleanUp();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return stats;
+}
@@ -0,0 +1,94 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MoxySim.h"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// MoxyExternalSearch finds every state a level can reach from its start, for levels with too many to hold in memory.
+// It's breadth-first on actions (any action that changes something, turn or not), one layer at a time, and the layers live on disk.
+//
+// Expanding a layer streams it in and collects the states it leads to in a fixed-size buffer. Each time the buffer fills,
+// it's sorted, duplicates in it are dropped, and it's written out as a run. The runs are then merged into one sorted stream,
+// dropping duplicates across runs, and checked against the sorted files of states seen in earlier layers, dropping the ones in them.
+// What's left is the next layer, written out as it goes as the newest seen file.
+// So duplicates are found late, in bulk, by merging sorted files, and every file is written front to back and read the same way,
+// only ever skipping ahead.
+// Memory is the buffer, a few file buffers and a small index of each seen file, however many states there are.
+// The disk needs room for every state seen, and the newest layer's runs.
+//
+// Files hold packed states (MoxySim::packState) with a byte in front saying whether the state ended the level.
+// Sorted states share a lot with the one before (the same gates shut, the same patrollers in the same places), so each is
+// written as how many bytes it starts with in common with the previous one, then the rest.
+class MoxyExternalSearch
+{
+public:
+
+	enum class Result { COMPLETE, LIMIT_REACHED, CANCELLED, FILE_ERROR };
+
+	struct searchLimits
+	{
+		// Where the run and seen-state files go while searching. They're deleted at the end.
+		// Somewhere on a local disk is best. Two searches at once need folders of their own.
+		std::string folder = ".";
+
+		size_t bufferMemory = size_t(64) << 20; // Bytes for states waiting to be written as a run.
+		long long maxStates = 0; // Stops with LIMIT_REACHED once a whole layer takes the distinct states past this. 0 for no limit.
+		const std::atomic<bool> *cancel = nullptr; // Checked between states, like MoxySolver::solveLimits::cancel.
+	};
+
+	struct searchStats
+	{
+		Result result = Result::COMPLETE;
+
+		long long states = 0; // Distinct states reached, start and ends included.
+		long long wonStates = 0;
+		long long lostStates = 0; // Out of turns or on a hazard.
+		int shortestWin = -1; // Actions in the shortest win, or -1 with none. Can be more than par, since turning on the spot counts.
+		std::vector<long long> layerStates; // New states at each depth in actions, from the start's layer (1 state) on.
+
+		long long runs = 0; // Sorted runs written across every layer.
+		long long bytesWritten = 0;
+		long long bytesRead = 0; // Bytes of records read. Blocks skipped over aren't counted.
+		long long diskPeak = 0; // Bytes of search files on disk at once, at most.
+		size_t peakMemory = 0;
+		double seconds = 0;
+	};
+
+	static searchStats enumerate(const MoxySim::simLevel &level, const searchLimits &limits);
+	static searchStats enumerate(const MoxySim::simLevel &level) { return enumerate(level, searchLimits()); }
+
+private:
+
+	// First byte of every record.
+	enum Ending : uint8_t { PLAYING, WON, LOST };
+
+	// Runs merged at once. More than this are merged in groups first, which keeps open files down.
+	static const int mergeWidth = 64;
+	static const size_t fileBufferSize = size_t(256) << 10; // Each file's read or write buffer, so reads and writes go in big sequential pieces.
+
+	// Checking a layer against a seen file can skip whole blocks of it. Blocks are small so skipping can skip a lot,
+	// and buffers for reading seen files are a few blocks, so a skip doesn't read much it won't use.
+	static const int blockBytes = 4096;
+	static const size_t cursorBufferSize = blockBytes * 4;
+
+	struct seenFile;
+	struct runWriter;
+	struct runReader;
+	struct search;
+};
@@ -0,0 +1,172 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyHintEngine.h"
+
+MoxyHintEngine::MoxyHintEngine(QObject *parent)
+	: QObject(parent)
+{
+	// Queued connections copy the arguments into an event, so Qt has to know these types by the names the signal uses.
+	qRegisterMetaType<MoxyHintEngine::HintResult>("MoxyHintEngine::HintResult");
+	qRegisterMetaType<MoxySim::Action>("MoxySim::Action");
+	worker = std::thread(&MoxyHintEngine::loop, this);
+}
+
+MoxyHintEngine::~MoxyHintEngine()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+		cancelSearch.store(true);
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void MoxyHintEngine::setLevel(const MoxySim::simLevel &newLevel)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	pendingLevel = newLevel;
+	levelPending = true;
+	statePending = false;
+	cancelSearch.store(true);
+}
+
+int MoxyHintEngine::request(const MoxySim::simState &state)
+{
+	int id;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		id = ++requestNext;
+		pendingState = state;
+		pendingId = id;
+		pendingStamp = std::chrono::steady_clock::now();
+		statePending = true;
+		cancelSearch.store(true);
+	}
+	wake.notify_one();
+	return id;
+}
+
+void MoxyHintEngine::cancel()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	statePending = false;
+	cancelSearch.store(true);
+}
+
+void MoxyHintEngine::loop()
+{
+	MoxySolver::solveLimits limits;
+	limits.maxStates = hintMaxStates;
+	limits.cancel = &cancelSearch;
+
+	for (;;)
+	{
+		MoxySim::simState state;
+		int id;
+		std::chrono::steady_clock::time_point stamp;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this]() { return stopping || statePending; });
+			if (stopping)
+				return;
+
+			if (levelPending)
+			{
+				level = pendingLevel;
+				sim.load(level);
+				lostCheck = std::make_unique<MoxySolver::distanceHeuristic>(level);
+				planHashes.clear();
+				planActions.clear();
+				planTurns.clear();
+				levelPending = false;
+			}
+			state = pendingState;
+			id = pendingId;
+			stamp = pendingStamp;
+			statePending = false;
+
+			// Cleared while still holding the lock, so a request coming in after this is sure to cancel what we're about to start.
+			cancelSearch.store(false);
+		}
+
+		const auto answer = [&](const HintResult result, const MoxySim::Action action, const int turnsToWin) {
+			const qint64 latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stamp).count();
+			emit hintReady(id, result, action, turnsToWin, latency);
+		};
+
+		// Somewhere along the last way to win (the player took the hint, or undid back onto the path).
+		sim.setState(state);
+		const uint64_t hash = sim.getHash();
+		bool known = false;
+		for (size_t i = 0; i < planHashes.size() && !known; i++)
+		{
+			if (planHashes[i] == hash)
+			{
+				answer(HintResult::MOVE, planActions[i], planTurns[i]);
+				known = true;
+			}
+		}
+		if (known)
+			continue;
+
+		// Plenty of positions can be seen to be lost without searching.
+		if (lostCheck.get()->isLost(state))
+		{
+			answer(HintResult::NO_WIN, MoxySim::Action::NONE, 0);
+			continue;
+		}
+
+		const MoxySolver::solveOutcome outcome = MoxySolver::solve(level, state, limits);
+		switch (outcome.result)
+		{
+		case MoxySolver::Result::SOLVED:
+			keepPlan(state, outcome.actions);
+			answer(HintResult::MOVE, outcome.actions.front(), outcome.turnsUsed);
+			break;
+		case MoxySolver::Result::UNSOLVABLE:
+			answer(HintResult::NO_WIN, MoxySim::Action::NONE, 0);
+			break;
+		case MoxySolver::Result::LIMIT_REACHED:
+			answer(HintResult::GAVE_UP, MoxySim::Action::NONE, 0);
+			break;
+		case MoxySolver::Result::CANCELLED:
+			// The player has moved on already. Whatever they're on now is waiting to be picked up.
+			break;
+		}
+	}
+}
+
+void MoxyHintEngine::keepPlan(const MoxySim::simState &from, const std::vector<MoxySim::Action> &actions)
+{
+	// Plays the solution through once to note down the state before each action and the turns still to go from it.
+	planHashes.clear();
+	planActions.clear();
+	planTurns.clear();
+
+	sim.setState(from);
+	std::vector<int> turnsTaken;
+	int turns = 0;
+	for (const MoxySim::Action action : actions)
+	{
+		planHashes.push_back(sim.getHash());
+		planActions.push_back(action);
+		turnsTaken.push_back(turns);
+		if (sim.playerTurn(action) != MoxySim::TurnResult::BLOCKED)
+			turns++;
+	}
+	for (const int taken : turnsTaken)
+		planTurns.push_back(turns - taken);
+}
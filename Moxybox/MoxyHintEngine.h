@@ -0,0 +1,102 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QMetaType>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "MoxySim.h"
+#include "MoxySolver.h"
+
+// MoxyHintEngine works out the player's best next move in the background, so a hint never holds up the GUI thread.
+// GameplayScreen hands it a copy of the engine state after every turn, and it searches from there (MoxySolver::solve)
+// on a thread of its own. The answer comes back through hintReady, which GameplayScreen connects with Qt::QueuedConnection,
+// so it's handled on the GUI thread between events like anything else. A new request cancels the search for the last one straight away.
+//
+// Once a search finds a way to win, the engine keeps the whole of it. A player taking the hint (or undoing back onto the path)
+// lands on a state it already knows the answer for, so those hints come back without searching at all.
+class MoxyHintEngine : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum class HintResult
+	{
+		MOVE, // action is a move on a shortest way to win from here.
+		NO_WIN, // There's no way to win from here in the turns remaining.
+		GAVE_UP // The search hit its limits first.
+	};
+
+	MoxyHintEngine(QObject *parent = nullptr);
+	~MoxyHintEngine();
+
+	// The level every request after this is for. Forgets anything worked out for the last one.
+	void setLevel(const MoxySim::simLevel &level);
+
+	// Starts looking for a hint from this state, dropping any search still going. Returns the request's number.
+	// Answers carry it, so one that was already on its way for an older request can be told apart and ignored.
+	int request(const MoxySim::simState &state);
+
+	// Drops the current search without starting another, e.g. once the level is over.
+	void cancel();
+
+signals:
+	// turnsToWin is the turns winning takes from the requested state, when result is MOVE.
+	// latencyNs is how long it took from the request to this answer.
+	void hintReady(int requestId, MoxyHintEngine::HintResult result, MoxySim::Action action, int turnsToWin, qint64 latencyNs);
+
+private:
+
+	// Enough for the shipped levels from any state, at around 100 bytes a state.
+	const long long hintMaxStates = 500000;
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::atomic<bool> cancelSearch{ false };
+
+	// Handed over under lock. Only the newest request is kept, anything older is already stale.
+	bool stopping = false;
+	bool levelPending = false;
+	bool statePending = false;
+	MoxySim::simLevel pendingLevel;
+	MoxySim::simState pendingState;
+	int pendingId = 0;
+	std::chrono::steady_clock::time_point pendingStamp;
+	int requestNext = 0;
+
+	// Only the worker thread touches these.
+	// plan is the last way to win found. planHashes[i] is MoxySim::getHash of the state planActions[i] is taken from,
+	// and planTurns[i] the turns left to win from there.
+	MoxySim::simLevel level;
+	MoxySim sim;
+	std::unique_ptr<MoxySolver::distanceHeuristic> lostCheck;
+	std::vector<uint64_t> planHashes;
+	std::vector<MoxySim::Action> planActions;
+	std::vector<int> planTurns;
+
+	void loop();
+	void keepPlan(const MoxySim::simState &from, const std::vector<MoxySim::Action> &actions);
+};
+
+Q_DECLARE_METATYPE(MoxyHintEngine::HintResult)
+Q_DECLARE_METATYPE(MoxySim::Action)
@@ -0,0 +1,335 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyLevelFile.h"
+#include <cstring>
+#include <cstdint>
+
+namespace
+{
+	using byteSpan = MoxyLevelFile::byteSpan;
+
+	enum Field { ID, CREATOR_NAME, LEVEL_NAME, LEVEL_DIFFICULTY, TURNS_REMAINING, GRID_UNITS, GATE, KEY, PLAYER, PUSHER, SUCKER, UTIL, BLOCK, HAZARD, TELEPORT, fieldCount };
+	const char* const fieldNames[fieldCount] =
+	{
+		"Id", "CreatorName", "LevelName", "LevelDifficulty", "TurnsRemaining", "GridUnits",
+		"Gate", "Key", "Player", "Pusher", "Sucker", "Util", "Block", "Hazard", "Teleport"
+	};
+
+	Field fieldNamed(const byteSpan &name)
+	{
+		for (int field = 0; field < fieldCount; field++)
+		{
+			if (name.is(fieldNames[field]))
+				return Field(field);
+		}
+		return fieldCount;
+	}
+
+	// Like QString::toInt, which files have always been read with: spaces either side are fine, anything else that isn't a digit makes it 0.
+	int toInt(byteSpan text)
+	{
+		while (text.begin < text.end && (*text.begin == ' ' || *text.begin == '\t'))
+			text.begin++;
+		while (text.end > text.begin && (text.end[-1] == ' ' || text.end[-1] == '\t'))
+			text.end--;
+
+		bool negative = false;
+		if (text.begin < text.end && (*text.begin == '-' || *text.begin == '+'))
+		{
+			negative = *text.begin == '-';
+			text.begin++;
+		}
+		if (text.begin == text.end || text.end - text.begin > 10)
+			return 0;
+
+		int64_t value = 0;
+		for (const char *c = text.begin; c < text.end; c++)
+		{
+			if (*c < '0' || *c > '9')
+				return 0;
+			value = (value * 10) + (*c - '0');
+		}
+		if (negative)
+			value = -value;
+		return (value < INT32_MIN || value > INT32_MAX) ? 0 : int(value);
+	}
+
+	MoxySim::Facing facingNamed(const byteSpan &text)
+	{
+		if (text.is("UP"))
+			return MoxySim::Facing::UP;
+		else if (text.is("DOWN"))
+			return MoxySim::Facing::DOWN;
+		else if (text.is("LEFT"))
+			return MoxySim::Facing::LEFT;
+		else if (text.is("RIGHT"))
+			return MoxySim::Facing::RIGHT;
+		else
+			return MoxySim::Facing::ERROR;
+	}
+
+	MoxySim::PatrolDir patrolDirNamed(const byteSpan &text)
+	{
+		if (text.is("VERTICAL"))
+			return MoxySim::PatrolDir::VERTICAL;
+		else if (text.is("HORIZONTAL"))
+			return MoxySim::PatrolDir::HORIZONTAL;
+		else
+			return MoxySim::PatrolDir::ERROR;
+	}
+
+	MoxySim::PatrollerType patrollerTypeNamed(const byteSpan &text)
+	{
+		if (text.is("PUSHER"))
+			return MoxySim::PatrollerType::PUSHER;
+		else if (text.is("SUCKER"))
+			return MoxySim::PatrollerType::SUCKER;
+		else
+			return MoxySim::PatrollerType::ERROR;
+	}
+
+	MoxySim::UtilType utilTypeNamed(const byteSpan &text)
+	{
+		if (text.is("PUSHER"))
+			return MoxySim::UtilType::PUSHER;
+		else if (text.is("SUCKER"))
+			return MoxySim::UtilType::SUCKER;
+		else
+			return MoxySim::UtilType::ERROR;
+	}
+
+	MoxySim::UtilState utilStateNamed(const byteSpan &text)
+	{
+		if (text.is("INACTIVE"))
+			return MoxySim::UtilState::INACTIVE;
+		else if (text.is("ACTIVE"))
+			return MoxySim::UtilState::ACTIVE;
+		else if (text.is("HELD"))
+			return MoxySim::UtilState::HELD;
+		else
+			return MoxySim::UtilState::ERROR;
+	}
+
+	// Patrollers have the most parts to an entry.
+	const int partsMax = 9;
+
+	// Splits text on commas, leaving out empty parts, and returns how many there were (which can be more than partsMax, though only that many are kept).
+	int splitParts(const byteSpan &text, byteSpan (&parts)[partsMax])
+	{
+		int count = 0;
+		const char *partBegin = text.begin;
+		for (const char *c = text.begin; c <= text.end; c++)
+		{
+			if (c == text.end || *c == ',')
+			{
+				if (c > partBegin)
+				{
+					if (count < partsMax)
+						parts[count] = byteSpan{ partBegin, c };
+					count++;
+				}
+				partBegin = c + 1;
+			}
+		}
+		return count;
+	}
+
+	// Calls entry(parts) for each bracketed entry in a list value that has at least partsNeeded parts.
+	// An entry with fewer makes the level invalid.
+	template<typename Entry>
+	void forEachEntry(const byteSpan &value, const int partsNeeded, bool &valid, Entry entry)
+	{
+		const char *c = value.begin;
+		while (c < value.end)
+		{
+			if (*c != '(')
+			{
+				c++;
+				continue;
+			}
+
+			byteSpan inside{ c + 1, c + 1 };
+			while (inside.end < value.end && *inside.end != ')')
+				inside.end++;
+			c = inside.end + 1;
+
+			byteSpan parts[partsMax];
+			if (splitParts(inside, parts) < partsNeeded)
+			{
+				valid = false;
+				continue;
+			}
+			entry(parts);
+		}
+	}
+
+	MoxySim::simPoint pointFrom(const byteSpan (&parts)[partsMax])
+	{
+		return MoxySim::simPoint{ toInt(parts[0]), toInt(parts[1]) };
+	}
+
+	void readImmobiles(const byteSpan &value, const MoxySim::ImmobileType type, std::vector<MoxySim::simImmobileDef> &list, bool &valid)
+	{
+		forEachEntry(value, 2, valid, [&](const byteSpan (&parts)[partsMax]) {
+			list.emplace_back(MoxySim::simImmobileDef{ pointFrom(parts), type });
+		});
+	}
+
+	void readPatrollers(const byteSpan &value, std::vector<MoxySim::simPatrollerDef> &list, bool &valid)
+	{
+		forEachEntry(value, 9, valid, [&](const byteSpan (&parts)[partsMax]) {
+			MoxySim::simPatrollerDef def;
+			def.initial = pointFrom(parts);
+			def.type = patrollerTypeNamed(parts[2]);
+			def.facingInitial = facingNamed(parts[3]);
+			def.patrolDir = patrolDirNamed(parts[4]);
+			def.patrolBoundUp = toInt(parts[5]);
+			def.patrolBoundDown = toInt(parts[6]);
+			def.patrolBoundLeft = toInt(parts[7]);
+			def.patrolBoundRight = toInt(parts[8]);
+			list.emplace_back(def);
+		});
+	}
+
+	void readUtils(const byteSpan &value, std::vector<MoxySim::simUtilDef> &list, bool &valid)
+	{
+		forEachEntry(value, 4, valid, [&](const byteSpan (&parts)[partsMax]) {
+			list.emplace_back(MoxySim::simUtilDef{ pointFrom(parts), utilTypeNamed(parts[2]), utilStateNamed(parts[3]) });
+		});
+	}
+
+	bool isSeparator(const char *c, const char *end)
+	{
+		return c[0] == ':' && (c + 1) < end && c[1] == ':';
+	}
+}
+
+bool MoxyLevelFile::byteSpan::is(const char *text) const
+{
+	const size_t length = std::strlen(text);
+	return size_t(end - begin) == length && std::memcmp(begin, text, length) == 0;
+}
+
+void MoxyLevelFile::fileLevel::clear()
+{
+	id = byteSpan();
+	creator = byteSpan();
+	name = byteSpan();
+	difficulty = 0;
+	turnsInitial = 0;
+	inCells = false;
+	valid = true;
+	players.clear();
+	pushers.clear();
+	suckers.clear();
+	blocks.clear();
+	keys.clear();
+	gates.clear();
+	hazards.clear();
+	teleports.clear();
+	utils.clear();
+}
+
+bool MoxyLevelFile::parse(const char *begin, const char *end, fileLevel &level)
+{
+	level.clear();
+
+	const char *c = begin;
+	while (c < end)
+	{
+		// Find every field on the line. Only the first of each name counts.
+		byteSpan fields[fieldCount];
+		uint32_t found = 0;
+		while (c < end && *c != '\n')
+		{
+			if (!isSeparator(c, end))
+			{
+				c++;
+				continue;
+			}
+			// ::: is a separator with a stray colon in front.
+			while ((c + 2) < end && c[2] == ':')
+				c++;
+
+			byteSpan name{ c + 2, c + 2 };
+			while (name.end < end && *name.end != '=' && *name.end != '\n' && !isSeparator(name.end, end))
+				name.end++;
+			c = name.end;
+			if (c == end || *c != '=')
+				continue;
+
+			byteSpan value{ c + 1, c + 1 };
+			while (value.end < end && *value.end != '\n' && !isSeparator(value.end, end))
+				value.end++;
+			c = value.end;
+			const bool lineEnded = c == end || *c == '\n';
+			if (lineEnded && value.end > value.begin && value.end[-1] == '\r')
+				value.end--;
+
+			const Field field = fieldNamed(name);
+			if (field == GRID_UNITS && !lineEnded && value.is("Cell"))
+				level.inCells = true;
+			if (field != fieldCount && !(found & (1u << field)))
+			{
+				fields[field] = value;
+				found |= 1u << field;
+			}
+		}
+		c++;
+
+		const auto has = [&](const Field field) { return (found & (1u << field)) != 0; };
+
+		if (has(ID))
+		{
+			level.id = fields[ID];
+			level.creator = fields[CREATOR_NAME];
+			level.name = fields[LEVEL_NAME];
+			level.difficulty = toInt(fields[LEVEL_DIFFICULTY]);
+			level.turnsInitial = toInt(fields[TURNS_REMAINING]);
+		}
+		else if (has(GATE) && has(KEY))
+		{
+			// Every gate needs a key.
+			const size_t gatesBefore = level.gates.size();
+			const size_t keysBefore = level.keys.size();
+			readImmobiles(fields[GATE], MoxySim::ImmobileType::GATE, level.gates, level.valid);
+			readImmobiles(fields[KEY], MoxySim::ImmobileType::KEY, level.keys, level.valid);
+			if (level.gates.size() - gatesBefore != level.keys.size() - keysBefore)
+				level.valid = false;
+		}
+		else if (has(PLAYER))
+		{
+			// The one entry that isn't in brackets.
+			byteSpan parts[partsMax];
+			if (splitParts(fields[PLAYER], parts) < 2)
+				level.valid = false;
+			else
+				level.players.emplace_back(pointFrom(parts));
+		}
+		else if (has(PUSHER))
+			readPatrollers(fields[PUSHER], level.pushers, level.valid);
+		else if (has(SUCKER))
+			readPatrollers(fields[SUCKER], level.suckers, level.valid);
+		else if (has(UTIL))
+			readUtils(fields[UTIL], level.utils, level.valid);
+		else if (has(BLOCK))
+			readImmobiles(fields[BLOCK], MoxySim::ImmobileType::BLOCK, level.blocks, level.valid);
+		else if (has(HAZARD))
+			readImmobiles(fields[HAZARD], MoxySim::ImmobileType::HAZARD, level.hazards, level.valid);
+		else if (has(TELEPORT))
+			readImmobiles(fields[TELEPORT], MoxySim::ImmobileType::TELEPORT, level.teleports, level.valid);
+	}
+	return level.valid;
+}
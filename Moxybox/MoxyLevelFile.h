@@ -0,0 +1,75 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MoxySim.h"
+#include <vector>
+
+// MoxyLevelFile reads level files (.MoxyLvl). A level file is lines of fields, each written ::Name=value and ended by the next ::
+// (or the end of the line), like ::Block=(3,4)(5,4)::. List values are entries in brackets, each entry's parts split by commas.
+//
+// It walks the bytes once: a field's name and value are found in the same pass that finds the line's end, and each value
+// is read as it goes into the level, integers included, with nothing copied out along the way. Text fields are left where they are,
+// as spans of the bytes, so the bytes can be a mapped file (QFile::map) and parsing a level allocates nothing but its lists' first growth.
+// Which fields a line has decides how it's read, the way it always has: a line with ::Id= is the level's details,
+// one with both ::Gate= and ::Key= is gates and keys, and otherwise the first of Player, Pusher, Sucker, Util, Block, Hazard
+// and Teleport it has. Fields that aren't any of those are skipped.
+class MoxyLevelFile
+{
+public:
+
+	// Some of the bytes given to parse, [begin, end). Nothing is copied out of them, so a span is only good as long as they are.
+	struct byteSpan
+	{
+		const char *begin = nullptr;
+		const char *end = nullptr;
+
+		int size() const { return int(end - begin); }
+		bool is(const char *text) const;
+	};
+
+	// A level as its file has it. Positions are as written: grid squares if inCells, otherwise scene pixels (older files),
+	// for whoever's loading it to convert. The text fields are UTF-8, straight from the file.
+	struct fileLevel
+	{
+		byteSpan id;
+		byteSpan creator;
+		byteSpan name;
+		int difficulty = 0;
+		int turnsInitial = 0;
+		bool inCells = false; // The file has ::GridUnits=Cell:: on any line.
+
+		// False when a level can't be played as written: a different number of gates and keys, or an entry missing parts.
+		// Levels like that are left out of the level list.
+		bool valid = true;
+
+		std::vector<MoxySim::simPoint> players;
+		std::vector<MoxySim::simPatrollerDef> pushers;
+		std::vector<MoxySim::simPatrollerDef> suckers;
+		std::vector<MoxySim::simImmobileDef> blocks;
+		std::vector<MoxySim::simImmobileDef> keys;
+		std::vector<MoxySim::simImmobileDef> gates;
+		std::vector<MoxySim::simImmobileDef> hazards;
+		std::vector<MoxySim::simImmobileDef> teleports;
+		std::vector<MoxySim::simUtilDef> utils;
+
+		// Empties it, keeping the lists' memory, so one fileLevel can be parsed into over and over without allocating.
+		void clear();
+	};
+
+	// Reads the file's bytes in [begin, end) into level, replacing what it had. Returns level.valid.
+	// level's text fields point into the bytes, so use them before the bytes go.
+	static bool parse(const char *begin, const char *end, fileLevel &level);
+};
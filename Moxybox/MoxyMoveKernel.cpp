@@ -0,0 +1,363 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyMoveKernel.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MOXY_MOVE_KERNEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MOXY_TARGET_AVX2
+#else
+// GCC and Clang only let a function use AVX2 if it says so. MSVC lets any function, and it's on us not to call them without it.
+#define MOXY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Outcomes are built up a bit at a time from which layer settled each square (see evaluateScalar), so the values have to be these.
+static_assert(int(MoxyMoveKernel::Outcome::WALK) == 0 && int(MoxyMoveKernel::Outcome::OFF_GRID) == 1 && int(MoxyMoveKernel::Outcome::BLOCK) == 2 &&
+	int(MoxyMoveKernel::Outcome::HAZARD) == 3 && int(MoxyMoveKernel::Outcome::TELEPORT) == 4 && int(MoxyMoveKernel::Outcome::SUCKER) == 5 &&
+	int(MoxyMoveKernel::Outcome::PUSHER) == 6 && int(MoxyMoveKernel::Outcome::TRAP) == 7 && int(MoxyMoveKernel::Outcome::GATE_SHUT) == 8 &&
+	int(MoxyMoveKernel::Outcome::GATE_OPENS) == 9 && int(MoxyMoveKernel::Outcome::KEY) == 10 &&
+	int(MoxyMoveKernel::Outcome::PLACE) + 1 == int(MoxyMoveKernel::Outcome::NOTHING_TO_PLACE), "Outcome values are worked out bit by bit");
+
+namespace
+{
+	enum Holding : int64_t { HAS_KEY = 1, HOLDS_PUSHER = 2, HOLDS_SUCKER = 4 };
+
+	// Each board has a zero word in front, and the load for a square starts windowStart squares before it.
+	const int windowOffset = 64 - 23;
+
+	// For every square, the bits of its neighbours that are on the grid. Moving anywhere else is OFF_GRID.
+	struct neighbourTable
+	{
+		uint64_t onGrid[MoxySim::gridCellCount];
+
+		neighbourTable()
+		{
+			for (int cell = 0; cell < MoxySim::gridCellCount; cell++)
+			{
+				const int x = cell % MoxySim::gridRowSize;
+				const int y = cell / MoxySim::gridRowSize;
+				uint64_t bits = 0;
+				if (y > 0)
+					bits |= uint64_t(1) << (23 - MoxySim::gridRowSize);
+				if (x > 0)
+					bits |= uint64_t(1) << (23 - 1);
+				if (x < MoxySim::gridRowSize - 1)
+					bits |= uint64_t(1) << (23 + 1);
+				if (y < MoxySim::gridColSize - 1)
+					bits |= uint64_t(1) << (23 + MoxySim::gridRowSize);
+				onGrid[cell] = bits;
+			}
+		}
+	};
+	const neighbourTable neighbours;
+
+	uint64_t loadWindow(const uint64_t *board, const int64_t cell)
+	{
+		const int64_t bit = cell + windowOffset;
+		uint64_t window;
+		std::memcpy(&window, reinterpret_cast<const uint8_t*>(board) + (bit >> 3), sizeof(window));
+		return window >> (bit & 7);
+	}
+}
+
+MoxyMoveKernel::stateBatch::stateBatch(const MoxySim &sim)
+{
+	const MoxySim::simOccupancy& occupancy = sim.getOccupancy();
+	std::memcpy(hazards + 1, occupancy.hazards.bits.words, sizeof(occupancy.hazards.bits.words));
+	std::memcpy(teleports + 1, occupancy.teleports.bits.words, sizeof(occupancy.teleports.bits.words));
+}
+
+void MoxyMoveKernel::stateBatch::add(const MoxySim &sim)
+{
+	const MoxySim::simOccupancy& occupancy = sim.getOccupancy();
+	const MoxySim::simLayer* layers[layerCount] = { &occupancy.blocks, &occupancy.gates, &occupancy.keys, &occupancy.pushers, &occupancy.suckers, &occupancy.utils };
+
+	const size_t start = boards.size();
+	boards.resize(start + stateWords, 0);
+	for (int layer = 0; layer < layerCount; layer++)
+		std::memcpy(&boards[start + (layer * boardWords) + 1], layers[layer]->bits.words, sizeof(layers[layer]->bits.words));
+
+	const MoxySim::simPlayer& player = sim.getState().player;
+	cells.push_back(MoxySim::cellIndex(player.pos));
+	holding.push_back((player.heldKeys > 0 ? int64_t(HAS_KEY) : 0) | (player.heldUtilPushIndex.empty() ? 0 : int64_t(HOLDS_PUSHER)) | (player.heldUtilSuckIndex.empty() ? 0 : int64_t(HOLDS_SUCKER)));
+}
+
+void MoxyMoveKernel::stateBatch::clear()
+{
+	boards.clear();
+	cells.clear();
+	holding.clear();
+}
+
+MoxyMoveKernel::Isa MoxyMoveKernel::bestIsa()
+{
+	static const Isa best = []() {
+#if defined(MOXY_MOVE_KERNEL_X86) && defined(_MSC_VER)
+		// AVX2 needs the CPU to have it and the OS to save the wider registers (OSXSAVE, then XCR0 saying it keeps SSE and AVX state).
+		int info[4];
+		__cpuid(info, 0);
+		const int leafMax = info[0];
+		__cpuid(info, 1);
+		const bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if (leafMax >= 7 && osSavesAvx)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+		return avx2 ? Isa::AVX2 : Isa::SSE2;
+#elif defined(MOXY_MOVE_KERNEL_X86)
+		// Checks the OS side too.
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? Isa::AVX2 : Isa::SSE2;
+#else
+		return Isa::SCALAR;
+#endif
+	}();
+	return best;
+}
+
+const char* MoxyMoveKernel::isaName(const Isa isa)
+{
+	switch (isa)
+	{
+	case Isa::AVX2: return "AVX2";
+	case Isa::SSE2: return "SSE2";
+	default: return "scalar";
+	}
+}
+
+void MoxyMoveKernel::evaluate(const stateBatch &batch, Outcome *outcomes, const Isa isa)
+{
+	const int count = batch.size();
+	int done = 0;
+#ifdef MOXY_MOVE_KERNEL_X86
+	if (isa == Isa::AVX2 && bestIsa() == Isa::AVX2)
+	{
+		done = count - (count % 4);
+		evaluateAvx2(batch, 0, done, outcomes);
+	}
+	else if (isa != Isa::SCALAR)
+	{
+		done = count - (count % 2);
+		evaluateSse2(batch, 0, done, outcomes);
+	}
+#endif
+	evaluateScalar(batch, done, count, outcomes);
+}
+
+void MoxyMoveKernel::evaluateScalar(const stateBatch &batch, const int begin, const int end, Outcome *outcomes)
+{
+	for (int i = begin; i < end; i++)
+	{
+		const int64_t cell = batch.cells[i];
+		const uint64_t* boards = &batch.boards[size_t(i) * stateBatch::stateWords];
+		const auto window = [&](const int layer) { return loadWindow(boards + (layer * stateBatch::boardWords), cell); };
+
+		// Every mask below has a bit on each of the four neighbouring squares that comes down to that layer.
+		// Each layer takes the squares it's on that no layer before it took, in hitSolidObjectPlayerMoving's order.
+		uint64_t open = neighbours.onGrid[cell];
+		const uint64_t offGrid = ((uint64_t(1) << bitUp) | (uint64_t(1) << bitLeft) | (uint64_t(1) << bitRight) | (uint64_t(1) << bitDown)) & ~open;
+		const auto take = [&](const uint64_t layer) {
+			const uint64_t taken = layer & open;
+			open &= ~taken;
+			return taken;
+		};
+		const uint64_t block = take(window(stateBatch::BLOCKS));
+		const uint64_t hazard = take(loadWindow(batch.hazards, cell));
+		const uint64_t teleport = take(loadWindow(batch.teleports, cell));
+		const uint64_t sucker = take(window(stateBatch::SUCKERS));
+		const uint64_t pusher = take(window(stateBatch::PUSHERS));
+		const uint64_t trap = take(window(stateBatch::UTILS));
+		const uint64_t gate = take(window(stateBatch::GATES));
+		const uint64_t key = take(window(stateBatch::KEYS));
+		const uint64_t hasKey = (batch.holding[i] & HAS_KEY) ? ~uint64_t(0) : 0;
+
+		// Each bit of the outcome, from the outcomes that have it set.
+		const uint64_t outcomeBits[4] =
+		{
+			offGrid | hazard | sucker | trap | (gate & hasKey),
+			block | hazard | pusher | trap | key,
+			teleport | sucker | pusher | trap,
+			gate | key
+		};
+		const auto outcomeAt = [&](const int bit) {
+			return Outcome(((outcomeBits[0] >> bit) & 1) | (((outcomeBits[1] >> bit) & 1) << 1) | (((outcomeBits[2] >> bit) & 1) << 2) | (((outcomeBits[3] >> bit) & 1) << 3));
+		};
+
+		Outcome* row = outcomes + (size_t(i) * rowSize);
+		row[0] = outcomeAt(bitLeft);
+		row[1] = outcomeAt(bitRight);
+		row[2] = outcomeAt(bitUp);
+		row[3] = outcomeAt(bitDown);
+		row[4] = (batch.holding[i] & HOLDS_PUSHER) ? Outcome::PLACE : Outcome::NOTHING_TO_PLACE;
+		row[5] = (batch.holding[i] & HOLDS_SUCKER) ? Outcome::PLACE : Outcome::NOTHING_TO_PLACE;
+		row[6] = Outcome::WALK;
+		row[7] = Outcome::WALK;
+	}
+}
+
+#ifdef MOXY_MOVE_KERNEL_X86
+
+// The same steps as evaluateScalar, two states at a time. SSE2 has no gathers or shifts that differ by lane,
+// so the windows are loaded one state at a time and only the settling is done side by side.
+void MoxyMoveKernel::evaluateSse2(const stateBatch &batch, const int begin, const int end, Outcome *outcomes)
+{
+	const __m128i directions = _mm_set1_epi64x(int64_t((uint64_t(1) << bitUp) | (uint64_t(1) << bitLeft) | (uint64_t(1) << bitRight) | (uint64_t(1) << bitDown)));
+	const __m128i one = _mm_set1_epi64x(1);
+	for (int i = begin; i < end; i += 2)
+	{
+		const int64_t cell0 = batch.cells[i];
+		const int64_t cell1 = batch.cells[i + 1];
+		const uint64_t* boards0 = &batch.boards[size_t(i) * stateBatch::stateWords];
+		const uint64_t* boards1 = boards0 + stateBatch::stateWords;
+		const auto window = [&](const int layer) {
+			return _mm_set_epi64x(int64_t(loadWindow(boards1 + (layer * stateBatch::boardWords), cell1)), int64_t(loadWindow(boards0 + (layer * stateBatch::boardWords), cell0)));
+		};
+		const auto windowLevel = [&](const uint64_t *board) {
+			return _mm_set_epi64x(int64_t(loadWindow(board, cell1)), int64_t(loadWindow(board, cell0)));
+		};
+
+		__m128i open = _mm_set_epi64x(int64_t(neighbours.onGrid[cell1]), int64_t(neighbours.onGrid[cell0]));
+		const __m128i offGrid = _mm_andnot_si128(open, directions);
+		const auto take = [&](const __m128i layer) {
+			const __m128i taken = _mm_and_si128(layer, open);
+			open = _mm_andnot_si128(taken, open);
+			return taken;
+		};
+		const __m128i block = take(window(stateBatch::BLOCKS));
+		const __m128i hazard = take(windowLevel(batch.hazards));
+		const __m128i teleport = take(windowLevel(batch.teleports));
+		const __m128i sucker = take(window(stateBatch::SUCKERS));
+		const __m128i pusher = take(window(stateBatch::PUSHERS));
+		const __m128i trap = take(window(stateBatch::UTILS));
+		const __m128i gate = take(window(stateBatch::GATES));
+		const __m128i key = take(window(stateBatch::KEYS));
+
+		// All ones in a lane whose player has a key. SSE2 has no 64-bit compare, but 0 - 1 is all ones.
+		const __m128i holding = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&batch.holding[i]));
+		const __m128i hasKey = _mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(holding, one));
+
+		const __m128i bits0 = _mm_or_si128(_mm_or_si128(_mm_or_si128(offGrid, hazard), _mm_or_si128(sucker, trap)), _mm_and_si128(gate, hasKey));
+		const __m128i bits1 = _mm_or_si128(_mm_or_si128(_mm_or_si128(block, hazard), _mm_or_si128(pusher, trap)), key);
+		const __m128i bits2 = _mm_or_si128(_mm_or_si128(teleport, sucker), _mm_or_si128(pusher, trap));
+		const __m128i bits3 = _mm_or_si128(gate, key);
+#define MOXY_OUTCOME_AT(bit) _mm_or_si128( \
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi64(bits0, (bit)), one), _mm_and_si128(_mm_srli_epi64(bits1, (bit) - 1), _mm_set1_epi64x(2))), \
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi64(bits2, (bit) - 2), _mm_set1_epi64x(4)), _mm_and_si128(_mm_srli_epi64(bits3, (bit) - 3), _mm_set1_epi64x(8))))
+		const __m128i moves = _mm_or_si128(
+			_mm_or_si128(MOXY_OUTCOME_AT(bitLeft), _mm_slli_epi64(MOXY_OUTCOME_AT(bitRight), 8)),
+			_mm_or_si128(_mm_slli_epi64(MOXY_OUTCOME_AT(bitUp), 16), _mm_slli_epi64(MOXY_OUTCOME_AT(bitDown), 24)));
+#undef MOXY_OUTCOME_AT
+
+		// Holding one is PLACE, otherwise the one after it.
+		const __m128i nothing = _mm_set1_epi64x(int64_t(Outcome::NOTHING_TO_PLACE));
+		const __m128i placePusher = _mm_sub_epi64(nothing, _mm_and_si128(_mm_srli_epi64(holding, 1), one));
+		const __m128i placeSucker = _mm_sub_epi64(nothing, _mm_and_si128(_mm_srli_epi64(holding, 2), one));
+		const __m128i rows = _mm_or_si128(moves, _mm_or_si128(_mm_slli_epi64(placePusher, 32), _mm_slli_epi64(placeSucker, 40)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outcomes + (size_t(i) * rowSize)), rows);
+	}
+}
+
+namespace
+{
+	// Four windows at once, each from its own byte offset and shifted by its own amount.
+	MOXY_TARGET_AVX2 inline __m256i gatherWindowAvx2(const long long *base, const __m256i byteOffsets, const int64_t layerBytes, const __m256i shifts)
+	{
+		return _mm256_srlv_epi64(_mm256_i64gather_epi64(base, _mm256_add_epi64(byteOffsets, _mm256_set1_epi64x(layerBytes)), 1), shifts);
+	}
+
+	MOXY_TARGET_AVX2 inline __m256i takeAvx2(const __m256i layer, __m256i &open)
+	{
+		const __m256i taken = _mm256_and_si256(layer, open);
+		open = _mm256_andnot_si256(taken, open);
+		return taken;
+	}
+}
+
+// The same steps as evaluateScalar, four states at a time, with every window gathered and shifted by lane.
+MOXY_TARGET_AVX2 void MoxyMoveKernel::evaluateAvx2(const stateBatch &batch, const int begin, const int end, Outcome *outcomes)
+{
+	const __m256i directions = _mm256_set1_epi64x(int64_t((uint64_t(1) << bitUp) | (uint64_t(1) << bitLeft) | (uint64_t(1) << bitRight) | (uint64_t(1) << bitDown)));
+	const __m256i one = _mm256_set1_epi64x(1);
+	const __m256i seven = _mm256_set1_epi64x(7);
+	const int64_t stateBytes = stateBatch::stateWords * sizeof(uint64_t);
+	const int64_t boardBytes = stateBatch::boardWords * sizeof(uint64_t);
+	const long long* boardsBase = reinterpret_cast<const long long*>(batch.boards.data());
+	const long long* onGrid = reinterpret_cast<const long long*>(neighbours.onGrid);
+	for (int i = begin; i < end; i += 4)
+	{
+		const __m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.cells[i]));
+		const __m256i bits = _mm256_add_epi64(cells, _mm256_set1_epi64x(windowOffset));
+		const __m256i bytes = _mm256_srli_epi64(bits, 3);
+		const __m256i shifts = _mm256_and_si256(bits, seven);
+		const __m256i stateBytesAt = _mm256_set_epi64x((i + 3) * stateBytes, (i + 2) * stateBytes, (i + 1) * stateBytes, i * stateBytes);
+		const __m256i stateBytesAtWindow = _mm256_add_epi64(stateBytesAt, bytes);
+
+		const long long* hazards = reinterpret_cast<const long long*>(batch.hazards);
+		const long long* teleports = reinterpret_cast<const long long*>(batch.teleports);
+
+		// Lambdas don't pick up the AVX2 target from the function around them, so these are plain functions.
+		__m256i open = _mm256_i64gather_epi64(onGrid, cells, 8);
+		const __m256i offGrid = _mm256_andnot_si256(open, directions);
+		const __m256i block = takeAvx2(gatherWindowAvx2(boardsBase, stateBytesAtWindow, stateBatch::BLOCKS * boardBytes, shifts), open);
+		const __m256i hazard = takeAvx2(gatherWindowAvx2(hazards, bytes, 0, shifts), open);
+		const __m256i teleport = takeAvx2(gatherWindowAvx2(teleports, bytes, 0, shifts), open);
+		const __m256i sucker = takeAvx2(gatherWindowAvx2(boardsBase, stateBytesAtWindow, stateBatch::SUCKERS * boardBytes, shifts), open);
+		const __m256i pusher = takeAvx2(gatherWindowAvx2(boardsBase, stateBytesAtWindow, stateBatch::PUSHERS * boardBytes, shifts), open);
+		const __m256i trap = takeAvx2(gatherWindowAvx2(boardsBase, stateBytesAtWindow, stateBatch::UTILS * boardBytes, shifts), open);
+		const __m256i gate = takeAvx2(gatherWindowAvx2(boardsBase, stateBytesAtWindow, stateBatch::GATES * boardBytes, shifts), open);
+		const __m256i key = takeAvx2(gatherWindowAvx2(boardsBase, stateBytesAtWindow, stateBatch::KEYS * boardBytes, shifts), open);
+
+		const __m256i holding = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&batch.holding[i]));
+		const __m256i hasKey = _mm256_cmpeq_epi64(_mm256_and_si256(holding, one), one);
+
+		const __m256i bits0 = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(offGrid, hazard), _mm256_or_si256(sucker, trap)), _mm256_and_si256(gate, hasKey));
+		const __m256i bits1 = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(block, hazard), _mm256_or_si256(pusher, trap)), key);
+		const __m256i bits2 = _mm256_or_si256(_mm256_or_si256(teleport, sucker), _mm256_or_si256(pusher, trap));
+		const __m256i bits3 = _mm256_or_si256(gate, key);
+#define MOXY_OUTCOME_AT(bit) _mm256_or_si256( \
+			_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(bits0, (bit)), one), _mm256_and_si256(_mm256_srli_epi64(bits1, (bit) - 1), _mm256_set1_epi64x(2))), \
+			_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(bits2, (bit) - 2), _mm256_set1_epi64x(4)), _mm256_and_si256(_mm256_srli_epi64(bits3, (bit) - 3), _mm256_set1_epi64x(8))))
+		const __m256i moves = _mm256_or_si256(
+			_mm256_or_si256(MOXY_OUTCOME_AT(bitLeft), _mm256_slli_epi64(MOXY_OUTCOME_AT(bitRight), 8)),
+			_mm256_or_si256(_mm256_slli_epi64(MOXY_OUTCOME_AT(bitUp), 16), _mm256_slli_epi64(MOXY_OUTCOME_AT(bitDown), 24)));
+#undef MOXY_OUTCOME_AT
+
+		const __m256i nothing = _mm256_set1_epi64x(int64_t(Outcome::NOTHING_TO_PLACE));
+		const __m256i placePusher = _mm256_sub_epi64(nothing, _mm256_and_si256(_mm256_srli_epi64(holding, 1), one));
+		const __m256i placeSucker = _mm256_sub_epi64(nothing, _mm256_and_si256(_mm256_srli_epi64(holding, 2), one));
+		const __m256i rows = _mm256_or_si256(moves, _mm256_or_si256(_mm256_slli_epi64(placePusher, 32), _mm256_slli_epi64(placeSucker, 40)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(outcomes + (size_t(i) * rowSize)), rows);
+	}
+}
+
+#else
+
+void MoxyMoveKernel::evaluateSse2(const stateBatch &batch, const int begin, const int end, Outcome *outcomes)
+{
+	evaluateScalar(batch, begin, end, outcomes);
+}
+
+void MoxyMoveKernel::evaluateAvx2(const stateBatch &batch, const int begin, const int end, Outcome *outcomes)
+{
+	evaluateScalar(batch, begin, end, outcomes);
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MoxySim.h"
+#include <vector>
+#include <cstdint>
+
+// MoxyMoveKernel works out what each of the player's six actions would run into, for a whole batch of states at once,
+// without playing any of them. It's the first thing a turn decides (MoxySim::hitSolidObjectPlayerMoving for moves,
+// whether there's a trap to place for placing), and whether the player gets to go anywhere at all,
+// so searches and playouts can skip or order actions before paying for a full turn.
+// What happens after that (patrollers moving, knockback landing somewhere, suction) is still MoxySim's to work out.
+//
+// Each state's occupancy layers are copied into the batch with some room either side, so one unaligned 64-bit load
+// from a layer holds the squares above, left of, right of and below the player. Every layer is loaded like that,
+// and then the squares are settled in hitSolidObjectPlayerMoving's order (grid edge, block, hazard, teleport, sucker,
+// pusher, trap, gate, key) all four at once with bit masks, with no branches at all.
+// AVX2 does that for four states at a time, loading the layers with gathers, and SSE2 for two. Which one runs is picked by what the CPU
+// has when the program starts, and a plain 64-bit version does the same work anywhere else, and for the states left over.
+class MoxyMoveKernel
+{
+public:
+
+	// What an action runs into. Only the ones marked blocked leave the player's turn unused (MoxySim::TurnResult::BLOCKED).
+	enum class Outcome : uint8_t
+	{
+		WALK, // Onto an empty square.
+		OFF_GRID, // Blocked.
+		BLOCK, // Blocked.
+		HAZARD, // Blocked. The player won't walk onto one, only get knocked or pulled onto one.
+		TELEPORT, // Walks on and is sent to the other teleport.
+		SUCKER, // Blocked.
+		PUSHER, // Knocked back, which uses the turn.
+		TRAP, // Picks it up and walks on.
+		GATE_SHUT, // Blocked, for want of a key.
+		GATE_OPENS, // Uses a key and walks on.
+		KEY, // Picks it up and walks on.
+		PLACE, // Places the first trap of that type held.
+		NOTHING_TO_PLACE // Blocked.
+	};
+	static bool isBlocked(const Outcome outcome)
+	{
+		return outcome == Outcome::OFF_GRID || outcome == Outcome::BLOCK || outcome == Outcome::HAZARD ||
+			outcome == Outcome::SUCKER || outcome == Outcome::GATE_SHUT || outcome == Outcome::NOTHING_TO_PLACE;
+	}
+
+	enum class Isa { SCALAR, SSE2, AVX2 };
+
+	// The best the CPU running this has, worked out once.
+	static Isa bestIsa();
+	static const char* isaName(const Isa isa);
+
+	// States from one level, copied in the layout the kernel reads.
+	class stateBatch
+	{
+	public:
+		// Takes the level's hazards and teleports, which are the same in every state, from sim.
+		explicit stateBatch(const MoxySim &sim);
+
+		// Copies in the state sim is in now.
+		void add(const MoxySim &sim);
+		void clear();
+		int size() const { return int(cells.size()); }
+
+	private:
+		friend class MoxyMoveKernel;
+
+		// Layers that can differ between states, in the order they're stored for each state.
+		enum Layer { BLOCKS, GATES, KEYS, PUSHERS, SUCKERS, UTILS, layerCount };
+
+		// A layer's words with a zero word either side, so a load reaching off either end of the grid reads zeroes.
+		static const int boardWords = MoxySim::simBitboard::wordCount + 2;
+		static const int stateWords = layerCount * boardWords;
+
+		std::vector<uint64_t> boards; // stateWords for each state.
+		std::vector<int64_t> cells; // The player's square.
+		std::vector<int64_t> holding; // Bits: has a key, holds a pusher trap, holds a sucker trap.
+		uint64_t hazards[boardWords] = {};
+		uint64_t teleports[boardWords] = {};
+	};
+
+	// Outcomes for state i are outcomes[(i * rowSize) + a] for each action a, in MoxySolver::actionsAll order.
+	// The last two of each row are left as padding, so a row can be written as one 64-bit word.
+	static const int rowSize = 8;
+	static void evaluate(const stateBatch &batch, Outcome *outcomes, const Isa isa);
+	static void evaluate(const stateBatch &batch, Outcome *outcomes) { evaluate(batch, outcomes, bestIsa()); }
+
+private:
+
+	// Where each neighbouring square lands in the 64 bits loaded for a player's square. The load starts 23 squares before the player's,
+	// so none of them are below bit 3 and each of the four bits of an outcome can be shifted down onto its own square's bits.
+	static const int windowStart = 23;
+	static const int bitUp = windowStart - MoxySim::gridRowSize;
+	static const int bitLeft = windowStart - 1;
+	static const int bitRight = windowStart + 1;
+	static const int bitDown = windowStart + MoxySim::gridRowSize;
+
+	static void evaluateScalar(const stateBatch &batch, const int begin, const int end, Outcome *outcomes);
+	static void evaluateSse2(const stateBatch &batch, const int begin, const int end, Outcome *outcomes);
+	static void evaluateAvx2(const stateBatch &batch, const int begin, const int end, Outcome *outcomes);
+};
@@ -0,0 +1,210 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyPlayout.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <functional>
+
+// Everything one thread needs for its games, set up before the first one.
+struct MoxyPlayout::worker
+{
+	MoxySim sim;
+	Policy policy;
+	const MoxySolver::distanceHeuristic &distances;
+	std::vector<uint8_t> start; // The level's start, packed.
+	std::vector<uint8_t> lookahead; // GREEDY: the state it's choosing from, packed while it tries each action.
+	int turnsMax;
+	uint64_t random;
+	playoutStats stats;
+
+	worker(const MoxySim::simLevel &level, const Policy newPolicy, const MoxySolver::distanceHeuristic &newDistances, const uint64_t seed)
+		: sim(level), policy(newPolicy), distances(newDistances)
+	{
+		sim.setHistoryEnabled(false);
+		start.resize(sim.getPackedSize());
+		lookahead.resize(sim.getPackedSize());
+		sim.packState(start.data());
+
+		// Anything taking four times the turns the level gives, after all the free ones, isn't getting anywhere.
+		turnsMax = (std::max(0, level.turnsInitial) * 4) + 64;
+		stats.endCells.assign(size_t(endingCount) * MoxySim::gridCellCount, 0);
+		stats.winTurns.assign(turnsMax + 1, 0);
+
+		// xorshift64* wants a seed that isn't 0, and seeds next to each other to start nowhere near each other, so it's mixed first.
+		random = MoxySim::splitMix(seed) | 1;
+	}
+
+	uint64_t next()
+	{
+		random ^= random >> 12;
+		random ^= random << 25;
+		random ^= random >> 27;
+		return random * 0x2545F4914F6CDD1Dull;
+	}
+
+	// Uniform in [0, 1), from the top 53 bits.
+	double chance() { return double(next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+int MoxyPlayout::playoutStats::medianWinTurns() const
+{
+	const long long wins = ends[int(Ending::WON)];
+	if (wins == 0)
+		return -1;
+
+	long long seen = 0;
+	const int numTurns = winTurns.size();
+	for (int turns = 0; turns < numTurns; turns++)
+	{
+		seen += winTurns[turns];
+		if (seen * 2 >= wins)
+			return turns;
+	}
+	return numTurns - 1;
+}
+
+MoxyPlayout::playoutStats MoxyPlayout::play(const MoxySim::simLevel &level, const long long games, const Policy policy, const int threadCount, const uint64_t seed,
+	const std::atomic<bool> *cancel)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	const int threads = std::max(1, threadCount);
+	const MoxySolver::distanceHeuristic distances(level);
+
+	std::vector<std::unique_ptr<worker>> workers;
+	for (int i = 0; i < threads; i++)
+		workers.emplace_back(new worker(level, policy, distances, seed ^ (uint64_t(i) * 0xD1B54A32D192ED03ull)));
+
+	const auto share = [&](const int i) { return (games / threads) + (i < games % threads ? 1 : 0); };
+	std::vector<std::thread> pool;
+	for (int i = 1; i < threads; i++)
+		pool.emplace_back(&MoxyPlayout::playShare, std::ref(*workers[i]), share(i), cancel);
+	playShare(*workers[0], share(0), cancel);
+	for (auto& thread : pool)
+		thread.join();
+
+	playoutStats stats = std::move(workers[0]->stats);
+	for (int i = 1; i < threads; i++)
+	{
+		const playoutStats& other = workers[i]->stats;
+		stats.games += other.games;
+		for (int e = 0; e < endingCount; e++)
+			stats.ends[e] += other.ends[e];
+		for (size_t c = 0; c < stats.endCells.size(); c++)
+			stats.endCells[c] += other.endCells[c];
+		for (size_t t = 0; t < stats.winTurns.size(); t++)
+			stats.winTurns[t] += other.winTurns[t];
+	}
+	stats.threads = threads;
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return stats;
+}
+
+void MoxyPlayout::playShare(worker &w, const long long games, const std::atomic<bool> *cancel)
+{
+	MoxySim& sim = w.sim;
+	for (long long game = 0; game < games; game++)
+	{
+		if (cancel != nullptr && cancel->load(std::memory_order_relaxed))
+			break;
+
+		sim.unpackState(w.start.data());
+		Ending ending = Ending::STUCK;
+		int turns = 0;
+		int blockedInARow = 0;
+		while (turns < w.turnsMax)
+		{
+			const MoxySim::Action action = w.policy == Policy::GREEDY && w.chance() >= greedyRandomChance ?
+				pickGreedy(w) : MoxySolver::actionsAll[w.next() % 6];
+			const MoxySim::TurnResult result = sim.playerTurn(action);
+			if (result == MoxySim::TurnResult::BLOCKED)
+			{
+				if (++blockedInARow > blockedInARowMax)
+					break;
+				continue;
+			}
+			blockedInARow = 0;
+			turns++;
+
+			if (result == MoxySim::TurnResult::COMPLETE)
+			{
+				ending = Ending::WON;
+				break;
+			}
+			if (result == MoxySim::TurnResult::FAILED)
+			{
+				// A hazard ends the level by taking every turn left, so the square the player's on is what tells the two apart.
+				ending = sim.getOccupancy().hazards.test(MoxySim::cellIndex(sim.getState().player.pos)) ? Ending::HAZARD : Ending::OUT_OF_TURNS;
+				break;
+			}
+		}
+
+		w.stats.games++;
+		w.stats.ends[int(ending)]++;
+		const int cell = MoxySim::cellIndex(sim.getState().player.pos);
+		if (cell >= 0)
+			w.stats.endCells[(size_t(ending) * MoxySim::gridCellCount) + cell]++;
+		if (ending == Ending::WON)
+			w.stats.winTurns[turns]++;
+	}
+}
+
+MoxySim::Action MoxyPlayout::pickGreedy(worker &w)
+{
+	// Tries every action and puts the state back after each. A win beats anything, a loss loses to anything,
+	// and otherwise the lowest estimate of turns still needed wins. Ties are picked between evenly.
+	MoxySim& sim = w.sim;
+	sim.packState(w.lookahead.data());
+
+	const int won = -1;
+	const int lost = MoxySolver::distanceHeuristic::unsolvable + 1;
+	MoxySim::Action best = MoxySolver::actionsAll[w.next() % 6];
+	int bestEstimate = lost + 1;
+	int ties = 0;
+	for (const MoxySim::Action action : MoxySolver::actionsAll)
+	{
+		const MoxySim::TurnResult result = sim.playerTurn(action);
+		int estimate;
+		switch (result)
+		{
+		case MoxySim::TurnResult::BLOCKED:
+			estimate = lost + 1; // Takes no turn, so it'd only be picked again next time.
+			break;
+		case MoxySim::TurnResult::COMPLETE:
+			estimate = won;
+			break;
+		case MoxySim::TurnResult::FAILED:
+			estimate = lost;
+			break;
+		default:
+			estimate = w.distances.estimate(sim.getState());
+			break;
+		}
+		sim.unpackState(w.lookahead.data());
+
+		if (estimate < bestEstimate)
+		{
+			best = action;
+			bestEstimate = estimate;
+			ties = 1;
+		}
+		else if (estimate == bestEstimate && estimate <= lost && w.next() % ++ties == 0)
+		{
+			best = action;
+		}
+	}
+	return best;
+}
@@ -0,0 +1,86 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MoxySim.h"
+#include "MoxySolver.h"
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+// MoxyPlayout plays a level over and over with made-up players, to see how forgiving it is without needing real ones:
+// how often a player pressing keys at random (or a greedy one, heading for the nearest gate most of the time) wins,
+// how many turns the wins take, and which squares the losses end on.
+// Games are played by the real turn rules (MoxySim) and spread over threads. Each thread sets up one MoxySim and everything
+// else it needs before its first game, then every game starts by unpacking the level's start into it, so playing doesn't allocate.
+class MoxyPlayout
+{
+public:
+
+	enum class Policy
+	{
+		RANDOM, // Any of the six actions, evenly.
+		GREEDY // Usually whichever action leaves the smallest MoxySolver::distanceHeuristic estimate, otherwise random.
+	};
+
+	enum class Ending
+	{
+		WON,
+		HAZARD, // Landed on a hazard.
+		OUT_OF_TURNS,
+		STUCK // Went on too long without ending, e.g. bumping into a pusher forever, which doesn't use up turns remaining.
+	};
+	static const int endingCount = 4;
+
+	struct playoutStats
+	{
+		long long games = 0;
+		long long ends[endingCount] = {};
+
+		// How many games ended each way on each grid square (where the player was at the end), by Ending then MoxySim::cellIndex.
+		std::vector<long long> endCells;
+
+		// How many wins took each number of turns, counted like MoxySolver's turnsUsed (a turn is one the patrollers moved on).
+		std::vector<long long> winTurns;
+
+		double seconds = 0;
+		int threads = 1;
+
+		double winRate() const { return games > 0 ? double(ends[int(Ending::WON)]) / games : 0; }
+		long long endsAt(const Ending ending, const int cell) const { return endCells[(size_t(ending) * MoxySim::gridCellCount) + cell]; }
+
+		// Turns the middle win took, or -1 with no wins.
+		int medianWinTurns() const;
+	};
+
+	// Plays games games of the level from its start with threadCount threads (the caller's thread is one of them).
+	// Thread i uses seed and i to seed its own generator and plays its own share of the games,
+	// so the same seed and thread count always give the same stats.
+	// With cancel set (from any thread), each thread stops after the game it's on, and the stats only count the games played.
+	static playoutStats play(const MoxySim::simLevel &level, const long long games, const Policy policy, const int threadCount, const uint64_t seed,
+		const std::atomic<bool> *cancel = nullptr);
+
+	// Chance a greedy player does something random instead, so it doesn't walk into the same wall every game.
+	static constexpr double greedyRandomChance = 0.2;
+
+private:
+
+	// Blocked actions are retried, up to this many in a row, before the game counts as STUCK.
+	static const int blockedInARowMax = 64;
+
+	struct worker;
+	static void playShare(worker &w, const long long games, const std::atomic<bool> *cancel);
+	static MoxySim::Action pickGreedy(worker &w);
+};
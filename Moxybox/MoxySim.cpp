@@ -0,0 +1,1419 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxySim.h"
+#include <type_traits>
+#include <cstring>
+
+MoxySim::MoxySim(const simLevel &newLevel)
+{
+	load(newLevel);
+}
+
+void MoxySim::load(const simLevel &newLevel)
+{
+	level = newLevel;
+	buildPatrolSchedules();
+
+	// Room for a busy turn up front (a few events for the player, a couple for each token), so playing doesn't have to grow the list.
+	events.reserve(8 + (2 * (level.pushers.size() + level.suckers.size() + level.utils.size())) + level.keys.size() + level.gates.size() + level.blocks.size());
+	reset();
+}
+
+void MoxySim::reset()
+{
+	// Puts every token back where the level data says it starts.
+	// This is the engine side of what used to be done item by item in GameplayScreen::levelSetToDefaults.
+	state = simState();
+	state.turnsRemaining = level.turnsInitial;
+	state.player.pos = level.player;
+
+	for (const auto& def : level.pushers)
+		state.pushers.emplace_back(simPatroller{ def.initial, def.facingInitial });
+	for (const auto& def : level.suckers)
+		state.suckers.emplace_back(simPatroller{ def.initial, def.facingInitial });
+
+	state.blocks.assign(level.blocks.size(), ImmobileState::ACTIVE);
+	state.keys.assign(level.keys.size(), ImmobileState::ACTIVE);
+	state.gates.assign(level.gates.size(), ImmobileState::ACTIVE);
+	state.hazards.assign(level.hazards.size(), ImmobileState::ACTIVE);
+	state.teleports.assign(level.teleports.size(), ImmobileState::ACTIVE);
+
+	for (const auto& def : level.utils)
+		state.utils.emplace_back(simUtil{ def.initial, def.stateBase });
+
+	// Room for the player to hold every trap in the level, so picking one up never has to grow the lists.
+	state.player.heldUtilPushIndex.reserve(level.utils.size());
+	state.player.heldUtilSuckIndex.reserve(level.utils.size());
+
+	message = Message::NONE;
+	events.clear();
+	clearHistory();
+	rebuildOccupancy();
+	resyncPatrolSteps(); // Everyone starts at the top of their schedule (step 0), which is the first place this looks.
+	stateHash = computeHash();
+}
+
+void MoxySim::setState(const simState &newState)
+{
+	state = newState;
+	events.clear();
+	clearHistory();
+	rebuildOccupancy();
+	resyncPatrolSteps();
+	stateHash = computeHash();
+}
+
+int MoxySim::getPackedSize() const
+{
+	// Player: x, y (int16), facing, held trap counts (uint8), held keys (int16), turns remaining (int32).
+	// Patrollers and traps: x, y (int16), facing/state (uint8). Blocks, keys, gates: state (uint8).
+	// Then every held trap index (int16), push list first, with room for every trap in the level.
+	const int playerSize = 2 + 2 + 1 + 1 + 1 + 2 + 4;
+	const int numPatrollers = level.pushers.size() + level.suckers.size();
+	const int numImmobiles = level.blocks.size() + level.keys.size() + level.gates.size();
+	const int numUtils = level.utils.size();
+	return playerSize + (numPatrollers * 5) + numImmobiles + (numUtils * 5) + (numUtils * 2);
+}
+
+void MoxySim::packState(uint8_t *out) const
+{
+	const auto put = [&out](const auto value) {
+		memcpy(out, &value, sizeof(value));
+		out += sizeof(value);
+	};
+	const auto putPoint = [&put](const simPoint &pos) {
+		put(int16_t(pos.x));
+		put(int16_t(pos.y));
+	};
+
+	putPoint(state.player.pos);
+	put(uint8_t(state.player.facing));
+	put(uint8_t(state.player.heldUtilPushIndex.size()));
+	put(uint8_t(state.player.heldUtilSuckIndex.size()));
+	put(int16_t(state.player.heldKeys));
+	put(int32_t(state.turnsRemaining));
+
+	for (const std::vector<simPatroller>* patrollers : { &state.pushers, &state.suckers })
+	{
+		for (const auto& patroller : *patrollers)
+		{
+			putPoint(patroller.pos);
+			put(uint8_t(patroller.facing));
+		}
+	}
+	for (const std::vector<ImmobileState>* immobiles : { &state.blocks, &state.keys, &state.gates })
+	{
+		for (const auto& immobile : *immobiles)
+			put(uint8_t(immobile));
+	}
+	for (const auto& util : state.utils)
+	{
+		putPoint(util.pos);
+		put(uint8_t(util.state));
+	}
+
+	// Unused held slots are zeroed, so equal states always pack to equal bytes.
+	const int numUtils = level.utils.size();
+	int numHeld = 0;
+	for (const std::vector<int>* held : { &state.player.heldUtilPushIndex, &state.player.heldUtilSuckIndex })
+	{
+		for (const int utilNum : *held)
+		{
+			put(int16_t(utilNum));
+			numHeld++;
+		}
+	}
+	for (; numHeld < numUtils; numHeld++)
+		put(int16_t(0));
+}
+
+void MoxySim::unpackState(const uint8_t *in)
+{
+	const auto take = [&in](auto &value) {
+		memcpy(&value, in, sizeof(value));
+		in += sizeof(value);
+	};
+	const auto takeInt16 = [&take]() {
+		int16_t value;
+		take(value);
+		return int(value);
+	};
+	const auto takeUint8 = [&take]() {
+		uint8_t value;
+		take(value);
+		return int(value);
+	};
+	const auto takePoint = [&takeInt16]() {
+		const int x = takeInt16();
+		const int y = takeInt16();
+		return simPoint{ x, y };
+	};
+
+	state.player.pos = takePoint();
+	state.player.facing = Facing(takeUint8());
+	const int numHeldPush = takeUint8();
+	const int numHeldSuck = takeUint8();
+	state.player.heldKeys = takeInt16();
+	int32_t turnsRemaining;
+	take(turnsRemaining);
+	state.turnsRemaining = turnsRemaining;
+
+	state.pushers.resize(level.pushers.size());
+	state.suckers.resize(level.suckers.size());
+	for (std::vector<simPatroller>* patrollers : { &state.pushers, &state.suckers })
+	{
+		for (auto& patroller : *patrollers)
+		{
+			patroller.pos = takePoint();
+			patroller.facing = Facing(takeUint8());
+		}
+	}
+	state.blocks.resize(level.blocks.size());
+	state.keys.resize(level.keys.size());
+	state.gates.resize(level.gates.size());
+	for (std::vector<ImmobileState>* immobiles : { &state.blocks, &state.keys, &state.gates })
+	{
+		for (auto& immobile : *immobiles)
+			immobile = ImmobileState(takeUint8());
+	}
+	state.utils.resize(level.utils.size());
+	for (auto& util : state.utils)
+	{
+		util.pos = takePoint();
+		util.state = UtilState(takeUint8());
+	}
+	state.player.heldUtilPushIndex.resize(numHeldPush);
+	for (auto& utilNum : state.player.heldUtilPushIndex)
+		utilNum = takeInt16();
+	state.player.heldUtilSuckIndex.resize(numHeldSuck);
+	for (auto& utilNum : state.player.heldUtilSuckIndex)
+		utilNum = takeInt16();
+
+	message = Message::NONE;
+	events.clear();
+	clearHistory();
+	rebuildOccupancy();
+	resyncPatrolSteps();
+	stateHash = computeHash();
+}
+
+int MoxySim::cellIndex(const simPoint &pos)
+{
+	if (pos.x < 0 || pos.x >= gridRowSize || pos.y < 0 || pos.y >= gridColSize)
+		return -1;
+	return (pos.y * gridRowSize) + pos.x;
+}
+
+MoxySim::TurnResult MoxySim::playerTurn(const Action action)
+{
+	message = Message::NONE;
+	events.clear();
+	turnStart = history.size();
+
+	// The player's own fields change all over the place during a turn (knockback, pulls, teleports...),
+	// but only where they end up matters for history, so they're compared once at the end instead of journaled at every change.
+	const simPoint posBefore = state.player.pos;
+	const Facing facingBefore = state.player.facing;
+	const int keysBefore = state.player.heldKeys;
+	const int turnsBefore = state.turnsRemaining;
+
+	const TurnResult result = resolveTurn(action);
+
+	if (state.player.pos != posBefore || state.player.facing != facingBefore)
+		recordDelta(simDelta{ -1, 0, 0, DeltaType::PLAYER, packTags(int(facingBefore), int(state.player.facing)), packPoint(posBefore), packPoint(state.player.pos) });
+	if (state.player.heldKeys != keysBefore)
+		recordDelta(simDelta{ -1, 0, 0, DeltaType::PLAYER_KEYS, 0, keysBefore, state.player.heldKeys });
+	if (state.turnsRemaining != turnsBefore)
+		recordDelta(simDelta{ -1, 0, 0, DeltaType::TURNS_REMAINING, 0, turnsBefore, state.turnsRemaining });
+	commitTurnHistory();
+
+	return result;
+}
+
+bool MoxySim::allGatesOpened() const
+{
+	for (const auto& gate : state.gates)
+	{
+		if (gate != ImmobileState::INVISIBLE)
+			return false;
+	}
+	return true;
+}
+
+bool MoxySim::undo()
+{
+	if (!canUndo())
+		return false;
+
+	message = Message::NONE;
+	events.clear();
+	historyCursor--;
+	const int start = historyTurns[historyCursor];
+	const int end = historyCursor + 1 < int(historyTurns.size()) ? historyTurns[historyCursor + 1] : int(history.size());
+	for (int i = end - 1; i >= start; i--)
+		applyDelta(history[i], false);
+	return true;
+}
+
+bool MoxySim::redo()
+{
+	if (!canRedo())
+		return false;
+
+	message = Message::NONE;
+	events.clear();
+	const int start = historyTurns[historyCursor];
+	const int end = historyCursor + 1 < int(historyTurns.size()) ? historyTurns[historyCursor + 1] : int(history.size());
+	for (int i = start; i < end; i++)
+		applyDelta(history[i], true);
+	historyCursor++;
+	return true;
+}
+
+void MoxySim::setHistoryEnabled(const bool enabled)
+{
+	historyEnabled = enabled;
+	clearHistory();
+}
+
+// private:
+
+MoxySim::TurnResult MoxySim::resolveTurn(const Action action)
+{
+	// This is a turn-based game, so we process moves in order: Player -> Patrollers -> Player -> Patrollers -> Etc.
+	// If the player's action didn't use up their turn, patrollers don't get to move either.
+	bool turnUsed = false;
+	switch (action)
+	{
+	case Action::MOVE_LEFT:
+		turnUsed = playerMove(Facing::LEFT);
+		break;
+	case Action::MOVE_RIGHT:
+		turnUsed = playerMove(Facing::RIGHT);
+		break;
+	case Action::MOVE_UP:
+		turnUsed = playerMove(Facing::UP);
+		break;
+	case Action::MOVE_DOWN:
+		turnUsed = playerMove(Facing::DOWN);
+		break;
+	case Action::PLACE_PUSHER_UTIL:
+		turnUsed = playerPlaceUtil(state.player.heldUtilPushIndex, Message::TRAP_PUSHER_DEPLOYED);
+		break;
+	case Action::PLACE_SUCKER_UTIL:
+		turnUsed = playerPlaceUtil(state.player.heldUtilSuckIndex, Message::TRAP_SUCKER_DEPLOYED);
+		break;
+	case Action::NONE:
+		break;
+	}
+
+	if (!turnUsed)
+		return TurnResult::BLOCKED;
+
+	updatePositionPatrollers();
+	suckInRange();
+
+	if (allGatesOpened())
+		return TurnResult::COMPLETE;
+	else if (state.turnsRemaining <= 0)
+		return TurnResult::FAILED;
+	else
+		return TurnResult::PLAYING;
+}
+
+void MoxySim::clearHistory()
+{
+	history.clear();
+	historyTurns.clear();
+	historyCursor = 0;
+	turnStart = 0;
+}
+
+void MoxySim::commitTurnHistory()
+{
+	// A turn that changed nothing (e.g. walking into a wall while already facing it) isn't worth a step of undo,
+	// and shouldn't throw away what could be redone either.
+	if (int(history.size()) == turnStart)
+		return;
+
+	// Otherwise anything that could have been redone is gone, and this turn's deltas slide down to take its place.
+	int start = turnStart;
+	if (canRedo())
+	{
+		start = historyTurns[historyCursor];
+		history.erase(history.begin() + start, history.begin() + turnStart);
+		historyTurns.resize(historyCursor);
+	}
+	historyTurns.push_back(start);
+	historyCursor++;
+}
+
+void MoxySim::journalPatroller(const DeltaType type, const int index, const simPatroller &before, const int stepBefore, const simPatroller &after, const int stepAfter)
+{
+	recordDelta(simDelta{ int16_t(index), int16_t(stepBefore), int16_t(stepAfter), type,
+		packTags(int(before.facing), int(after.facing)), packPoint(before.pos), packPoint(after.pos) });
+}
+
+void MoxySim::applyDelta(const simDelta &delta, const bool forward)
+{
+	const int32_t value = forward ? delta.after : delta.before;
+	const int tag = forward ? (delta.tags >> 4) : (delta.tags & 0xF);
+	const int i = delta.index;
+	stateHash ^= deltaHash(delta);
+
+	switch (delta.type)
+	{
+	case DeltaType::PLAYER:
+		state.player.pos = unpackPoint(value);
+		state.player.facing = Facing(tag);
+		logEvent(EventType::PLAYER_MOVED, -1, state.player.pos);
+		break;
+	case DeltaType::PLAYER_KEYS:
+		state.player.heldKeys = value;
+		break;
+	case DeltaType::TURNS_REMAINING:
+		state.turnsRemaining = value;
+		logEvent(EventType::PLAYER_MOVED, -1, state.player.pos);
+		break;
+	case DeltaType::HELD_PUSH_ADDED:
+	case DeltaType::HELD_SUCK_ADDED:
+	{
+		std::vector<int>& held = delta.type == DeltaType::HELD_PUSH_ADDED ? state.player.heldUtilPushIndex : state.player.heldUtilSuckIndex;
+		stateHash ^= heldHash(held, delta.type);
+		if (forward)
+			held.push_back(i);
+		else
+			held.pop_back();
+		stateHash ^= heldHash(held, delta.type);
+		break;
+	}
+	case DeltaType::HELD_PUSH_PLACED:
+	case DeltaType::HELD_SUCK_PLACED:
+	{
+		const DeltaType addedType = delta.type == DeltaType::HELD_PUSH_PLACED ? DeltaType::HELD_PUSH_ADDED : DeltaType::HELD_SUCK_ADDED;
+		std::vector<int>& held = delta.type == DeltaType::HELD_PUSH_PLACED ? state.player.heldUtilPushIndex : state.player.heldUtilSuckIndex;
+		stateHash ^= heldHash(held, addedType);
+		if (forward)
+			held.erase(held.begin());
+		else
+			held.insert(held.begin(), i);
+		stateHash ^= heldHash(held, addedType);
+		break;
+	}
+	case DeltaType::BLOCK:
+		setImmobileState(level.blocks[i], state.blocks[i], ImmobileState(tag), occupancy.blocks);
+		logEvent(EventType::BLOCK_DESTROYED, i, level.blocks[i].initial);
+		break;
+	case DeltaType::KEY:
+		setImmobileState(level.keys[i], state.keys[i], ImmobileState(tag), occupancy.keys);
+		logEvent(EventType::KEY_OBTAINED, i, level.keys[i].initial);
+		break;
+	case DeltaType::GATE:
+		setImmobileState(level.gates[i], state.gates[i], ImmobileState(tag), occupancy.gates);
+		logEvent(EventType::GATE_OPENED, i, level.gates[i].initial);
+		break;
+	case DeltaType::UTIL:
+		setUtil(i, unpackPoint(value), UtilState(tag));
+		logEvent(EventType::TRAP_DEPLOYED, i, state.utils[i].pos);
+		break;
+	case DeltaType::PUSHER:
+		movePatroller(state.pushers[i], unpackPoint(value), occupancy.pushers);
+		state.pushers[i].facing = Facing(tag);
+		pusherTrack.steps[i] = forward ? delta.stepAfter : delta.stepBefore;
+		logEvent(EventType::PUSHER_MOVED, i, state.pushers[i].pos);
+		break;
+	case DeltaType::SUCKER:
+		movePatroller(state.suckers[i], unpackPoint(value), occupancy.suckers);
+		state.suckers[i].facing = Facing(tag);
+		suckerTrack.steps[i] = forward ? delta.stepAfter : delta.stepBefore;
+		logEvent(EventType::SUCKER_MOVED, i, state.suckers[i].pos);
+		break;
+	case DeltaType::PATROLLERS_ADVANCED:
+		stepPatrollers(DeltaType::PUSHER, uint32_t(delta.before), level.pushers, state.pushers, occupancy.pushers, pusherTrack, forward);
+		stepPatrollers(DeltaType::SUCKER, uint32_t(delta.after), level.suckers, state.suckers, occupancy.suckers, suckerTrack, forward);
+		break;
+	}
+}
+
+void MoxySim::stepPatrollers(const DeltaType type, const uint32_t advanced, const std::vector<simPatrollerDef> &defs, std::vector<simPatroller> &patrollers, simLayer &layer, patrolTrack &track, const bool forward)
+{
+	// One on its schedule is wherever the schedule has it, a step on (redo) or back (undo) from the step it's on.
+	// One off it went straight ahead at its movement speed, so it's that far on or back along its facing.
+	const EventType moved = type == DeltaType::PUSHER ? EventType::PUSHER_MOVED : EventType::SUCKER_MOVED;
+	const int numPatrollers = std::min(int(patrollers.size()), 32);
+	for (int i = 0; i < numPatrollers; i++)
+	{
+		if (!(advanced & (uint32_t(1) << i)))
+			continue;
+		const simPatrolSchedule& schedule = track.schedules[i];
+		int& step = track.steps[i];
+		simPatroller to = patrollers[i];
+		if (step >= 0)
+		{
+			step = forward ? schedule.next(step) : schedule.previous(step);
+			to = schedule.steps[step];
+		}
+		else
+		{
+			const simDirection& d = directions[static_cast<int>(to.facing)];
+			const int amount = forward ? defs[i].movementSpeed : -defs[i].movementSpeed;
+			to.pos.x += d.dx * amount;
+			to.pos.y += d.dy * amount;
+		}
+		stateHash ^= patrollerHash(type, i, patrollers[i]) ^ patrollerHash(type, i, to);
+		movePatroller(patrollers[i], to.pos, layer);
+		patrollers[i].facing = to.facing;
+		logEvent(moved, i, to.pos);
+	}
+}
+
+// ---------
+// HASHING
+// ---------
+// Rather than tables of random numbers, each (kind of thing, which one, value) gets its key from a splitmix64 mix.
+// It's just as good for Zobrist purposes, covers values tables couldn't (turns remaining, squares off the grid),
+// and comes out the same in every run, so hashes can be stored and compared later.
+
+uint64_t MoxySim::zobrist(const DeltaType type, const int index, const uint64_t value)
+{
+	// Value (up to 36 bits: a packed position and a tag), index (16 bits) and type are packed side by side without overlapping,
+	// and splitmix64's mix is a bijection, so two different inputs never share a key.
+	return splitMix(value | (uint64_t(uint16_t(index)) << 36) | (uint64_t(type) << 52));
+}
+
+uint64_t MoxySim::getLevelHash(const simLevel &level)
+{
+	// Ordered parts are chained, each value mixed in on top of everything before it.
+	uint64_t hash = splitMix(uint32_t(level.turnsInitial));
+	const auto chain = [&](const uint64_t value) { hash = splitMix(hash ^ value); };
+	chain(uint32_t(packPoint(level.player)));
+
+	const auto chainPatrollers = [&](const std::vector<simPatrollerDef> &defs) {
+		chain(defs.size());
+		for (const auto& def : defs)
+		{
+			chain(uint32_t(packPoint(def.initial)) | (uint64_t(def.facingInitial) << 32) | (uint64_t(def.patrolDir) << 40));
+			chain(uint32_t(def.patrolBoundUp) | (uint64_t(uint32_t(def.patrolBoundDown)) << 32));
+			chain(uint32_t(def.patrolBoundLeft) | (uint64_t(uint32_t(def.patrolBoundRight)) << 32));
+			chain(uint32_t(def.movementSpeed));
+		}
+	};
+	chainPatrollers(level.pushers);
+	chainPatrollers(level.suckers);
+
+	// Teleports go in pairs by where they are in the list (teleportHitCheck sends 0 to 1 and back), so their order is part of the level.
+	chain(level.teleports.size());
+	for (const auto& def : level.teleports)
+		chain(uint32_t(packPoint(def.initial)));
+
+	// Unordered parts are summed, so the order they're listed in doesn't matter but two of the same thing on a square still counts twice.
+	// Which list a token is in goes in above the position, so a key and a gate on the same square don't look alike.
+	const auto sumImmobiles = [&](const std::vector<simImmobileDef> &defs, const uint64_t list) {
+		uint64_t sum = 0;
+		for (const auto& def : defs)
+			sum += splitMix(uint32_t(packPoint(def.initial)) | (list << 48));
+		return sum;
+	};
+	chain(sumImmobiles(level.blocks, 1));
+	chain(sumImmobiles(level.keys, 2));
+	chain(sumImmobiles(level.gates, 3));
+	chain(sumImmobiles(level.hazards, 4));
+
+	uint64_t utils = 0;
+	for (const auto& util : level.utils)
+		utils += splitMix(uint32_t(packPoint(util.initial)) | (uint64_t(util.type) << 32) | (uint64_t(util.stateBase) << 40) | (uint64_t(6) << 48));
+	chain(utils);
+	return hash;
+}
+
+uint64_t MoxySim::deltaHash(const simDelta &delta)
+{
+	// What XORing the before value out and the after value in comes to. The same for undo and redo.
+	const int tagBefore = delta.tags & 0xF;
+	const int tagAfter = delta.tags >> 4;
+	switch (delta.type)
+	{
+	case DeltaType::PLAYER:
+	case DeltaType::UTIL:
+	case DeltaType::PUSHER:
+	case DeltaType::SUCKER:
+		return zobristTagged(delta.type, delta.index, delta.before, tagBefore) ^ zobristTagged(delta.type, delta.index, delta.after, tagAfter);
+	case DeltaType::PLAYER_KEYS:
+	case DeltaType::TURNS_REMAINING:
+		return zobrist(delta.type, delta.index, uint32_t(delta.before)) ^ zobrist(delta.type, delta.index, uint32_t(delta.after));
+	case DeltaType::BLOCK:
+	case DeltaType::KEY:
+	case DeltaType::GATE:
+		return zobrist(delta.type, delta.index, tagBefore) ^ zobrist(delta.type, delta.index, tagAfter);
+	default:
+		// Held trap lists are hashed by position in the list, which a single delta doesn't know, so the code changing them does it.
+		return 0;
+	}
+}
+
+uint64_t MoxySim::heldHash(const std::vector<int> &held, const DeltaType type)
+{
+	// Traps are placed first picked up, first placed, so the order is part of the state.
+	uint64_t hash = 0;
+	const int numHeld = held.size();
+	for (int i = 0; i < numHeld; i++)
+		hash ^= zobrist(type, i, held[i]);
+	return hash;
+}
+
+uint64_t MoxySim::computeHash() const
+{
+	// From scratch, for load/reset/setState. Indexes and values line up with the deltas a turn records,
+	// so the hash after any sequence of turns is the same as computing it fresh.
+	uint64_t hash = zobristTagged(DeltaType::PLAYER, -1, packPoint(state.player.pos), int(state.player.facing));
+	hash ^= zobrist(DeltaType::PLAYER_KEYS, -1, uint32_t(state.player.heldKeys));
+	hash ^= zobrist(DeltaType::TURNS_REMAINING, -1, uint32_t(state.turnsRemaining));
+	hash ^= heldHash(state.player.heldUtilPushIndex, DeltaType::HELD_PUSH_ADDED);
+	hash ^= heldHash(state.player.heldUtilSuckIndex, DeltaType::HELD_SUCK_ADDED);
+
+	const int numPushers = state.pushers.size();
+	for (int i = 0; i < numPushers; i++)
+		hash ^= patrollerHash(DeltaType::PUSHER, i, state.pushers[i]);
+	const int numSuckers = state.suckers.size();
+	for (int i = 0; i < numSuckers; i++)
+		hash ^= patrollerHash(DeltaType::SUCKER, i, state.suckers[i]);
+
+	const auto hashImmobiles = [](const std::vector<ImmobileState> &states, const DeltaType type) {
+		uint64_t immobilesHash = 0;
+		const int numImmobiles = states.size();
+		for (int i = 0; i < numImmobiles; i++)
+			immobilesHash ^= zobrist(type, i, int(states[i]));
+		return immobilesHash;
+	};
+	hash ^= hashImmobiles(state.blocks, DeltaType::BLOCK);
+	hash ^= hashImmobiles(state.keys, DeltaType::KEY);
+	hash ^= hashImmobiles(state.gates, DeltaType::GATE);
+
+	const int numUtils = state.utils.size();
+	for (int i = 0; i < numUtils; i++)
+		hash ^= zobristTagged(DeltaType::UTIL, i, packPoint(state.utils[i].pos), int(state.utils[i].state));
+	return hash;
+}
+
+void MoxySim::rebuildOccupancy()
+{
+	occupancy = simOccupancy();
+
+	const auto addImmobiles = [](const std::vector<simImmobileDef> &defs, const std::vector<ImmobileState> &states, simLayer &layer) {
+		const int numImmobiles = defs.size();
+		for (int i = 0; i < numImmobiles; i++)
+		{
+			if (immobileInLayer(defs[i], states[i]))
+				layer.add(cellIndex(defs[i].initial));
+		}
+	};
+	addImmobiles(level.blocks, state.blocks, occupancy.blocks);
+	addImmobiles(level.gates, state.gates, occupancy.gates);
+	addImmobiles(level.keys, state.keys, occupancy.keys);
+	addImmobiles(level.hazards, state.hazards, occupancy.hazards);
+	addImmobiles(level.teleports, state.teleports, occupancy.teleports);
+
+	for (const auto& pusher : state.pushers)
+		occupancy.pushers.add(cellIndex(pusher.pos));
+	for (const auto& sucker : state.suckers)
+		occupancy.suckers.add(cellIndex(sucker.pos));
+
+	const int numUtils = state.utils.size();
+	for (int i = 0; i < numUtils; i++)
+	{
+		// Temporarily mark the util as HELD (not on the grid) so setUtil's bookkeeping adds it cleanly.
+		const simUtil util = state.utils[i];
+		state.utils[i].state = UtilState::HELD;
+		setUtil(i, util.pos, util.state);
+	}
+}
+
+bool MoxySim::immobileInLayer(const simImmobileDef &def, const ImmobileState state)
+{
+	// Keys are only there to be picked up while ACTIVE. Everything else is in the way until it's gone.
+	if (def.type == ImmobileType::KEY)
+		return state == ImmobileState::ACTIVE;
+	return state != ImmobileState::INVISIBLE;
+}
+
+void MoxySim::setImmobileState(const simImmobileDef &def, ImmobileState &current, const ImmobileState newState, simLayer &layer)
+{
+	const bool wasInLayer = immobileInLayer(def, current);
+	const bool isInLayer = immobileInLayer(def, newState);
+	current = newState;
+	if (wasInLayer && !isInLayer)
+		layer.remove(cellIndex(def.initial));
+	else if (!wasInLayer && isInLayer)
+		layer.add(cellIndex(def.initial));
+}
+
+void MoxySim::setUtil(const int utilNum, const simPoint &newPos, const UtilState newState)
+{
+	simUtil& util = state.utils[utilNum];
+	simLayer& trapLayer = level.utils[utilNum].type == UtilType::PUSHER ? occupancy.trapsPusherActive : occupancy.trapsSuckerActive;
+
+	const int oldCell = cellIndex(util.pos);
+	if (util.state != UtilState::HELD)
+		occupancy.utils.remove(oldCell);
+	if (util.state == UtilState::ACTIVE && level.utils[utilNum].type != UtilType::ERROR)
+		trapLayer.remove(oldCell);
+
+	util.pos = newPos;
+	util.state = newState;
+
+	const int newCell = cellIndex(util.pos);
+	if (util.state != UtilState::HELD)
+		occupancy.utils.add(newCell);
+	if (util.state == UtilState::ACTIVE && level.utils[utilNum].type != UtilType::ERROR)
+		trapLayer.add(newCell);
+}
+
+void MoxySim::movePatroller(simPatroller &patroller, const simPoint &newPos, simLayer &layer)
+{
+	layer.remove(cellIndex(patroller.pos));
+	patroller.pos = newPos;
+	layer.add(cellIndex(patroller.pos));
+}
+
+const MoxySim::simBitboard& MoxySim::suckRangeMask(const int cell)
+{
+	// For every square, the (up to four) squares exactly suckRange away in a straight line.
+	// Built once, so checking whether any magnet is in pulling range is a handful of word-wide ANDs.
+	static const std::vector<simBitboard> masks = []() {
+		std::vector<simBitboard> built(gridCellCount);
+		for (int i = 0; i < gridCellCount; i++)
+		{
+			const int col = i % gridRowSize;
+			const int row = i / gridRowSize;
+			if (col - suckRange >= 0)
+				built[i].set(i - suckRange);
+			if (col + suckRange < gridRowSize)
+				built[i].set(i + suckRange);
+			if (row - suckRange >= 0)
+				built[i].set(i - (suckRange * gridRowSize));
+			if (row + suckRange < gridColSize)
+				built[i].set(i + (suckRange * gridRowSize));
+		}
+		return built;
+	}();
+	return masks[cell];
+}
+
+// -------------------------------
+// DIRECTION-SPECIALIZED KERNELS
+// -------------------------------
+// Everything that moves a token one way or another is written once, as a template on the direction,
+// then stamped out per direction through withDirection. In each copy the direction's dx/dy/leash are compile-time constants,
+// so it's straight-line code, and the switch on Facing happens once up front instead of inside every kernel.
+
+constexpr MoxySim::simDirection MoxySim::directions[];
+
+template<typename Kernel>
+auto MoxySim::withDirection(const Facing facing, Kernel &&kernel) -> decltype(kernel(std::integral_constant<Facing, Facing::NEUTRAL>()))
+{
+	switch (facing)
+	{
+	case Facing::UP:
+		return kernel(std::integral_constant<Facing, Facing::UP>());
+	case Facing::DOWN:
+		return kernel(std::integral_constant<Facing, Facing::DOWN>());
+	case Facing::LEFT:
+		return kernel(std::integral_constant<Facing, Facing::LEFT>());
+	case Facing::RIGHT:
+		return kernel(std::integral_constant<Facing, Facing::RIGHT>());
+	default:
+		return kernel(std::integral_constant<Facing, Facing::NEUTRAL>());
+	}
+}
+
+template<MoxySim::Facing dir>
+MoxySim::simPoint MoxySim::stepClamped(const simPoint &pos, const int amount)
+{
+	// Knockback can't push anything off the grid, it stops at the edge square instead.
+	// Only the axis being moved along is clamped.
+	constexpr simDirection d = direction<dir>();
+	simPoint next = pos;
+	if (d.dx != 0)
+		next.x = clampX(pos.x + (d.dx * amount));
+	if (d.dy != 0)
+		next.y = clampY(pos.y + (d.dy * amount));
+	return next;
+}
+
+bool MoxySim::playerMove(const Facing facing)
+{
+	if (state.player.facing != facing)
+	{
+		state.player.facing = facing;
+		logEvent(EventType::PLAYER_FACED, -1, state.player.pos);
+	}
+	return withDirection(facing, [this](auto dir) { return playerMoveToward<decltype(dir)::value>(); });
+}
+
+template<MoxySim::Facing dir>
+bool MoxySim::playerMoveToward()
+{
+	bool turnUsed = false;
+	if (hitSolidObjectPlayerMoving<dir>(turnUsed))
+		return turnUsed;
+
+	constexpr simDirection d = direction<dir>();
+	state.player.pos.x += d.dx * playerMovementSpeed;
+	state.player.pos.y += d.dy * playerMovementSpeed;
+	state.turnsRemaining--;
+	logEvent(EventType::PLAYER_MOVED, -1, state.player.pos);
+	teleportHitCheck();
+	return true;
+}
+
+template<MoxySim::Facing dir>
+bool MoxySim::hitSolidObjectPlayerMoving(bool &turnUsed)
+{
+	// Areas beyond grid edges are solid objects
+	// Patroller and player are solid objects
+	// Gate is considered solid, unless a player with a key is hitting it
+	// Keys are not solid for player, and are solid for enemies
+
+	// Running into a pusher is "solid", in that the player doesn't get to make their move,
+	// but it still uses up their turn, since they get knocked back. In that case turnUsed is set.
+
+	constexpr simDirection d = direction<dir>();
+	const simPoint next{ state.player.pos.x + (d.dx * playerMovementSpeed), state.player.pos.y + (d.dy * playerMovementSpeed) };
+
+	const int nextCell = cellIndex(next);
+	if (nextCell < 0)
+		return true;
+
+	if (occupancy.blocks.test(nextCell))
+	{
+		message = Message::OBSTACLE;
+		return true;
+	}
+	else if (occupancy.hazards.test(nextCell))
+	{
+		message = Message::HAZARD;
+		return true;
+	}
+	else if (occupancy.teleports.test(nextCell))
+	{
+		message = Message::TELEPORT;
+		return false;
+	}
+	else if (occupancy.suckers.test(nextCell))
+	{
+		return true;
+	}
+	else if (occupancy.pushers.test(nextCell))
+	{
+		for (int i = 0; i < playerKnockbackAmount; i++)
+		{
+			knockbackPlayerMoving<dir>();
+		}
+		hazardHitCheck();
+		teleportHitCheck();
+		turnUsed = true;
+		return true;
+	}
+	else if (hitUtil(nextCell))
+	{
+		return false;
+	}
+	else if (occupancy.gates.test(nextCell))
+	{
+		if (state.player.heldKeys > 0)
+		{
+			hitImmobileObjectAndDelete(level.gates, state.gates, occupancy.gates, nextCell);
+			state.player.heldKeys--;
+			return false;
+		}
+		else
+		{
+			message = Message::KEY_NEEDED;
+			return true;
+		}
+	}
+	else if (hitImmobileObjectAndDelete(level.keys, state.keys, occupancy.keys, nextCell))
+	{
+		state.player.heldKeys++;
+		message = Message::KEY_OBTAINED;
+		return false;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+void MoxySim::knockbackPlayerMoving()
+{
+	withDirection(state.player.facing, [this](auto dir) { knockbackPlayerMoving<decltype(dir)::value>(); });
+}
+
+template<MoxySim::Facing dir>
+void MoxySim::knockbackPlayerMoving()
+{
+	// If player is moving into enemy (facing dir), we knockback player in the opposite direction
+
+	knockbackPlayerTo(stepClamped<direction<dir>().opposite>(state.player.pos, playerMovementSpeed));
+
+	const int cell = cellIndex(state.player.pos);
+
+	if (hitImmobileObjectAndDelete(level.blocks, state.blocks, occupancy.blocks, cell)
+		|| occupancy.pushers.test(cell)
+		|| occupancy.suckers.test(cell))
+	{
+		return;
+	}
+	hitGateOrKey(cell);
+}
+
+template<MoxySim::Facing dir>
+void MoxySim::knockbackEnemyMoving()
+{
+	// If enemy is moving into player (facing dir), we knockback player in the direction enemy is moving
+
+	knockbackPlayerTo(stepClamped<dir>(state.player.pos, playerMovementSpeed));
+
+	const int cell = cellIndex(state.player.pos);
+
+	if (hitImmobileObjectAndDelete(level.blocks, state.blocks, occupancy.blocks, cell))
+		return;
+	hitGateOrKey(cell);
+}
+
+template<MoxySim::Facing dir, MoxySim::PatrollerType type>
+void MoxySim::knockbackHitTrap(const simPatrollerDef &def, simPatroller &patroller, simLayer &layer)
+{
+	// Logistics of this feature:
+	// Follow the same logic as player knockback (e.g. check for knockback hit BEFORE enemy is moved)
+	// If there's a collision with a knockback trap, knockback patroller one square (do this twice)
+
+	// If patroller is moving into knockback trap, we knockback patroller in the opposite direction
+
+	movePatroller(patroller, stepClamped<direction<dir>().opposite>(patroller.pos, def.movementSpeed), layer);
+
+	if (type == PatrollerType::PUSHER && hitPlayer(patroller))
+	{
+		// Note this knocks the player back along the way the *player* is facing, not the patroller.
+		for (int i = 0; i < playerKnockbackAmount; i++)
+		{
+			knockbackPlayerMoving();
+		}
+	}
+}
+
+MoxySim::simPatroller MoxySim::patrolStep(const simPatrollerDef &def, const simPatroller &patroller)
+{
+	return withDirection(patroller.facing, [&](auto dir) { return patrolStepToward<decltype(dir)::value>(def, patroller); });
+}
+
+template<MoxySim::Facing dir>
+MoxySim::simPatroller MoxySim::patrolStepToward(const simPatrollerDef &def, const simPatroller &patroller)
+{
+	// Patrollers bounce back and forth inside their leash. Turning around at the end of the leash takes up their turn.
+	// A patroller facing across its patrol axis (bad level data) doesn't move at all.
+
+	constexpr simDirection d = direction<dir>();
+	simPatroller next = patroller;
+
+	if (d.axis == PatrolDir::ERROR || d.axis != def.patrolDir)
+		return next;
+
+	// How far along this direction a position is, so the one comparison covers all four leash bounds.
+	const auto along = [&](const simPoint &pos) { return (pos.x * d.dx) + (pos.y * d.dy); };
+
+	if (along(patroller.pos) + 1 > along(def.initial) + def.*d.leash)
+	{
+		next.facing = d.opposite;
+	}
+	else
+	{
+		next.pos.x += d.dx * def.movementSpeed;
+		next.pos.y += d.dy * def.movementSpeed;
+	}
+	return next;
+}
+
+void MoxySim::updatePositionPatrollers()
+{
+	const auto changed = [](const simPatroller &before, const simPatroller &after) {
+		return before.pos != after.pos || before.facing != after.facing;
+	};
+
+	// A patroller that just took the next step of its schedule, or went straight ahead while off it, can be put back without
+	// being told where it was, so all of those share one PATROLLERS_ADVANCED delta, a bit each, and the hash is kept up here instead of by the delta.
+	// Only the first 32 of each kind fit, and any after that are journaled like a patroller a trap moved.
+	uint32_t advanced[2] = {};
+	const auto update = [&](const DeltaType type, const int i, const simPatrollerDef &def, const simPatroller &before, const int stepBefore, const simPatroller &after, const patrolTrack &track) {
+		const int stepAfter = track.steps[i];
+		if (!changed(before, after) && stepBefore == stepAfter)
+			return;
+		const simPatrolSchedule& schedule = track.schedules[i];
+		const bool onSchedule = stepBefore >= 0 && stepAfter == schedule.next(stepBefore) && schedule.hasPrevious(stepAfter);
+		const bool straightAhead = stepBefore < 0 && stepAfter < 0 && before.facing == after.facing
+			&& after.pos == patrolStep(def, before).pos;
+		if (i < 32 && (onSchedule || straightAhead))
+		{
+			advanced[type == DeltaType::PUSHER ? 0 : 1] |= uint32_t(1) << i;
+			stateHash ^= patrollerHash(type, i, before) ^ patrollerHash(type, i, after);
+		}
+		else
+		{
+			journalPatroller(type, i, before, stepBefore, after, stepAfter);
+		}
+	};
+
+	const int numPushers = state.pushers.size();
+	for (int i = 0; i < numPushers; i++)
+	{
+		const simPatroller before = state.pushers[i];
+		const int stepBefore = pusherTrack.steps[i];
+		updatePositionPatrollerMoves<PatrollerType::PUSHER>(level.pushers[i], state.pushers[i], occupancy.pushers, pusherTrack, i);
+		if (changed(before, state.pushers[i]))
+			logEvent(EventType::PUSHER_MOVED, i, state.pushers[i].pos);
+		update(DeltaType::PUSHER, i, level.pushers[i], before, stepBefore, state.pushers[i], pusherTrack);
+	}
+
+	const int numSuckers = state.suckers.size();
+	for (int i = 0; i < numSuckers; i++)
+	{
+		const simPatroller before = state.suckers[i];
+		const int stepBefore = suckerTrack.steps[i];
+		updatePositionPatrollerMoves<PatrollerType::SUCKER>(level.suckers[i], state.suckers[i], occupancy.suckers, suckerTrack, i);
+		if (changed(before, state.suckers[i]))
+			logEvent(EventType::SUCKER_MOVED, i, state.suckers[i].pos);
+		update(DeltaType::SUCKER, i, level.suckers[i], before, stepBefore, state.suckers[i], suckerTrack);
+	}
+
+	if (advanced[0] != 0 || advanced[1] != 0)
+		recordDelta(simDelta{ 0, 0, 0, DeltaType::PATROLLERS_ADVANCED, 0, int32_t(advanced[0]), int32_t(advanced[1]) });
+}
+
+template<MoxySim::PatrollerType type>
+void MoxySim::updatePositionPatrollerMoves(const simPatrollerDef &def, simPatroller &patroller, simLayer &layer, patrolTrack &track, const int enemyNum)
+{
+	// Where the patroller would go next, if nothing gets in its way, comes straight out of its schedule.
+	// Only a patroller that's been knocked off its schedule needs its bounce worked out here and now.
+	// Which list a patroller is in decides whether it pushes, so that's known at compile time here.
+
+	const simPatrolSchedule& schedule = track.schedules[enemyNum];
+	int& step = track.steps[enemyNum];
+
+	const int nextStep = step >= 0 ? schedule.next(step) : -1;
+	const simPatroller next = nextStep >= 0 ? schedule.steps[nextStep] : patrolStep(def, patroller);
+
+	if (next.facing != patroller.facing)
+	{
+		// Turning around at the end of the leash takes up the patroller's turn.
+		patroller.facing = next.facing;
+		step = nextStep;
+		return;
+	}
+	else if (next.pos == patroller.pos)
+	{
+		return;
+	}
+
+	if (occupancy.trapsPusherActive.test(cellIndex(next.pos)))
+	{
+		withDirection(patroller.facing, [&](auto dir) {
+			for (int i = 0; i < trapKnockbackAmount; i++)
+			{
+				knockbackHitTrap<decltype(dir)::value, type>(def, patroller, layer);
+			}
+		});
+		step = findPatrolStep(schedule, patroller);
+	}
+	else
+	{
+		movePatroller(patroller, next.pos, layer);
+		step = nextStep;
+		if (suckInHitTrap(def, patroller, layer))
+			step = findPatrolStep(schedule, patroller);
+		if (type == PatrollerType::PUSHER && hitPlayer(patroller))
+		{
+			withDirection(patroller.facing, [this](auto dir) {
+				for (int i = 0; i < playerKnockbackAmount; i++)
+				{
+					knockbackEnemyMoving<decltype(dir)::value>();
+				}
+			});
+			hazardHitCheck();
+			teleportHitCheck();
+		}
+	}
+}
+
+bool MoxySim::playerPlaceUtil(std::vector<int> &heldIndex, const Message deployedMessage)
+{
+	// Traps are placed on the square the player is standing on, first picked up, first placed.
+	// Note that placing a trap uses up the player's turn, but doesn't cost any turns remaining.
+	if (heldIndex.empty())
+		return false;
+
+	const int utilNum = heldIndex[0];
+	const simUtil before = state.utils[utilNum];
+	setUtil(utilNum, state.player.pos, UtilState::ACTIVE);
+	logEvent(EventType::TRAP_DEPLOYED, utilNum, state.player.pos);
+	const bool isPush = &heldIndex == &state.player.heldUtilPushIndex;
+	stateHash ^= heldHash(heldIndex, isPush ? DeltaType::HELD_PUSH_ADDED : DeltaType::HELD_SUCK_ADDED);
+	heldIndex.erase(heldIndex.begin());
+	stateHash ^= heldHash(heldIndex, isPush ? DeltaType::HELD_PUSH_ADDED : DeltaType::HELD_SUCK_ADDED);
+	recordDelta(simDelta{ int16_t(utilNum), 0, 0, DeltaType::UTIL, packTags(int(before.state), int(UtilState::ACTIVE)), packPoint(before.pos), packPoint(state.player.pos) });
+	recordDelta(simDelta{ int16_t(utilNum), 0, 0, isPush ? DeltaType::HELD_PUSH_PLACED : DeltaType::HELD_SUCK_PLACED, 0, 0, 0 });
+	message = deployedMessage;
+	if (state.player.facing != Facing::NEUTRAL)
+	{
+		state.player.facing = Facing::NEUTRAL;
+		logEvent(EventType::PLAYER_FACED, -1, state.player.pos);
+	}
+	return true;
+}
+
+bool MoxySim::hitImmobileObjectAndDelete(const std::vector<simImmobileDef> &defs, std::vector<ImmobileState> &states, simLayer &layer, const int cell)
+{
+	// The layer tells us whether there's anything to hit at all. Only when there is
+	// do we go looking for which token it is, so it can be removed.
+	if (!layer.test(cell))
+		return false;
+
+	const int numImmobiles = defs.size();
+	for (int i = 0; i < numImmobiles; i++)
+	{
+		if (states[i] == ImmobileState::ACTIVE && cellIndex(defs[i].initial) == cell)
+		{
+			const ImmobileState before = states[i];
+			switch (defs[i].type)
+			{
+			case ImmobileType::KEY:
+				setImmobileState(defs[i], states[i], ImmobileState::HELD, layer);
+				logEvent(EventType::KEY_OBTAINED, i, defs[i].initial);
+				break;
+			case ImmobileType::GATE:
+				setImmobileState(defs[i], states[i], ImmobileState::INVISIBLE, layer);
+				logEvent(EventType::GATE_OPENED, i, defs[i].initial);
+				break;
+			default:
+				setImmobileState(defs[i], states[i], ImmobileState::INVISIBLE, layer);
+				logEvent(EventType::BLOCK_DESTROYED, i, defs[i].initial);
+				break;
+			}
+			const DeltaType deltaType = &states == &state.keys ? DeltaType::KEY : (&states == &state.gates ? DeltaType::GATE : DeltaType::BLOCK);
+			recordDelta(simDelta{ int16_t(i), 0, 0, deltaType, packTags(int(before), int(states[i])), 0, 0 });
+			return true;
+		}
+	}
+	return false;
+}
+
+bool MoxySim::hitUtil(const int cell)
+{
+	if (!occupancy.utils.test(cell))
+		return false;
+
+	const int numUtils = state.utils.size();
+	for (int i = 0; i < numUtils; i++)
+	{
+		if (state.utils[i].state != UtilState::HELD && cellIndex(state.utils[i].pos) == cell)
+		{
+			if (level.utils[i].type == UtilType::PUSHER)
+			{
+				stateHash ^= zobrist(DeltaType::HELD_PUSH_ADDED, state.player.heldUtilPushIndex.size(), i);
+				state.player.heldUtilPushIndex.push_back(i);
+				recordDelta(simDelta{ int16_t(i), 0, 0, DeltaType::HELD_PUSH_ADDED, 0, 0, 0 });
+				message = Message::TRAP_PUSHER_OBTAINED;
+			}
+			else if (level.utils[i].type == UtilType::SUCKER)
+			{
+				stateHash ^= zobrist(DeltaType::HELD_SUCK_ADDED, state.player.heldUtilSuckIndex.size(), i);
+				state.player.heldUtilSuckIndex.push_back(i);
+				recordDelta(simDelta{ int16_t(i), 0, 0, DeltaType::HELD_SUCK_ADDED, 0, 0, 0 });
+				message = Message::TRAP_SUCKER_OBTAINED;
+			}
+			recordDelta(simDelta{ int16_t(i), 0, 0, DeltaType::UTIL, packTags(int(state.utils[i].state), int(UtilState::HELD)), packPoint(state.utils[i].pos), packPoint(state.utils[i].pos) });
+			setUtil(i, state.utils[i].pos, UtilState::HELD);
+			logEvent(EventType::TRAP_OBTAINED, i, state.utils[i].pos);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool MoxySim::hitGateOrKey(const int cell)
+{
+	// Shared by everything that lands the player on a square without them choosing to walk there
+	// (knockback, magnet pull). A gate without a key stays shut, but the player still ends up where they were put.
+	if (occupancy.gates.test(cell))
+	{
+		if (state.player.heldKeys > 0)
+		{
+			hitImmobileObjectAndDelete(level.gates, state.gates, occupancy.gates, cell);
+			state.player.heldKeys--;
+		}
+		else
+		{
+			message = Message::KEY_NEEDED;
+		}
+		return true;
+	}
+	else if (hitImmobileObjectAndDelete(level.keys, state.keys, occupancy.keys, cell))
+	{
+		state.player.heldKeys++;
+		message = Message::KEY_OBTAINED;
+		return true;
+	}
+	return false;
+}
+
+MoxySim::simPatrolSchedule MoxySim::buildPatrolSchedule(const simPatrollerDef &def)
+{
+	// Step the patroller forward until it's somewhere it has already been (same square, same facing).
+	// From there on it repeats itself, so that's where the loop starts.
+	simPatrolSchedule schedule;
+	simPatroller current{ def.initial, def.facingInitial };
+
+	while (int(schedule.steps.size()) < patrolScheduleMaxLength)
+	{
+		const int seen = findPatrolStep(schedule, current);
+		if (seen >= 0)
+		{
+			schedule.loopStart = seen;
+			return schedule;
+		}
+		schedule.steps.push_back(current);
+		current = patrolStep(def, current);
+	}
+	return simPatrolSchedule();
+}
+
+int MoxySim::findPatrolStep(const simPatrolSchedule &schedule, const simPatroller &patroller)
+{
+	const int numSteps = schedule.steps.size();
+	for (int i = 0; i < numSteps; i++)
+	{
+		if (schedule.steps[i].pos == patroller.pos && schedule.steps[i].facing == patroller.facing)
+			return i;
+	}
+	return -1;
+}
+
+void MoxySim::buildPatrolSchedules()
+{
+	pusherTrack.schedules.clear();
+	suckerTrack.schedules.clear();
+	for (const auto& def : level.pushers)
+		pusherTrack.schedules.emplace_back(buildPatrolSchedule(def));
+	for (const auto& def : level.suckers)
+		suckerTrack.schedules.emplace_back(buildPatrolSchedule(def));
+
+	// The level's patrol period is the LCM of every patroller's loop. Past a point it's no use to anyone
+	// (nothing looks that far ahead), so rather than overflow we call it "no period".
+	const long long periodMax = 1 << 20;
+	long long period = 1;
+	int periodStart = 0;
+	for (const patrolTrack* track : { &pusherTrack, &suckerTrack })
+	{
+		for (const auto& schedule : track->schedules)
+		{
+			if (schedule.steps.empty() || period == 0)
+			{
+				period = 0;
+				continue;
+			}
+			long long a = period;
+			long long b = schedule.loopLength();
+			while (b != 0)
+			{
+				const long long r = a % b;
+				a = b;
+				b = r;
+			}
+			period = (period / a) * schedule.loopLength();
+			if (period > periodMax)
+				period = 0;
+			if (schedule.loopStart > periodStart)
+				periodStart = schedule.loopStart;
+		}
+	}
+	patrolPeriod = int(period);
+	patrolPeriodStart = period == 0 ? 0 : periodStart;
+}
+
+void MoxySim::resyncPatrolSteps()
+{
+	const auto resync = [](patrolTrack &track, const std::vector<simPatroller> &patrollers) {
+		const int numPatrollers = patrollers.size();
+		track.steps.assign(numPatrollers, -1);
+		for (int i = 0; i < numPatrollers; i++)
+			track.steps[i] = findPatrolStep(track.schedules[i], patrollers[i]);
+	};
+	resync(pusherTrack, state.pushers);
+	resync(suckerTrack, state.suckers);
+}
+
+void MoxySim::knockbackPlayerTo(const simPoint &pos)
+{
+	// Knockback into the edge of the grid doesn't go anywhere, so there's nothing to report.
+	if (pos == state.player.pos)
+		return;
+	state.player.pos = pos;
+	logEvent(EventType::PLAYER_KNOCKED_BACK, -1, pos);
+}
+
+bool MoxySim::hitPlayer(const simPatroller &patroller) const
+{
+	return patroller.pos.y == state.player.pos.y && patroller.pos.x == state.player.pos.x;
+}
+
+bool MoxySim::suckInHitTrap(const simPatrollerDef &def, simPatroller &patroller, simLayer &layer)
+{
+	// A patroller that ends its move exactly suckRange squares in line with an active magnet trap
+	// gets pulled one square toward it. Returns true if it was pulled.
+	// Nearly every move has no magnet in range, which the mask check rules out without looking at a single trap.
+	const int cell = cellIndex(patroller.pos);
+	if (cell < 0 || !suckRangeMask(cell).intersects(occupancy.trapsSuckerActive.bits))
+		return false;
+
+	const int numUtils = state.utils.size();
+	for (int i = 0; i < numUtils; i++)
+	{
+		const simUtil& util = state.utils[i];
+
+		if (level.utils[i].type != UtilType::SUCKER || util.state != UtilState::ACTIVE)
+			continue;
+
+		if (patroller.pos.y == util.pos.y && patroller.pos.x != util.pos.x
+			&& abs(util.pos.x - patroller.pos.x) == suckRange)
+		{
+			const int stepX = (patroller.pos.x < util.pos.x ? 1 : -1) * def.movementSpeed;
+			movePatroller(patroller, simPoint{ patroller.pos.x + stepX, patroller.pos.y }, layer);
+			suckInHitCheck();
+			return true;
+		}
+		else if (patroller.pos.x == util.pos.x && patroller.pos.y != util.pos.y
+			&& abs(util.pos.y - patroller.pos.y) == suckRange)
+		{
+			const int stepY = (patroller.pos.y < util.pos.y ? 1 : -1) * def.movementSpeed;
+			movePatroller(patroller, simPoint{ patroller.pos.x, patroller.pos.y + stepY }, layer);
+			suckInHitCheck();
+			return true;
+		}
+	}
+	return false;
+}
+
+void MoxySim::suckInHitCheck()
+{
+	const int cell = cellIndex(state.player.pos);
+
+	if (occupancy.pushers.test(cell)
+		|| occupancy.suckers.test(cell))
+	{
+		return;
+	}
+	else if (hitImmobileObjectAndDelete(level.blocks, state.blocks, occupancy.blocks, cell))
+	{
+		return;
+	}
+	hitGateOrKey(cell);
+}
+
+void MoxySim::suckInRange()
+{
+	// The player gets pulled one square toward any sucker patroller they end the turn exactly suckRange squares in line with.
+	simPoint& pPos = state.player.pos;
+
+	const int cell = cellIndex(pPos);
+	if (cell < 0 || !suckRangeMask(cell).intersects(occupancy.suckers.bits))
+		return;
+
+	for (const auto& sucker : state.suckers)
+	{
+		const simPoint& sPos = sucker.pos;
+
+		if (pPos.y == sPos.y && pPos.x != sPos.x
+			&& abs(sPos.x - pPos.x) == suckRange)
+		{
+			pPos.x += (pPos.x < sPos.x ? 1 : -1) * playerMovementSpeed;
+		}
+		else if (pPos.x == sPos.x && pPos.y != sPos.y
+			&& abs(sPos.y - pPos.y) == suckRange)
+		{
+			pPos.y += (pPos.y < sPos.y ? 1 : -1) * playerMovementSpeed;
+		}
+		else
+			continue;
+
+		logEvent(EventType::PLAYER_PULLED, -1, pPos);
+		suckInHitCheck();
+		hazardHitCheck();
+		teleportHitCheck();
+		return;
+	}
+}
+
+void MoxySim::hazardHitCheck()
+{
+	// Hazards are instant level-ending penalty if you land on them.
+	// This gives a reason in design for player to be more careful about how far they are getting pushed
+	// by pushers. Pushed two squares could get them past a hazard. Pushed one square right into it.
+	// (expands on what kind of challenges you can present in level design, in other words)
+	if (occupancy.hazards.test(cellIndex(state.player.pos)))
+	{
+		state.turnsRemaining = 0;
+		logEvent(EventType::HAZARD_HIT, -1, state.player.pos);
+	}
+}
+
+void MoxySim::teleportHitCheck()
+{
+	// There should only ever be two teleports on the grid.
+	// With this expected, when player lands on a teleport square,
+	// we can move player to whichever teleport square they are NOT on.
+	// This enables the possibility in design of getting the player across the board a little faster,
+	// rather than always having to walk long distances.
+	if (level.teleports.size() < 2 || !occupancy.teleports.test(cellIndex(state.player.pos)))
+		return;
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (state.player.pos.x == level.teleports[i].initial.x && state.player.pos.y == level.teleports[i].initial.y)
+		{
+			state.player.pos = level.teleports[1 - i].initial;
+			message = Message::TELEPORT;
+			logEvent(EventType::PLAYER_TELEPORTED, -1, state.player.pos);
+			return;
+		}
+	}
+}
+
+int MoxySim::clampX(const int x)
+{
+	// Knockback can't push anything off the grid, it stops at the edge square instead.
+	if (x < 0)
+		return 0;
+	else if (x > gridRowSize - 1)
+		return gridRowSize - 1;
+	return x;
+}
+
+int MoxySim::clampY(const int y)
+{
+	if (y < 0)
+		return 0;
+	else if (y > gridColSize - 1)
+		return gridColSize - 1;
+	return y;
+}
@@ -0,0 +1,527 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include <type_traits>
+
+// MoxySim is the game-state engine for Moxybox. It owns positions, facings, token states and inventory
+// for a single level and resolves turns exactly as the game plays them, without touching Qt at all.
+// GameplayScreen is a view on top of it: it feeds player input in, then syncs its scene items from the
+// engine state after each turn. Because nothing here needs a QGraphicsScene, the same rules can be run
+// headless, as fast as the CPU allows, by tests, tools and solvers.
+class MoxySim
+{
+public:
+
+	// -------
+	// TOKEN
+	// -------
+	// These enums are shared with the view (GameplayScreen token structs alias them),
+	// so level data and save data can be converted to/from the engine without a translation table.
+	enum class Facing { NEUTRAL, UP, DOWN, LEFT, RIGHT, ERROR };
+	enum class PatrollerType { PUSHER, SUCKER, ERROR };
+	enum class PatrolDir { VERTICAL, HORIZONTAL, ERROR };
+	enum class ImmobileType { BLOCK, KEY, GATE, HAZARD, TELEPORT, ERROR };
+	enum class ImmobileState { ACTIVE, INVISIBLE, HELD, ERROR };
+	enum class UtilType { PUSHER, SUCKER, ERROR };
+	enum class UtilState { INACTIVE, ACTIVE, HELD, ERROR };
+
+	// What the player chose to do with their turn.
+	enum class Action { NONE, MOVE_LEFT, MOVE_RIGHT, MOVE_UP, MOVE_DOWN, PLACE_PUSHER_UTIL, PLACE_SUCKER_UTIL };
+
+	// BLOCKED means the action didn't use up the player's turn (e.g. walked into a wall),
+	// so patrollers did not move and nothing needs to be resolved.
+	enum class TurnResult { BLOCKED, PLAYING, COMPLETE, FAILED };
+
+	// Feedback for the player about what happened during a turn. The view decides how to word it.
+	enum class Message
+	{
+		NONE,
+		OBSTACLE,
+		HAZARD,
+		TELEPORT,
+		KEY_OBTAINED,
+		KEY_NEEDED,
+		TRAP_PUSHER_OBTAINED,
+		TRAP_PUSHER_DEPLOYED,
+		TRAP_SUCKER_OBTAINED,
+		TRAP_SUCKER_DEPLOYED
+	};
+
+	// What happened during a turn, in the order it happened. The view uses these to update only what a turn touched,
+	// and they double as a plain record of the turn for tools.
+	// index is into the matching list in simLevel/simState (keys, gates, blocks, utils, pushers, suckers), or -1 for the player.
+	enum class EventType
+	{
+		PLAYER_FACED, // Turned to face a new way without (yet) going anywhere.
+		PLAYER_MOVED,
+		PLAYER_KNOCKED_BACK,
+		PLAYER_PULLED,
+		PLAYER_TELEPORTED,
+		HAZARD_HIT,
+		KEY_OBTAINED,
+		GATE_OPENED,
+		BLOCK_DESTROYED,
+		TRAP_OBTAINED,
+		TRAP_DEPLOYED,
+		PUSHER_MOVED, // Moved or turned around.
+		SUCKER_MOVED
+	};
+
+	struct simPoint
+	{
+		int x;
+		int y;
+
+		bool operator==(const simPoint &other) const { return x == other.x && y == other.y; }
+		bool operator!=(const simPoint &other) const { return !(*this == other); }
+	};
+
+	struct simEvent
+	{
+		EventType type;
+		int index;
+		simPoint pos; // Where the token ended up.
+	};
+
+	// ------------
+	// LEVEL DATA
+	// ------------
+	// Static description of a level. Nothing in here changes while a level is played.
+	struct simPatrollerDef
+	{
+		simPoint initial;
+		PatrollerType type; // Informational. The engine goes by which list (pushers/suckers) a patroller is in.
+		Facing facingInitial;
+		PatrolDir patrolDir;
+		int patrolBoundUp;
+		int patrolBoundDown;
+		int patrolBoundLeft;
+		int patrolBoundRight;
+		int movementSpeed = 1;
+	};
+	struct simImmobileDef
+	{
+		simPoint initial;
+		ImmobileType type;
+	};
+	struct simUtilDef
+	{
+		simPoint initial;
+		UtilType type;
+		UtilState stateBase;
+	};
+	struct simLevel
+	{
+		int turnsInitial = 0;
+		simPoint player{ 0, 0 };
+		std::vector<simPatrollerDef> pushers;
+		std::vector<simPatrollerDef> suckers;
+		std::vector<simImmobileDef> blocks;
+		std::vector<simImmobileDef> keys;
+		std::vector<simImmobileDef> gates;
+		std::vector<simImmobileDef> hazards;
+		std::vector<simImmobileDef> teleports;
+		std::vector<simUtilDef> utils;
+	};
+
+	// ------------
+	// GAME STATE
+	// ------------
+	// Everything that can change during play. Vectors are parallel to the ones in simLevel.
+	struct simPlayer
+	{
+		simPoint pos;
+		Facing facing = Facing::NEUTRAL;
+		int heldKeys = 0;
+		std::vector<int> heldUtilPushIndex;
+		std::vector<int> heldUtilSuckIndex;
+	};
+	struct simPatroller
+	{
+		simPoint pos;
+		Facing facing;
+	};
+	struct simUtil
+	{
+		simPoint pos;
+		UtilState state;
+	};
+	struct simState
+	{
+		int turnsRemaining = 0;
+		simPlayer player;
+		std::vector<simPatroller> pushers;
+		std::vector<simPatroller> suckers;
+		std::vector<ImmobileState> blocks;
+		std::vector<ImmobileState> keys;
+		std::vector<ImmobileState> gates;
+		std::vector<ImmobileState> hazards;
+		std::vector<ImmobileState> teleports;
+		std::vector<simUtil> utils;
+	};
+
+	// ------
+	// GRID
+	// ------
+	// Positions are grid squares: x is the column (0 is the left edge), y is the row (0 is the top edge).
+	// The engine never deals in pixels. Where a square ends up on screen is the view's business.
+	static const int gridRowSize = 20;
+	static const int gridColSize = 10;
+	static const int gridCellCount = gridRowSize * gridColSize;
+
+	// -----------
+	// OCCUPANCY
+	// -----------
+	// The whole grid is 200 squares, so one bit per square fits in four 64-bit words.
+	// Each kind of token gets its own layer, kept up to date as tokens move or change state,
+	// so "is there a gate here?" is a single bit test rather than a scan over every gate in the level.
+	// Layers are a cache derived from simState. They are rebuilt on load/reset/setState and patched on every change after that.
+	struct simBitboard
+	{
+		static const int wordCount = (gridCellCount + 63) / 64;
+		uint64_t words[wordCount] = {};
+
+		bool test(const int cell) const { return (words[cell >> 6] >> (cell & 63)) & 1; }
+		void set(const int cell) { words[cell >> 6] |= uint64_t(1) << (cell & 63); }
+		void clear(const int cell) { words[cell >> 6] &= ~(uint64_t(1) << (cell & 63)); }
+
+		bool intersects(const simBitboard &other) const
+		{
+			uint64_t any = 0;
+			for (int i = 0; i < wordCount; i++)
+				any |= words[i] & other.words[i];
+			return any != 0;
+		}
+	};
+
+	// Tokens can share a square (e.g. two patrollers crossing paths, two traps placed on the same spot),
+	// so each layer counts how many of its tokens are on a square and only clears the bit when the last one leaves.
+	// Squares off the grid (cell -1) are never occupied.
+	struct simLayer
+	{
+		simBitboard bits;
+		uint8_t count[gridCellCount] = {};
+
+		bool test(const int cell) const { return cell >= 0 && bits.test(cell); }
+		void add(const int cell) { if (cell >= 0 && count[cell]++ == 0) bits.set(cell); }
+		void remove(const int cell) { if (cell >= 0 && --count[cell] == 0) bits.clear(cell); }
+	};
+
+	struct simOccupancy
+	{
+		simLayer blocks;
+		simLayer gates;
+		simLayer keys;
+		simLayer hazards;
+		simLayer teleports;
+		simLayer pushers;
+		simLayer suckers;
+		simLayer utils; // Traps lying on the grid that the player can pick up (anything not HELD).
+		simLayer trapsPusherActive;
+		simLayer trapsSuckerActive;
+	};
+
+	// Returns the grid square a position is in, or -1 if it's off the grid.
+	static int cellIndex(const simPoint &pos);
+
+	// ------------
+	// DIRECTIONS
+	// ------------
+	// One row per Facing (in enum order), so anything that needs to know which way is which can look it up
+	// instead of switching on Facing. NEUTRAL and ERROR don't go anywhere and aren't on a patrol axis.
+	struct simDirection
+	{
+		int dx;
+		int dy;
+		Facing opposite;
+		PatrolDir axis;
+		int simPatrollerDef::*leash; // The patrol bound that stops a patroller heading this way.
+	};
+	static constexpr simDirection directions[] =
+	{
+		{ 0, 0, Facing::NEUTRAL, PatrolDir::ERROR, nullptr },
+		{ 0, -1, Facing::DOWN, PatrolDir::VERTICAL, &simPatrollerDef::patrolBoundUp },
+		{ 0, 1, Facing::UP, PatrolDir::VERTICAL, &simPatrollerDef::patrolBoundDown },
+		{ -1, 0, Facing::RIGHT, PatrolDir::HORIZONTAL, &simPatrollerDef::patrolBoundLeft },
+		{ 1, 0, Facing::LEFT, PatrolDir::HORIZONTAL, &simPatrollerDef::patrolBoundRight },
+		{ 0, 0, Facing::ERROR, PatrolDir::ERROR, nullptr },
+	};
+	template<Facing dir>
+	static constexpr simDirection direction() { return directions[static_cast<int>(dir)]; }
+
+	// ------------------
+	// PATROL SCHEDULES
+	// ------------------
+	// Left alone, a patroller's movement depends on nothing but its own level data: it bounces back and forth
+	// inside its leash forever. So on load we walk each patroller through its patrol once and keep every step in a table.
+	// steps[0] is the initial position/facing. From loopStart onward the steps repeat every loopLength() turns.
+	// (loopStart is 0 for any sane patrol. Only odd level data, e.g. a movementSpeed that overshoots the leash, has a lead-in.)
+	// An empty table means the patrol didn't settle into a loop within patrolScheduleMaxLength steps, and it's always simulated step by step.
+	struct simPatrolSchedule
+	{
+		std::vector<simPatroller> steps;
+		int loopStart = 0;
+
+		int loopLength() const { return steps.size() - loopStart; }
+		int next(const int step) const { return step + 1 < int(steps.size()) ? step + 1 : loopStart; }
+
+		// The step next() came from, which is only one step unless it's loopStart after a lead-in (from both the lead-in and the loop's end).
+		bool hasPrevious(const int step) const { return step != loopStart || loopStart == 0; }
+		int previous(const int step) const { return step > 0 ? step - 1 : int(steps.size()) - 1; }
+
+		// Where the patroller is after the given number of patroller turns, if nothing has disturbed it.
+		const simPatroller& at(const int turn) const
+		{
+			if (turn < int(steps.size()))
+				return steps[turn];
+			return steps[loopStart + ((turn - loopStart) % loopLength())];
+		}
+	};
+	static const int patrolScheduleMaxLength = 1024;
+
+	// ---------
+	// HISTORY
+	// ---------
+	// Every turn leaves behind a list of exactly what it changed, each with its before and after value,
+	// so undo/redo put back only those things rather than rebuilding the level. A typical turn is a player delta,
+	// a turns delta and a PATROLLERS_ADVANCED delta, at 16 bytes each. That last one covers every patroller that took its plain patrol step,
+	// which undo/redo can work out again from the schedule (or, off it, from the patroller's level data).
+	// A patroller only gets a delta of its own on a turn it turns around off its schedule, or a trap or magnet moves it.
+	// Positions are packed into 32 bits (16 per axis). Facings and token states go in the tags nibbles.
+	enum class DeltaType : uint8_t
+	{
+		PLAYER, // Position and facing.
+		PLAYER_KEYS,
+		TURNS_REMAINING,
+		HELD_PUSH_ADDED, // Util index added to the back of heldUtilPushIndex.
+		HELD_PUSH_PLACED, // Util index taken off the front of heldUtilPushIndex.
+		HELD_SUCK_ADDED,
+		HELD_SUCK_PLACED,
+		BLOCK,
+		KEY,
+		GATE,
+		UTIL, // Position and state.
+		PUSHER, // Position, facing and schedule step.
+		SUCKER,
+		PATROLLERS_ADVANCED // Patrollers that took the next step of their schedule, or went straight ahead off it. A bit each: pushers in before, suckers in after.
+	};
+	struct simDelta
+	{
+		int16_t index;
+		int16_t stepBefore;
+		int16_t stepAfter;
+		DeltaType type;
+		uint8_t tags; // Before in the low four bits, after in the high four.
+		int32_t before;
+		int32_t after;
+	};
+
+	static const int playerMovementSpeed = 1; // This only checks collision for square landed on, so keep this in mind if changing it (it could break level design)
+	static const int playerKnockbackAmount = 2; // Be careful about what this is set to. Collision detection runs for each square pushed back
+	static const int trapKnockbackAmount = 2;
+	static const int suckRange = 2;
+
+	MoxySim() = default;
+	explicit MoxySim(const simLevel &newLevel);
+
+	void load(const simLevel &newLevel);
+	void reset();
+	TurnResult playerTurn(const Action action);
+	bool allGatesOpened() const;
+
+	const simLevel& getLevel() const { return level; }
+	const simState& getState() const { return state; }
+	const simOccupancy& getOccupancy() const { return occupancy; }
+	const std::vector<simPatrolSchedule>& getPusherSchedules() const { return pusherTrack.schedules; }
+	const std::vector<simPatrolSchedule>& getSuckerSchedules() const { return suckerTrack.schedules; }
+
+	// Every undisturbed patroller in the level is back where it started patrolPeriod turns later (the LCM of all their loops),
+	// from patrolPeriodStart onward. 0 if there's no such period (a patroller without a schedule, or an LCM too large to be useful).
+	int getPatrolPeriod() const { return patrolPeriod; }
+	int getPatrolPeriodStart() const { return patrolPeriodStart; }
+
+	// Where a patroller is a turn later if nothing (trap, magnet) gets in its way. Schedules are built from this.
+	static simPatroller patrolStep(const simPatrollerDef &def, const simPatroller &patroller);
+
+	// For restoring a saved game. Gameplay should go through playerTurn.
+	void setState(const simState &newState);
+
+	// A compact, fixed-size copy of the state, for tools that keep huge numbers of states around (solvers, caches).
+	// Every state of the loaded level packs to getPackedSize() bytes. unpackState is setState without the allocations.
+	// Hazards and teleports never change during play, so they aren't packed.
+	int getPackedSize() const;
+	void packState(uint8_t *out) const;
+	void unpackState(const uint8_t *in);
+
+	// Message from the most recent call to playerTurn (last one written wins, like a text box would).
+	Message getMessage() const { return message; }
+
+	// Events from the most recent call to playerTurn, undo or redo. Empty after load/reset/setState, where everything should be treated as changed.
+	// Undo/redo report each token they put back with the event type for that token (e.g. KEY_OBTAINED for a key, PLAYER_MOVED for the player),
+	// so the view can sync from them the same way it does after a turn.
+	const std::vector<simEvent>& getEvents() const { return events; }
+
+	// Steps back/forward one turn. Returns false if there's nothing to undo/redo.
+	// History is cleared on load/reset/setState, and taking a turn after an undo drops anything that could have been redone.
+	bool undo();
+	bool redo();
+	bool canUndo() const { return historyCursor > 0; }
+	bool canRedo() const { return historyCursor < int(historyTurns.size()); }
+	// How many turns undo can step back through. A turn that changed nothing doesn't add one,
+	// so a search that keeps history along its path can tell whether an action did anything.
+	int getUndoSteps() const { return historyCursor; }
+
+	// 64-bit Zobrist hash of the whole game state: player square/facing, held keys, turns remaining, held traps (in order),
+	// every patroller's square and facing, and the state of every key, gate, block and trap.
+	// Two equal states always have equal hashes, for any MoxySim that has the same level loaded, in any run of the program.
+	// It's kept up to date as the state changes (every delta a turn records XORs its before value out and its after value in),
+	// so reading it is free. Patrol schedule steps aren't part of it, since they follow from where patrollers are.
+	uint64_t getHash() const { return stateHash; }
+
+	// The same hash with turns remaining left out, for search tools that treat two states
+	// that differ only in turns remaining as the same position (the one with more turns left is never worse off).
+	uint64_t getHashIgnoringTurns() const { return stateHash ^ zobrist(DeltaType::TURNS_REMAINING, -1, uint32_t(state.turnsRemaining)); }
+
+	// 64-bit hash of what a level is, for keeping things worked out about it (e.g. its par) and knowing them again later.
+	// Everything that plays a part in playing it goes in: turns, the player's start, every patroller's def and teleport in order,
+	// and where every key, gate, block, hazard and trap starts. Only the order of those last few lists is left out,
+	// since the engine only ever goes by what's on a square, so the same level saved with its tokens in another order hashes the same.
+	static uint64_t getLevelHash(const simLevel &level);
+
+	// splitmix64's finalizer: spreads any 64-bit value evenly over all 64 bits, the same in every run. A bijection, so different
+	// values never come out the same. Zobrist keys and level hashes are made with it, and tools can use it to seed their own generators.
+	static uint64_t splitMix(uint64_t z)
+	{
+		z += 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// Headless users that never undo (e.g. a solver exploring millions of turns) can turn history off so it doesn't grow.
+	void setHistoryEnabled(const bool enabled);
+	size_t getHistoryBytes() const { return (history.size() * sizeof(simDelta)) + (historyTurns.size() * sizeof(int)); }
+	int getHistoryTurns() const { return historyTurns.size(); }
+
+private:
+	simLevel level;
+	simState state;
+	simOccupancy occupancy;
+	Message message = Message::NONE;
+	std::vector<simEvent> events;
+
+	// Schedules are built on load. Each patroller's step is where it is in its schedule, or -1 once a trap or magnet
+	// has knocked it somewhere its schedule never goes, after which it's simulated step by step.
+	// Like occupancy, steps are derived from simState and re-found on setState.
+	struct patrolTrack
+	{
+		std::vector<simPatrolSchedule> schedules;
+		std::vector<int> steps;
+	};
+	patrolTrack pusherTrack;
+	patrolTrack suckerTrack;
+	int patrolPeriod = 0;
+	int patrolPeriodStart = 0;
+
+	// history holds every recorded turn's deltas back to back, historyTurns where each turn's deltas start.
+	// Turns before historyCursor can be undone, turns from it on can be redone.
+	// The turn being played appends its deltas to the end of history as it goes (after anything that could be redone),
+	// from turnStart on. They only become a turn of history once the turn is over, and only if it changed something.
+	std::vector<simDelta> history;
+	std::vector<int> historyTurns;
+	int historyCursor = 0;
+	int turnStart = 0;
+	bool historyEnabled = true;
+
+	TurnResult resolveTurn(const Action action);
+	void clearHistory();
+	void commitTurnHistory();
+	uint64_t stateHash = 0;
+
+	// Every change a turn makes goes through here, so the hash can't miss one.
+	void recordDelta(const simDelta &delta)
+	{
+		stateHash ^= deltaHash(delta);
+		if (historyEnabled)
+			history.emplace_back(delta);
+	}
+	static uint64_t zobrist(const DeltaType type, const int index, const uint64_t value);
+	static uint64_t zobristTagged(const DeltaType type, const int index, const int32_t value, const int tag) { return zobrist(type, index, uint32_t(value) | (uint64_t(tag) << 32)); }
+	static uint64_t deltaHash(const simDelta &delta);
+	static uint64_t heldHash(const std::vector<int> &held, const DeltaType type);
+	static uint64_t patrollerHash(const DeltaType type, const int index, const simPatroller &patroller) { return zobristTagged(type, index, packPoint(patroller.pos), int(patroller.facing)); }
+	uint64_t computeHash() const;
+	void journalPatroller(const DeltaType type, const int index, const simPatroller &before, const int stepBefore, const simPatroller &after, const int stepAfter);
+	void applyDelta(const simDelta &delta, const bool forward);
+	static int32_t packPoint(const simPoint &pos) { return int32_t(uint32_t(uint16_t(pos.x)) | (uint32_t(uint16_t(pos.y)) << 16)); }
+	static simPoint unpackPoint(const int32_t packed) { return simPoint{ int16_t(uint32_t(packed) & 0xFFFF), int16_t(uint32_t(packed) >> 16) }; }
+	static uint8_t packTags(const int before, const int after) { return uint8_t((before & 0xF) | ((after & 0xF) << 4)); }
+
+	void buildPatrolSchedules();
+	void resyncPatrolSteps();
+	static simPatrolSchedule buildPatrolSchedule(const simPatrollerDef &def);
+	template<Facing dir>
+	static simPatroller patrolStepToward(const simPatrollerDef &def, const simPatroller &patroller);
+	static int findPatrolStep(const simPatrolSchedule &schedule, const simPatroller &patroller);
+
+	void rebuildOccupancy();
+	void logEvent(const EventType type, const int index, const simPoint &pos) { events.emplace_back(simEvent{ type, index, pos }); }
+	void setImmobileState(const simImmobileDef &def, ImmobileState &current, const ImmobileState newState, simLayer &layer);
+	void setUtil(const int utilNum, const simPoint &newPos, const UtilState newState);
+	void movePatroller(simPatroller &patroller, const simPoint &newPos, simLayer &layer);
+	void stepPatrollers(const DeltaType type, const uint32_t advanced, const std::vector<simPatrollerDef> &defs, std::vector<simPatroller> &patrollers, simLayer &layer, patrolTrack &track, const bool forward);
+	static bool immobileInLayer(const simImmobileDef &def, const ImmobileState state);
+	static const simBitboard& suckRangeMask(const int cell);
+
+	// Calls kernel with the facing as a compile-time constant (std::integral_constant), so it can pick a direction-specialized kernel.
+	template<typename Kernel>
+	static auto withDirection(const Facing facing, Kernel &&kernel) -> decltype(kernel(std::integral_constant<Facing, Facing::NEUTRAL>()));
+	template<Facing dir>
+	static simPoint stepClamped(const simPoint &pos, const int amount);
+
+	bool playerMove(const Facing facing);
+	template<Facing dir>
+	bool playerMoveToward();
+	bool playerPlaceUtil(std::vector<int> &heldIndex, const Message deployedMessage);
+	template<Facing dir>
+	bool hitSolidObjectPlayerMoving(bool &turnUsed);
+	bool hitImmobileObjectAndDelete(const std::vector<simImmobileDef> &defs, std::vector<ImmobileState> &states, simLayer &layer, const int cell);
+	bool hitUtil(const int cell);
+	bool hitGateOrKey(const int cell);
+	void knockbackPlayerMoving();
+	template<Facing dir>
+	void knockbackPlayerMoving();
+	void updatePositionPatrollers();
+	template<PatrollerType type>
+	void updatePositionPatrollerMoves(const simPatrollerDef &def, simPatroller &patroller, simLayer &layer, patrolTrack &track, const int enemyNum);
+	template<Facing dir>
+	void knockbackEnemyMoving();
+	template<Facing dir, PatrollerType type>
+	void knockbackHitTrap(const simPatrollerDef &def, simPatroller &patroller, simLayer &layer);
+	void knockbackPlayerTo(const simPoint &pos);
+	bool hitPlayer(const simPatroller &patroller) const;
+	bool suckInHitTrap(const simPatrollerDef &def, simPatroller &patroller, simLayer &layer);
+	void suckInHitCheck();
+	void suckInRange();
+	void hazardHitCheck();
+	void teleportHitCheck();
+
+	static int clampX(const int x);
+	static int clampY(const int y);
+};
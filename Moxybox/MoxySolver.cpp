@@ -0,0 +1,969 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxySolver.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+const MoxySim::Action MoxySolver::actionsAll[6] =
+{
+	MoxySim::Action::MOVE_LEFT,
+	MoxySim::Action::MOVE_RIGHT,
+	MoxySim::Action::MOVE_UP,
+	MoxySim::Action::MOVE_DOWN,
+	MoxySim::Action::PLACE_PUSHER_UTIL,
+	MoxySim::Action::PLACE_SUCKER_UTIL
+};
+
+MoxySolver::solveOutcome MoxySolver::solve(const MoxySim::simLevel &level, const solveLimits &limits)
+{
+	return solve(level, MoxySim(level).getState(), limits);
+}
+
+MoxySolver::solveOutcome MoxySolver::solve(const MoxySim::simLevel &level, const MoxySim::simState &from, const solveLimits &limits)
+{
+	// Cost is turns taken. Most actions take a turn, but one that's blocked can still turn the player to face a new way,
+	// which matters (a trap knocking a pusher into the player sends them back the way they're facing) and costs nothing.
+	// So it's a 0-1 breadth-first search: free actions go on the front of the frontier, turns on the back,
+	// and states come off in order of turns taken. The first win found is as short as a win gets.
+	//
+	// Two states in the same position, one with more turns remaining, aren't worth exploring twice:
+	// the one with more turns left can do anything the other can. So states are deduplicated on their hash ignoring turns remaining,
+	// and a position is only revisited if a path arrives with more turns left than any before it.
+	//
+	// States are expanded with undo rather than copies. Unpack once, then try each action and step back.
+	// New states distanceHeuristic can prove lost are dropped, which mostly pays off in proving a level can't be won.
+
+	const auto start = std::chrono::steady_clock::now();
+	solveOutcome outcome;
+
+	MoxySim sim(level);
+	sim.setState(from);
+	const int packedSize = sim.getPackedSize();
+	std::vector<uint8_t> arena;
+	std::vector<searchNode> nodes;
+	std::deque<int> frontier;
+	visitedTable visited;
+	const distanceHeuristic lostCheck(level);
+
+	const auto keep = [&](const int parent, const int turnsUsed, const MoxySim::Action action) {
+		nodes.emplace_back(searchNode{ parent, turnsUsed, action });
+		arena.resize(arena.size() + packedSize);
+		sim.packState(&arena[arena.size() - packedSize]);
+		return int(nodes.size()) - 1;
+	};
+
+	visited.improve(sim.getHashIgnoringTurns(), sim.getState().turnsRemaining);
+	frontier.push_back(keep(-1, 0, MoxySim::Action::NONE));
+
+	int solvedNode = -1;
+	bool limitReached = false;
+	bool cancelled = false;
+	size_t frontierPeak = 0;
+	while (!frontier.empty() && solvedNode < 0)
+	{
+		if (limits.cancel != nullptr && limits.cancel->load(std::memory_order_relaxed))
+		{
+			cancelled = true;
+			break;
+		}
+
+		frontierPeak = std::max(frontierPeak, frontier.size());
+		const int current = frontier.front();
+		frontier.pop_front();
+
+		sim.unpackState(&arena[size_t(current) * packedSize]);
+
+		// A better path (more turns left) got here after this one was queued, so that one gets expanded instead.
+		if (visited.best(sim.getHashIgnoringTurns()) > sim.getState().turnsRemaining)
+			continue;
+
+		outcome.stats.expanded++;
+		const int turnsUsed = nodes[current].turnsUsed;
+
+		for (const MoxySim::Action action : actionsAll)
+		{
+			const MoxySim::TurnResult result = sim.playerTurn(action);
+
+			// Nothing changed (e.g. walked into a wall already facing it), so there's nothing to undo either.
+			if (!sim.canUndo())
+				continue;
+
+			if (result == MoxySim::TurnResult::COMPLETE)
+			{
+				solvedNode = keep(current, turnsUsed + 1, action);
+				break;
+			}
+			else if (result != MoxySim::TurnResult::FAILED && visited.improve(sim.getHashIgnoringTurns(), sim.getState().turnsRemaining)
+				&& !lostCheck.isLost(sim.getState()))
+			{
+				if (int(nodes.size()) >= limits.maxStates)
+				{
+					limitReached = true;
+				}
+				else if (result == MoxySim::TurnResult::BLOCKED)
+				{
+					frontier.push_front(keep(current, turnsUsed, action));
+				}
+				else
+				{
+					frontier.push_back(keep(current, turnsUsed + 1, action));
+				}
+			}
+			sim.undo();
+		}
+		if (limitReached)
+			break;
+	}
+
+	if (solvedNode >= 0)
+	{
+		outcome.result = Result::SOLVED;
+		outcome.turnsUsed = nodes[solvedNode].turnsUsed;
+		for (int node = solvedNode; nodes[node].parent >= 0; node = nodes[node].parent)
+			outcome.actions.push_back(nodes[node].action);
+		std::reverse(outcome.actions.begin(), outcome.actions.end());
+	}
+	else if (cancelled)
+	{
+		outcome.result = Result::CANCELLED;
+	}
+	else if (limitReached)
+	{
+		outcome.result = Result::LIMIT_REACHED;
+	}
+	else
+	{
+		outcome.result = Result::UNSOLVABLE;
+	}
+
+	outcome.stats.generated = nodes.size();
+	outcome.stats.peakMemory = arena.capacity() + (nodes.capacity() * sizeof(searchNode)) + visited.memoryBytes() + (frontierPeak * sizeof(int));
+	outcome.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return outcome;
+}
+
+MoxySolver::solveOutcome MoxySolver::solveParallel(const MoxySim::simLevel &level, const solveLimits &limits, const int threadCount)
+{
+	// The sequential search takes states one at a time off a single frontier, which can't be shared out.
+	// Here the search goes in rounds instead. Every state in a round has taken the same number of turns,
+	// and all of them are expanded at once, by all the threads. Children that took no turn (blocked, only turned the player)
+	// make up the next round. Once a round has none of those, the children that took a turn make up the round after.
+	// So states still come out in order of turns taken, and the first round with a win has a shortest one.
+	//
+	// Duplicates are settled through a lock-free MoxyStateTable as they're found, smallest link winning ties,
+	// so which children survive doesn't depend on timing. Between rounds the survivors are sorted by link before they're kept,
+	// so node numbers, and from them every later tie, come out the same however many threads there are.
+
+	const auto start = std::chrono::steady_clock::now();
+	solveOutcome outcome;
+
+	struct candidate
+	{
+		uint64_t hash;
+		uint64_t link;
+		size_t offset;
+	};
+	struct workerContext
+	{
+		MoxySim sim;
+		std::vector<candidate> sameTurn; // Children that took no turn, for the next round.
+		std::vector<candidate> nextTurn; // Children that took a turn, waiting for this turn's rounds to run out.
+		std::vector<uint8_t> sameTurnBytes;
+		std::vector<uint8_t> nextTurnBytes;
+		uint64_t completeLink = UINT64_MAX;
+		long long expanded = 0;
+
+		explicit workerContext(const MoxySim::simLevel &level) : sim(level) {}
+	};
+
+	workerPool pool(std::max(1, threadCount));
+	const int threads = pool.size();
+	std::vector<std::unique_ptr<workerContext>> contexts;
+	std::unique_ptr<workDeque[]> deques(new workDeque[threads]);
+	for (int i = 0; i < threads; i++)
+		contexts.emplace_back(new workerContext(level));
+
+	const int packedSize = contexts[0]->sim.getPackedSize();
+	std::vector<uint8_t> arena(packedSize);
+	std::vector<searchNode> nodes;
+	MoxyStateTable table(limits.tableMemory);
+	std::atomic<bool> tableFull(false);
+
+	contexts[0]->sim.packState(arena.data());
+	nodes.emplace_back(searchNode{ -1, 0, MoxySim::Action::NONE });
+	table.offer(contexts[0]->sim.getHashIgnoringTurns(), contexts[0]->sim.getState().turnsRemaining, 0);
+
+	std::vector<int> round(1, 0);
+	const auto isCancelled = [&]() { return limits.cancel != nullptr && limits.cancel->load(std::memory_order_relaxed); };
+
+	const auto expand = [&](workerContext &ctx, const int node) {
+		MoxySim &sim = ctx.sim;
+		sim.unpackState(&arena[size_t(node) * packedSize]);
+		ctx.expanded++;
+
+		for (int actionIndex = 0; actionIndex < 6; actionIndex++)
+		{
+			const MoxySim::TurnResult result = sim.playerTurn(actionsAll[actionIndex]);
+			if (!sim.canUndo())
+				continue;
+
+			const uint64_t link = makeLink(node, actionIndex);
+			if (result == MoxySim::TurnResult::COMPLETE)
+			{
+				// Later actions from this node have bigger links, so they can't win. Unpacking the next node clears up after us.
+				ctx.completeLink = std::min(ctx.completeLink, link);
+				break;
+			}
+			const MoxyStateTable::OfferResult offer = result == MoxySim::TurnResult::FAILED ? MoxyStateTable::OfferResult::WORSE :
+				table.offer(sim.getHashIgnoringTurns(), sim.getState().turnsRemaining, link);
+			if (offer == MoxyStateTable::OfferResult::FULL)
+			{
+				tableFull = true;
+			}
+			else if (offer == MoxyStateTable::OfferResult::STORED)
+			{
+				const bool tookTurn = result != MoxySim::TurnResult::BLOCKED;
+				std::vector<candidate> &list = tookTurn ? ctx.nextTurn : ctx.sameTurn;
+				std::vector<uint8_t> &bytes = tookTurn ? ctx.nextTurnBytes : ctx.sameTurnBytes;
+				list.emplace_back(candidate{ sim.getHashIgnoringTurns(), link, bytes.size() });
+				bytes.resize(bytes.size() + packedSize);
+				sim.packState(&bytes[bytes.size() - packedSize]);
+			}
+			sim.undo();
+		}
+	};
+
+	// Keeps the candidates that are still the table's choice for their state, in link order, and puts their node numbers in kept.
+	// False if that would go over the state limit.
+	const auto keepWinners = [&](const bool tookTurn, std::vector<int> &kept) {
+		pool.run([&](const int threadIndex) {
+			std::vector<candidate> &list = tookTurn ? contexts[threadIndex]->nextTurn : contexts[threadIndex]->sameTurn;
+			list.erase(std::remove_if(list.begin(), list.end(), [&](const candidate &c) {
+				int turnsRemaining;
+				uint64_t link;
+				return !table.find(c.hash, turnsRemaining, link) || link != c.link;
+			}), list.end());
+		});
+
+		struct winner
+		{
+			uint64_t link;
+			int thread;
+			size_t offset;
+		};
+		std::vector<winner> winners;
+		for (int t = 0; t < threads; t++)
+		{
+			for (const auto& c : tookTurn ? contexts[t]->nextTurn : contexts[t]->sameTurn)
+				winners.emplace_back(winner{ c.link, t, c.offset });
+		}
+		std::sort(winners.begin(), winners.end(), [](const winner &a, const winner &b) { return a.link < b.link; });
+
+		kept.clear();
+		const bool withinLimit = (long long)(nodes.size() + winners.size()) <= limits.maxStates;
+		if (withinLimit)
+		{
+			arena.resize(arena.size() + (winners.size() * packedSize));
+			for (const auto& w : winners)
+			{
+				const int parent = linkParent(w.link);
+				const std::vector<uint8_t> &bytes = tookTurn ? contexts[w.thread]->nextTurnBytes : contexts[w.thread]->sameTurnBytes;
+				std::memcpy(&arena[nodes.size() * packedSize], &bytes[w.offset], packedSize);
+				kept.push_back(int(nodes.size()));
+				nodes.emplace_back(searchNode{ parent, nodes[parent].turnsUsed + (tookTurn ? 1 : 0), actionsAll[linkAction(w.link)] });
+			}
+		}
+		for (auto& ctx : contexts)
+		{
+			(tookTurn ? ctx->nextTurn : ctx->sameTurn).clear();
+			(tookTurn ? ctx->nextTurnBytes : ctx->sameTurnBytes).clear();
+		}
+		return withinLimit;
+	};
+
+	uint64_t completeLink = UINT64_MAX;
+	bool limitReached = false;
+	bool cancelled = false;
+	while (!round.empty())
+	{
+		// Contiguous runs of the round go to each thread, in pieces small enough to steal.
+		const int rangeSize = std::max(1, std::min(64, int(round.size()) / (threads * 8)));
+		for (int begin = 0; begin < int(round.size()); begin += rangeSize)
+		{
+			const int owner = int((long long)begin * threads / round.size());
+			deques[owner].ranges.emplace_back(begin, std::min(int(round.size()), begin + rangeSize));
+		}
+
+		pool.run([&](const int threadIndex) {
+			workerContext &ctx = *contexts[threadIndex];
+			std::pair<int, int> range;
+			for (;;)
+			{
+				bool found = deques[threadIndex].take(range);
+				for (int victim = 1; !found && victim < threads; victim++)
+					found = deques[(threadIndex + victim) % threads].steal(range);
+				if (!found || isCancelled())
+					break;
+				for (int i = range.first; i < range.second; i++)
+					expand(ctx, round[i]);
+			}
+		});
+
+		// A cancelled round may not have got to the smallest win, so nothing from it counts.
+		if (isCancelled())
+		{
+			cancelled = true;
+			break;
+		}
+		for (const auto& ctx : contexts)
+			completeLink = std::min(completeLink, ctx->completeLink);
+		if (completeLink != UINT64_MAX)
+			break;
+
+		limitReached = tableFull || !keepWinners(false, round) || (round.empty() && !keepWinners(true, round));
+		if (limitReached)
+			break;
+	}
+
+	if (cancelled)
+	{
+		outcome.result = Result::CANCELLED;
+	}
+	else if (completeLink != UINT64_MAX)
+	{
+		const int parent = linkParent(completeLink);
+		outcome.result = Result::SOLVED;
+		outcome.turnsUsed = nodes[parent].turnsUsed + 1;
+		outcome.actions.push_back(actionsAll[linkAction(completeLink)]);
+		for (int node = parent; nodes[node].parent >= 0; node = nodes[node].parent)
+			outcome.actions.push_back(nodes[node].action);
+		std::reverse(outcome.actions.begin(), outcome.actions.end());
+	}
+	else if (limitReached)
+	{
+		outcome.result = Result::LIMIT_REACHED;
+	}
+	else
+	{
+		outcome.result = Result::UNSOLVABLE;
+	}
+
+	for (const auto& ctx : contexts)
+		outcome.stats.expanded += ctx->expanded;
+	outcome.stats.generated = nodes.size();
+	outcome.stats.threads = threads;
+	outcome.stats.peakMemory = arena.capacity() + (nodes.capacity() * sizeof(searchNode)) + table.memoryBytes();
+	for (const auto& ctx : contexts)
+	{
+		outcome.stats.peakMemory += ctx->sameTurnBytes.capacity() + ctx->nextTurnBytes.capacity()
+			+ ((ctx->sameTurn.capacity() + ctx->nextTurn.capacity()) * sizeof(candidate));
+	}
+	outcome.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return outcome;
+}
+
+std::vector<MoxySolver::solveOutcome> MoxySolver::solveEach(const std::vector<MoxySim::simLevel> &levels, const solveLimits &limits, const int threadCount,
+	const std::function<void(int, const solveOutcome&)> &onSolved)
+{
+	// Levels are handed out one at a time from a shared counter, so a thread that got a quick one just takes the next.
+	const int numLevels = levels.size();
+	std::vector<solveOutcome> outcomes(numLevels);
+	std::atomic<int> next(0);
+	workerPool pool(std::max(1, std::min(threadCount, numLevels)));
+	pool.run([&](int) {
+		for (int i = next++; i < numLevels; i = next++)
+		{
+			outcomes[i] = solve(levels[i], limits);
+			if (onSolved)
+				onSolved(i, outcomes[i]);
+		}
+	});
+	return outcomes;
+}
+
+// ------------------
+// ITERATIVE SEARCH
+// ------------------
+
+struct MoxySolver::iterativeSearch
+{
+	MoxySim sim;
+	distanceHeuristic heuristic;
+	MoxyStateTable table;
+	const solveLimits &limits;
+	solveStats &stats;
+
+	// The states on the way to where the search is now, for spotting a loop of turn-free actions (facing back and forth).
+	struct pathStep
+	{
+		uint64_t hash;
+		int turnsUsed;
+	};
+	std::vector<MoxySim::Action> path;
+	std::vector<pathStep> steps;
+	size_t pathPeak = 0;
+	size_t historyPeak = 0;
+	bool limitReached = false;
+	int solvedTurns = -1;
+
+	static const int found = -1;
+
+	iterativeSearch(const MoxySim::simLevel &level, const solveLimits &newLimits, solveStats &newStats)
+		: sim(level),
+		heuristic(level),
+		table(newLimits.iterativeTableMemory, MoxyStateTable::Replacement::FEWEST_TURNS),
+		limits(newLimits),
+		stats(newStats)
+	{
+	}
+
+	// Searches everything below the sim's current state within the bound. Returns found, or the smallest total (turns taken plus estimate)
+	// of anything it had to skip for being over the bound, which is the bound for the next pass.
+	int search(const int turnsUsed, const int bound);
+	bool onPath(const uint64_t hash, const int turnsUsed) const;
+};
+
+MoxySolver::solveOutcome MoxySolver::solveIterative(const MoxySim::simLevel &level, const solveLimits &limits)
+{
+	const auto start = std::chrono::steady_clock::now();
+	solveOutcome outcome;
+	iterativeSearch search(level, limits, outcome.stats);
+
+	int bound = search.heuristic.estimate(search.sim.getState());
+	while (bound < distanceHeuristic::unsolvable)
+	{
+		// Each pass starts with a clean table, since what a state was searched with last pass was a smaller bound.
+		outcome.stats.iterations++;
+		search.table.clear();
+		const uint64_t rootHash = search.sim.getHashIgnoringTurns();
+		search.table.offer(rootHash, search.sim.getState().turnsRemaining, 0);
+		search.steps.assign(1, iterativeSearch::pathStep{ rootHash, 0 });
+		search.path.clear();
+
+		const int next = search.search(0, bound);
+		if (next == iterativeSearch::found || search.limitReached)
+			break;
+		bound = next;
+	}
+
+	if (search.solvedTurns >= 0)
+	{
+		outcome.result = Result::SOLVED;
+		outcome.turnsUsed = search.solvedTurns;
+		outcome.actions = search.path;
+	}
+	else if (search.limitReached)
+	{
+		outcome.result = Result::LIMIT_REACHED;
+	}
+	else
+	{
+		outcome.result = Result::UNSOLVABLE;
+	}
+
+	outcome.stats.peakMemory = search.table.memoryBytes() + search.heuristic.memoryBytes() + search.historyPeak
+		+ (search.pathPeak * (sizeof(MoxySim::Action) + sizeof(iterativeSearch::pathStep)));
+	outcome.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return outcome;
+}
+
+int MoxySolver::iterativeSearch::search(const int turnsUsed, const int bound)
+{
+	const int estimate = heuristic.estimate(sim.getState());
+	if (estimate >= distanceHeuristic::unsolvable)
+		return distanceHeuristic::unsolvable;
+	if (turnsUsed + estimate > bound)
+		return turnsUsed + estimate;
+	if (stats.expanded >= limits.maxExpanded)
+	{
+		limitReached = true;
+		return distanceHeuristic::unsolvable;
+	}
+
+	stats.expanded++;
+	pathPeak = std::max(pathPeak, path.size());
+	historyPeak = std::max(historyPeak, sim.getHistoryBytes());
+
+	int nextBound = distanceHeuristic::unsolvable;
+	const int undoSteps = sim.getUndoSteps();
+	for (const MoxySim::Action action : actionsAll)
+	{
+		// History runs the length of the path here, so canUndo can't say whether this action changed anything, but the step count can.
+		const MoxySim::TurnResult result = sim.playerTurn(action);
+		if (sim.getUndoSteps() == undoSteps)
+			continue;
+
+		if (result == MoxySim::TurnResult::COMPLETE)
+		{
+			if (turnsUsed + 1 <= bound)
+			{
+				path.push_back(action);
+				solvedTurns = turnsUsed + 1;
+				return found;
+			}
+			nextBound = std::min(nextBound, turnsUsed + 1);
+		}
+		else if (result != MoxySim::TurnResult::FAILED)
+		{
+			// Skip a state this pass has already searched from having taken no more turns and with no fewer left,
+			// since it had at least the room to search that this has.
+			const int childTurnsUsed = turnsUsed + (result == MoxySim::TurnResult::BLOCKED ? 0 : 1);
+			const uint64_t hash = sim.getHashIgnoringTurns();
+			const int remaining = sim.getState().turnsRemaining;
+			int seenRemaining;
+			uint64_t seenTurnsUsed;
+			const bool searched = table.find(hash, seenRemaining, seenTurnsUsed) && seenRemaining >= remaining && seenTurnsUsed <= uint64_t(childTurnsUsed);
+
+			if (!searched && !onPath(hash, childTurnsUsed))
+			{
+				table.offer(hash, remaining, uint64_t(childTurnsUsed));
+				stats.generated++;
+				path.push_back(action);
+				steps.emplace_back(pathStep{ hash, childTurnsUsed });
+
+				const int childBound = search(childTurnsUsed, bound);
+				if (childBound == found)
+					return found;
+
+				path.pop_back();
+				steps.pop_back();
+				nextBound = std::min(nextBound, childBound);
+			}
+		}
+		sim.undo();
+		if (limitReached)
+			return distanceHeuristic::unsolvable;
+	}
+	return nextBound;
+}
+
+bool MoxySolver::iterativeSearch::onPath(const uint64_t hash, const int turnsUsed) const
+{
+	// Only a run of turn-free actions can come back round to the same state, so only that end of the path is checked.
+	// The table usually catches these first. This is for when the table has had to give the entry up.
+	for (auto step = steps.rbegin(); step != steps.rend() && step->turnsUsed == turnsUsed; ++step)
+	{
+		if (step->hash == hash)
+			return true;
+	}
+	return false;
+}
+
+// --------------------
+// DISTANCE HEURISTIC
+// --------------------
+
+MoxySolver::distanceHeuristic::distanceHeuristic(const MoxySim::simLevel &level)
+{
+	const int cellCount = MoxySim::gridCellCount;
+	for (const auto& key : level.keys)
+		keyCells.push_back(MoxySim::cellIndex(key.initial));
+	for (const auto& gate : level.gates)
+		gateCells.push_back(MoxySim::cellIndex(gate.initial));
+
+	// The furthest the player can be moved in a turn, not counting teleports: their own move (walking into a pusher knocks them back further),
+	// then every pusher knocking them back, twice over if a trap knocks the pusher into them, then a sucker's pull.
+	const int numPushers = level.pushers.size();
+	squaresPerTurn = (numPushers > 0 ? MoxySim::playerKnockbackAmount : MoxySim::playerMovementSpeed)
+		+ (numPushers * MoxySim::trapKnockbackAmount * MoxySim::playerKnockbackAmount)
+		+ (level.suckers.empty() ? 0 : MoxySim::playerMovementSpeed);
+
+	int teleportCells[2] = { -1, -1 };
+	if (level.teleports.size() >= 2)
+	{
+		teleportCells[0] = MoxySim::cellIndex(level.teleports[0].initial);
+		teleportCells[1] = MoxySim::cellIndex(level.teleports[1].initial);
+	}
+
+	distances.assign(size_t(cellCount) * cellCount, unreachable);
+	if (squaresPerTurn == 1)
+	{
+		std::vector<bool> solid(cellCount, false);
+		for (const auto* immobiles : { &level.blocks, &level.hazards })
+		{
+			for (const auto& immobile : *immobiles)
+			{
+				const int cell = MoxySim::cellIndex(immobile.initial);
+				if (cell >= 0)
+					solid[cell] = true;
+			}
+		}
+
+		std::vector<int> queue(cellCount);
+		for (int from = 0; from < cellCount; from++)
+		{
+			uint8_t *row = &distances[size_t(from) * cellCount];
+			int head = 0;
+			int tail = 0;
+			row[from] = 0;
+			queue[tail++] = from;
+			while (head < tail)
+			{
+				const int cell = queue[head++];
+				const int x = cell % MoxySim::gridRowSize;
+				const int y = cell / MoxySim::gridRowSize;
+				const int neighbours[4] = {
+					x > 0 ? cell - 1 : -1,
+					x < MoxySim::gridRowSize - 1 ? cell + 1 : -1,
+					y > 0 ? cell - MoxySim::gridRowSize : -1,
+					y < MoxySim::gridColSize - 1 ? cell + MoxySim::gridRowSize : -1
+				};
+				for (int next : neighbours)
+				{
+					if (next < 0 || solid[next])
+						continue;
+					// Walking onto a teleport puts the player on the other one.
+					if (next == teleportCells[0])
+						next = teleportCells[1];
+					else if (next == teleportCells[1])
+						next = teleportCells[0];
+					if (row[next] != unreachable)
+						continue;
+					row[next] = uint8_t(row[cell] + 1);
+					queue[tail++] = next;
+				}
+			}
+		}
+	}
+	else
+	{
+		const auto straight = [](const int a, const int b) {
+			return std::abs((a % MoxySim::gridRowSize) - (b % MoxySim::gridRowSize)) + std::abs((a / MoxySim::gridRowSize) - (b / MoxySim::gridRowSize));
+		};
+		for (int from = 0; from < cellCount; from++)
+		{
+			for (int to = 0; to < cellCount; to++)
+			{
+				int squares = straight(from, to);
+				if (teleportCells[0] >= 0)
+				{
+					squares = std::min(squares, straight(from, teleportCells[0]) + straight(teleportCells[1], to));
+					squares = std::min(squares, straight(from, teleportCells[1]) + straight(teleportCells[0], to));
+				}
+				distances[(size_t(from) * cellCount) + to] = uint8_t(squares);
+			}
+		}
+	}
+}
+
+int MoxySolver::distanceHeuristic::estimate(const MoxySim::simState &state) const
+{
+	int gatesShut = 0;
+	for (const auto& gate : state.gates)
+	{
+		if (gate == MoxySim::ImmobileState::ACTIVE)
+			gatesShut++;
+	}
+	if (gatesShut == 0)
+		return 0;
+
+	int keysLeft = 0;
+	for (const auto& key : state.keys)
+	{
+		if (key == MoxySim::ImmobileState::ACTIVE)
+			keysLeft++;
+	}
+	if (state.player.heldKeys + keysLeft < gatesShut)
+		return unsolvable;
+
+	const int player = MoxySim::cellIndex(state.player.pos);
+	if (player < 0)
+		return 1;
+
+	const bool walkingOnly = squaresPerTurn == 1;
+	const int numGates = gateCells.size();
+	const int numKeys = keyCells.size();
+	int farthest = 0;
+	for (int g = 0; g < numGates; g++)
+	{
+		if (state.gates[g] != MoxySim::ImmobileState::ACTIVE || gateCells[g] < 0)
+			continue;
+
+		int squares = distance(player, gateCells[g]);
+		if (walkingOnly && state.player.heldKeys == 0)
+		{
+			// Empty-handed, the way to the gate goes by a key.
+			squares = unreachable;
+			for (int k = 0; k < numKeys; k++)
+			{
+				if (state.keys[k] == MoxySim::ImmobileState::ACTIVE && keyCells[k] >= 0)
+					squares = std::min(squares, distance(player, keyCells[k]) + distance(keyCells[k], gateCells[g]));
+			}
+		}
+		if (squares >= unreachable)
+			return unsolvable;
+		farthest = std::max(farthest, squares);
+	}
+
+	int turns = (farthest + squaresPerTurn - 1) / squaresPerTurn;
+	if (walkingOnly)
+	{
+		// Every step is a walk, which comes out of turns remaining.
+		if (farthest > state.turnsRemaining)
+			return unsolvable;
+		// And every gate, and every key still to pick up for one, is a walk of its own.
+		turns = std::max(turns, gatesShut + std::max(0, gatesShut - state.player.heldKeys));
+	}
+	return std::max(turns, 1);
+}
+
+bool MoxySolver::distanceHeuristic::isLost(const MoxySim::simState &state) const
+{
+	// Without patrollers every turn the estimate counts is a walk, and every walk comes out of turns remaining.
+	// The last one can be taken with a single turn left, since winning is checked before running out.
+	if (squaresPerTurn == 1)
+		return estimate(state) > state.turnsRemaining;
+
+	// With them, straight-line distances never rule anything out, so it comes down to having keys enough for the pods.
+	int keysShort = -state.player.heldKeys;
+	for (const auto& gate : state.gates)
+	{
+		if (gate == MoxySim::ImmobileState::ACTIVE)
+			keysShort++;
+	}
+	for (const auto& key : state.keys)
+	{
+		if (key == MoxySim::ImmobileState::ACTIVE)
+			keysShort--;
+	}
+	return keysShort > 0;
+}
+
+// -------------------
+// DIFFICULTY RATING
+// -------------------
+
+bool MoxySolver::difficultyRating::easierThan(const difficultyRating &other) const
+{
+	const auto rank = [](const Result result) {
+		return result == Result::SOLVED ? 0 : (result == Result::LIMIT_REACHED ? 1 : 2);
+	};
+	if (rank(result) != rank(other.result))
+		return rank(result) < rank(other.result);
+	return score < other.score;
+}
+
+MoxySolver::difficultyRating MoxySolver::rate(const MoxySim::simLevel &level, const solveOutcome &outcome)
+{
+	// How much each trap placed adds, and how much a level with no turns to spare adds (less the more turns it gives beyond par).
+	const double trapUseWeight = 4;
+	const double tightnessWeight = 10;
+
+	difficultyRating rating;
+	rating.result = outcome.result;
+	if (outcome.result != Result::SOLVED)
+		return rating;
+
+	rating.par = outcome.turnsUsed;
+	rating.slack = level.turnsInitial - outcome.turnsUsed;
+	for (const MoxySim::Action action : outcome.actions)
+	{
+		if (action == MoxySim::Action::PLACE_PUSHER_UTIL || action == MoxySim::Action::PLACE_SUCKER_UTIL)
+			rating.trapUses++;
+	}
+
+	// Solves 1 + b + b^2 + ... + b^par = expanded + 1 for b by halving the range it's in. It's between 1 (only ever one new state a turn)
+	// and 6 (every action always going somewhere new). The breadth-first search expands about that tree's worth of states to find a win par turns deep.
+	const double states = double(outcome.stats.expanded) + 1;
+	const auto treeSize = [&](const double b) {
+		double size = 1;
+		double width = 1;
+		for (int depth = 1; depth <= rating.par && size < states; depth++)
+		{
+			width *= b;
+			size += width;
+		}
+		return size;
+	};
+	double low = 1;
+	double high = 6;
+	if (rating.par == 0 || treeSize(low) >= states)
+		high = low;
+	else if (treeSize(high) < states)
+		low = high;
+	for (int i = 0; i < 40 && high - low > 1e-6; i++)
+	{
+		const double mid = (low + high) / 2;
+		if (treeSize(mid) < states)
+			low = mid;
+		else
+			high = mid;
+	}
+	rating.branching = (low + high) / 2;
+
+	const double tightness = double(rating.par) / std::max(1, level.turnsInitial);
+	rating.score = (rating.par * rating.branching) + (trapUseWeight * rating.trapUses) + (tightnessWeight * tightness);
+	return rating;
+}
+
+// ---------------
+// VISITED TABLE
+// ---------------
+
+MoxySolver::visitedTable::visitedTable()
+{
+	const size_t initialSize = size_t(1) << 16;
+	hashes.assign(initialSize, 0);
+	bests.assign(initialSize, 0);
+	mask = initialSize - 1;
+}
+
+bool MoxySolver::visitedTable::improve(const uint64_t hash, const int turnsRemaining)
+{
+	const uint64_t key = hash == 0 ? 1 : hash;
+	size_t slot = size_t(key) & mask;
+	while (hashes[slot] != 0 && hashes[slot] != key)
+		slot = (slot + 1) & mask;
+
+	if (hashes[slot] == key)
+	{
+		if (turnsRemaining <= bests[slot])
+			return false;
+		bests[slot] = turnsRemaining;
+		return true;
+	}
+
+	hashes[slot] = key;
+	bests[slot] = turnsRemaining;
+	count++;
+	// Probing stays short as long as the table is at most half full.
+	if (count * 2 > hashes.size())
+		grow();
+	return true;
+}
+
+int MoxySolver::visitedTable::best(const uint64_t hash) const
+{
+	const uint64_t key = hash == 0 ? 1 : hash;
+	size_t slot = size_t(key) & mask;
+	while (hashes[slot] != 0)
+	{
+		if (hashes[slot] == key)
+			return bests[slot];
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+void MoxySolver::visitedTable::grow()
+{
+	std::vector<uint64_t> oldHashes;
+	std::vector<int> oldBests;
+	oldHashes.swap(hashes);
+	oldBests.swap(bests);
+
+	hashes.assign(oldHashes.size() * 2, 0);
+	bests.assign(oldHashes.size() * 2, 0);
+	mask = hashes.size() - 1;
+
+	const size_t oldSize = oldHashes.size();
+	for (size_t i = 0; i < oldSize; i++)
+	{
+		if (oldHashes[i] == 0)
+			continue;
+		size_t slot = size_t(oldHashes[i]) & mask;
+		while (hashes[slot] != 0)
+			slot = (slot + 1) & mask;
+		hashes[slot] = oldHashes[i];
+		bests[slot] = oldBests[i];
+	}
+}
+
+// ------------
+// WORK DEQUE
+// ------------
+
+bool MoxySolver::workDeque::take(std::pair<int, int> &range)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (ranges.empty())
+		return false;
+	range = ranges.front();
+	ranges.pop_front();
+	return true;
+}
+
+bool MoxySolver::workDeque::steal(std::pair<int, int> &range)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (ranges.empty())
+		return false;
+	range = ranges.back();
+	ranges.pop_back();
+	return true;
+}
+
+// -------------
+// WORKER POOL
+// -------------
+
+MoxySolver::workerPool::workerPool(const int threadCount)
+{
+	for (int i = 1; i < threadCount; i++)
+		threads.emplace_back(&workerPool::loop, this, i);
+}
+
+MoxySolver::workerPool::~workerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+void MoxySolver::workerPool::run(const std::function<void(int)> &job)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		current = job;
+		running = int(threads.size());
+		generation++;
+	}
+	wake.notify_all();
+
+	job(0);
+
+	std::unique_lock<std::mutex> guard(lock);
+	finished.wait(guard, [this]() { return running == 0; });
+}
+
+void MoxySolver::workerPool::loop(const int threadIndex)
+{
+	long long seen = 0;
+	for (;;)
+	{
+		std::function<void(int)> job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [&]() { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			job = current;
+		}
+
+		job(threadIndex);
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (--running == 0)
+			finished.notify_one();
+	}
+}
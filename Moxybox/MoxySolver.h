@@ -0,0 +1,246 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MoxySim.h"
+#include "MoxyStateTable.h"
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+// MoxySolver finds the shortest way through a level, or proves there isn't one, by searching every state
+// the real turn rules (MoxySim) can reach. It's breadth-first on turns taken, so the first solution it finds is optimal.
+// Like MoxySim it has no Qt dependency. GameplayScreen converts its levelData with levelToSim before handing it over.
+class MoxySolver
+{
+public:
+
+	enum class Result { SOLVED, UNSOLVABLE, LIMIT_REACHED, CANCELLED };
+
+	struct solveLimits
+	{
+		long long maxStates = 4000000; // States kept before giving up with LIMIT_REACHED. Memory is roughly this times (packed size + 16) bytes.
+		size_t tableMemory = size_t(128) << 20; // Bytes for solveParallel's state table. Running out of room is also LIMIT_REACHED.
+		long long maxExpanded = 200000000; // solveIterative gives up after expanding this many states (counting every pass).
+		size_t iterativeTableMemory = size_t(16) << 20; // Bytes for solveIterative's table of states already searched this pass.
+
+		// solve checks this before every state it expands, and solveParallel before every run of states it takes,
+		// and they stop with CANCELLED once it's set (from any thread).
+		// For searches whose answer can stop mattering part way through, like a hint for a position the player has already left.
+		const std::atomic<bool> *cancel = nullptr;
+	};
+
+	struct solveStats
+	{
+		long long expanded = 0; // States whose six actions were tried.
+		long long generated = 0; // New or improved states that were kept.
+		double seconds = 0;
+		int threads = 1;
+		size_t peakMemory = 0; // Bytes the search held at its largest: stored states, tables, frontier or path.
+		int iterations = 0; // solveIterative: how many bounds it searched to.
+	};
+
+	struct solveOutcome
+	{
+		Result result = Result::UNSOLVABLE;
+
+		// Every action to press, in order, including the ones that only turn the player to face a new way (those don't take a turn).
+		std::vector<MoxySim::Action> actions;
+
+		// Turns taken by the solution, i.e. the level's par. Patrollers move once per turn.
+		int turnsUsed = 0;
+		solveStats stats;
+	};
+
+	static solveOutcome solve(const MoxySim::simLevel &level, const solveLimits &limits);
+	static solveOutcome solve(const MoxySim::simLevel &level) { return solve(level, solveLimits()); }
+
+	// Solves from a state part way through the level instead of its start. turnsUsed is then the turns still needed from there.
+	static solveOutcome solve(const MoxySim::simLevel &level, const MoxySim::simState &from, const solveLimits &limits);
+
+	// The same search spread over threadCount threads (the caller's thread is one of them).
+	// Finds the same par as solve, and the same actions every time for a given level, however many threads run it.
+	static solveOutcome solveParallel(const MoxySim::simLevel &level, const solveLimits &limits, const int threadCount);
+
+	// Iterative-deepening A*. Searches depth-first to a bound on turns, skipping any state whose turns taken plus a lower bound
+	// on the turns still needed (distanceHeuristic) goes over it, then raises the bound to the smallest total it skipped and goes again.
+	// Memory is a path and a fixed-size table, however big the level, at the price of searching the shallow states again on every pass.
+	// Finds the same par as solve.
+	static solveOutcome solveIterative(const MoxySim::simLevel &level, const solveLimits &limits);
+	static solveOutcome solveIterative(const MoxySim::simLevel &level) { return solveIterative(level, solveLimits()); }
+
+	// Solves every level in levels from its start with solve, threadCount levels at a time, one to a thread.
+	// For a batch of levels this beats solveParallel on each in turn, since no thread ever waits on the others mid-search.
+	// onSolved(i, outcome) is called for levels[i] as soon as it's done, from whichever thread solved it, and has to be safe for that.
+	// The outcomes come back in the same order as levels.
+	static std::vector<solveOutcome> solveEach(const std::vector<MoxySim::simLevel> &levels, const solveLimits &limits, const int threadCount,
+		const std::function<void(int, const solveOutcome&)> &onSolved);
+
+	// Every action a player can take, in the order the solver tries them.
+	static const MoxySim::Action actionsAll[6];
+
+	// --------------------
+	// DISTANCE HEURISTIC
+	// --------------------
+
+	// A lower bound on the turns it takes to open every gate still shut, from grid distances worked out once per level.
+	// Without patrollers the player only ever walks, one square a turn, so the distances are walking distances around the level's
+	// blocks and hazards (neither of which can move or go away then), and a key has to be walked to before the gate it opens.
+	// Patrollers can knock the player several squares in a turn, through blocks and over hazards, so with any about
+	// the distances are straight-line ones, divided by the furthest the player could be moved in a turn.
+	// Teleports count as the same square either way.
+	class distanceHeuristic
+	{
+	public:
+		explicit distanceHeuristic(const MoxySim::simLevel &level);
+
+		// Turns needed at least, or unsolvable if there's no way from here at all (too few keys left, a gate walled off).
+		int estimate(const MoxySim::simState &state) const;
+
+		// True when the level can't be won from this state whatever the player does, so play can stop here rather than
+		// when the turns run out. Cheap enough for every turn: a count of keys and gates and a few table lookups.
+		// Only proves what the estimate can: with patrollers about some turns don't use up turns remaining, so those levels
+		// are only lost on keys and gates, not on distance.
+		bool isLost(const MoxySim::simState &state) const;
+
+		size_t memoryBytes() const { return distances.capacity(); }
+
+		static const int unsolvable = 1 << 20;
+
+	private:
+		static const uint8_t unreachable = 255;
+		std::vector<int> keyCells;
+		std::vector<int> gateCells;
+		int squaresPerTurn = 1;
+		std::vector<uint8_t> distances; // In squares, from every square to every square.
+
+		int distance(const int from, const int to) const { return distances[(size_t(from) * MoxySim::gridCellCount) + to]; }
+	};
+
+	// -------------------
+	// DIFFICULTY RATING
+	// -------------------
+
+	// How hard a level is, going by what it took to solve from its start rather than what its author says (::LevelDifficulty=).
+	// score puts the rating in one number. Par is the backbone of it: each turn is one more to get right.
+	// branching scales that by how many ways each of those turns could have gone, and traps placed and turns to spare add on top.
+	// Only SOLVED outcomes get a score. Ones the search gave up on are harder than any of those, and unsolvable ones come last.
+	struct difficultyRating
+	{
+		Result result = Result::UNSOLVABLE;
+		int par = 0;
+		int slack = 0; // Turns the level gives beyond par.
+		int trapUses = 0; // Traps placed in the solution.
+		double branching = 1; // Effective branching factor: b where a full tree par turns deep with b children a state has as many states as the search expanded.
+		double score = 0;
+
+		// Ranks easiest first: SOLVED by score, then LIMIT_REACHED, then the rest.
+		bool easierThan(const difficultyRating &other) const;
+	};
+	static difficultyRating rate(const MoxySim::simLevel &level, const solveOutcome &outcome);
+
+	// States a search for a rating keeps before giving up, around 50 MB at 100 bytes a state.
+	// It's kept down since solveEach runs a search like it on every thread at once.
+	static const long long ratingMaxStates = 500000;
+
+private:
+
+	// Each state the search keeps is a packed MoxySim state (in one big arena) plus how it was reached.
+	struct searchNode
+	{
+		int parent;
+		int turnsUsed;
+		MoxySim::Action action;
+	};
+
+	// Positions seen so far (hash ignoring turns remaining) and the most turns remaining any path has arrived there with.
+	// Open addressing with linear probing. A hash of 0 marks an empty slot, so a real 0 is stored as 1.
+	class visitedTable
+	{
+	public:
+		visitedTable();
+
+		// True if this is the first time here, or the first time with this many turns left. Records it either way.
+		bool improve(const uint64_t hash, const int turnsRemaining);
+		int best(const uint64_t hash) const;
+		size_t memoryBytes() const { return hashes.capacity() * (sizeof(uint64_t) + sizeof(int)); }
+
+	private:
+		std::vector<uint64_t> hashes;
+		std::vector<int> bests;
+		size_t count = 0;
+		size_t mask = 0;
+
+		void grow();
+	};
+
+	// ------------------
+	// ITERATIVE SEARCH
+	// ------------------
+
+	struct iterativeSearch;
+
+	// ----------------
+	// PARALLEL SEARCH
+	// ----------------
+
+	// Which node a state was reached from and which of actionsAll got it there, as one number: (parent + 1) * 8 + action.
+	// The root is 0. Comparing links compares parents first, which is what makes the parallel search deterministic:
+	// whenever two paths reach the same state at the same cost, the smaller link wins, whichever thread got there first.
+	static uint64_t makeLink(const int parent, const int actionIndex) { return (uint64_t(parent + 1) << 3) | uint64_t(actionIndex); }
+	static int linkParent(const uint64_t link) { return int(link >> 3) - 1; }
+	static int linkAction(const uint64_t link) { return int(link & 7); }
+
+	// Ranges of the current round's nodes for one thread to expand. The owner takes from the front,
+	// and a thread that runs out steals from the back of someone else's.
+	struct workDeque
+	{
+		std::mutex lock;
+		std::deque<std::pair<int, int>> ranges;
+
+		bool take(std::pair<int, int> &range);
+		bool steal(std::pair<int, int> &range);
+	};
+
+	// Threads that stay alive for a whole search and run one job at a time, all together.
+	class workerPool
+	{
+	public:
+		explicit workerPool(const int threadCount);
+		~workerPool();
+
+		// Runs job(threadIndex) on every thread, the calling thread being thread 0, and returns once they've all finished.
+		void run(const std::function<void(int)> &job);
+		int size() const { return int(threads.size()) + 1; }
+
+	private:
+		std::vector<std::thread> threads;
+		std::mutex lock;
+		std::condition_variable wake;
+		std::condition_variable finished;
+		std::function<void(int)> current;
+		long long generation = 0;
+		int running = 0;
+		bool stopping = false;
+
+		void loop(const int threadIndex);
+	};
+};
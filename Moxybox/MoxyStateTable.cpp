@@ -0,0 +1,147 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "MoxyStateTable.h"
+
+MoxyStateTable::MoxyStateTable(const size_t memoryBudget, const Replacement newReplacement)
+	: replacement(newReplacement),
+	probeLimit(newReplacement == Replacement::KEEP ? probeLimitKeep : probeLimitReplace)
+{
+	size_t slotCount = 1024;
+	while (slotCount * 2 * sizeof(entry) <= memoryBudget)
+		slotCount *= 2;
+	entries.reset(new entry[slotCount]);
+	mask = slotCount - 1;
+	clear();
+}
+
+uint64_t MoxyStateTable::packValue(const uint64_t key, const int turnsRemaining, const uint64_t parentLink)
+{
+	const uint64_t turns = uint64_t(turnsRemaining < 0 ? 0 : (turnsRemaining > turnsMax ? turnsMax : turnsRemaining)) + 1;
+	const uint64_t link = parentLink > linkMax ? linkMax : parentLink;
+	return (turns << 48) | ((linkMax - link) << 8) | checkOf(key);
+}
+
+MoxyStateTable::OfferResult MoxyStateTable::offer(const uint64_t digest, const int turnsRemaining, const uint64_t parentLink)
+{
+	const uint64_t key = keyOf(digest);
+	const uint64_t offered = packValue(key, turnsRemaining, parentLink);
+
+	// Anything that finds a slot changing hands under it starts over. That only happens with FEWEST_TURNS and a full table.
+	for (;;)
+	{
+		bool startOver = false;
+		entry *victim = nullptr;
+		uint64_t victimValue = 0;
+
+		for (int probe = 0; probe < probeLimit && !startOver; probe++)
+		{
+			entry &s = entries[(size_t(key) + probe) & mask];
+			uint64_t slotKey = s.key.load(std::memory_order_acquire);
+
+			// A free slot. If someone else claims it first it might have been for this same state, so look again.
+			if (slotKey == 0)
+			{
+				if (s.key.compare_exchange_strong(slotKey, key, std::memory_order_acq_rel))
+					slotKey = key;
+			}
+
+			if (slotKey == key)
+			{
+				// Raise the value to ours, unless it's already as good. The check bits catch the slot being given away meanwhile.
+				uint64_t current = s.value.load(std::memory_order_acquire);
+				for (;;)
+				{
+					if ((current & busy) || (current != 0 && (current & 0xFF) != checkOf(key)))
+					{
+						startOver = true;
+						break;
+					}
+					if (current != 0 && valueRank(current) >= valueRank(offered))
+						return OfferResult::WORSE;
+					if (s.value.compare_exchange_weak(current, offered, std::memory_order_acq_rel))
+					{
+						if (s.key.load(std::memory_order_acquire) == key)
+							return OfferResult::STORED;
+						startOver = true;
+						break;
+					}
+				}
+				continue;
+			}
+
+			const uint64_t value = s.value.load(std::memory_order_acquire);
+			if (value != 0 && !(value & busy) && (victim == nullptr || valueTurns(value) < valueTurns(victimValue)))
+			{
+				victim = &s;
+				victimValue = value;
+			}
+		}
+		if (startOver)
+			continue;
+
+		if (replacement == Replacement::KEEP || victim == nullptr || valueTurns(victimValue) > turnsRemaining)
+			return OfferResult::FULL;
+
+		// Mark the victim busy so nobody updates it while its key changes, then hand it over.
+		if (victim->value.compare_exchange_strong(victimValue, busy, std::memory_order_acq_rel))
+		{
+			victim->key.store(key, std::memory_order_release);
+			victim->value.store(offered, std::memory_order_release);
+			return OfferResult::STORED;
+		}
+	}
+}
+
+bool MoxyStateTable::find(const uint64_t digest, int &turnsRemaining, uint64_t &parentLink) const
+{
+	const uint64_t key = keyOf(digest);
+	for (int probe = 0; probe < probeLimit; probe++)
+	{
+		const entry &s = entries[(size_t(key) + probe) & mask];
+		const uint64_t slotKey = s.key.load(std::memory_order_acquire);
+		if (slotKey == 0)
+			return false;
+		if (slotKey != key)
+			continue;
+
+		const uint64_t value = s.value.load(std::memory_order_acquire);
+		if (value == 0 || (value & busy) || (value & 0xFF) != checkOf(key) || s.key.load(std::memory_order_acquire) != key)
+			return false;
+		turnsRemaining = valueTurns(value);
+		parentLink = valueLink(value);
+		return true;
+	}
+	return false;
+}
+
+void MoxyStateTable::clear()
+{
+	for (size_t i = 0; i <= mask; i++)
+	{
+		entries[i].key.store(0, std::memory_order_relaxed);
+		entries[i].value.store(0, std::memory_order_relaxed);
+	}
+}
+
+size_t MoxyStateTable::size() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i <= mask; i++)
+	{
+		if (entries[i].key.load(std::memory_order_relaxed) != 0)
+			count++;
+	}
+	return count;
+}
@@ -0,0 +1,98 @@
+/*
+This file is part of Moxybox.
+	Moxybox is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Moxybox is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Moxybox.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// MoxyStateTable remembers game states for searches that run on many threads at once (solving, reachability, validation).
+// States are keyed by a 64-bit digest of everything that can change during play, e.g. MoxySim::getHashIgnoringTurns.
+// For each one it keeps the most turns remaining any path has arrived with, and a parent link saying how that path got there.
+//
+// There are no locks. Every slot is two 64-bit words, claimed and updated with compare-and-swap,
+// so threads never wait on each other, only occasionally retry. The table never grows: it's given a memory budget up front,
+// and when it fills up the replacement policy decides what happens.
+class MoxyStateTable
+{
+public:
+
+	enum class Replacement
+	{
+		KEEP, // Nothing already stored is ever thrown out. A full table turns newcomers away (searches that must see every state).
+		// A newcomer takes the place of whichever nearby state has the fewest turns remaining, if it has at least as many.
+		// For caches that can afford to forget. Two threads bringing in the same new state at once can leave it in two entries, and lookups see the first.
+		FEWEST_TURNS
+	};
+
+	enum class OfferResult
+	{
+		STORED, // New, or better than what was there. The table now holds this parent link for it.
+		WORSE, // Already here with as many turns remaining (or as many and a smaller link).
+		FULL // No room for it and the policy didn't make any.
+	};
+
+	// Links are limited to 40 bits and turns remaining to 0-32766, so an entry's turns, link and a few check bits share one word.
+	static const uint64_t linkMax = (uint64_t(1) << 40) - 1;
+	static const int turnsMax = 32766;
+
+	// Memory budget in bytes. The slot count is the largest power of two that fits (16 bytes a slot), at least 1024.
+	explicit MoxyStateTable(const size_t memoryBudget, const Replacement newReplacement = Replacement::KEEP);
+
+	// Records the state if it beats what's there: more turns remaining wins, and between equal turns, the smaller link.
+	// That way the table ends up the same whatever order threads make their offers in.
+	OfferResult offer(const uint64_t digest, const int turnsRemaining, const uint64_t parentLink);
+	bool find(const uint64_t digest, int &turnsRemaining, uint64_t &parentLink) const;
+
+	// These aren't safe to call while other threads are offering.
+	void clear();
+	size_t size() const;
+
+	size_t capacity() const { return mask + 1; }
+	size_t memoryBytes() const { return capacity() * sizeof(entry); }
+	Replacement getReplacement() const { return replacement; }
+
+private:
+
+	// The key word is the digest (0 means empty, so a digest of 0 is stored as 1).
+	// The value word packs turns remaining, the link and check bits from the digest, ordered so that a bigger value is a better entry:
+	//   bit 63: busy (a slot being handed to a new key)   bits 48-62: turns remaining + 1   bits 8-47: linkMax - link   bits 0-7: digest check
+	// A value of 0 means the key was just claimed and nothing's been written yet.
+	// The check bits let an update notice that the slot was handed to another key between reading it and writing it.
+	struct alignas(16) entry
+	{
+		std::atomic<uint64_t> key;
+		std::atomic<uint64_t> value;
+	};
+
+	// How far along from its home slot a state can be. Past this the table is, as far as that state's concerned, full.
+	// Replacing only looks at the first few entries, since evicting from far along a run of full entries is as good as evicting from the start.
+	static const int probeLimitKeep = 4096;
+	static const int probeLimitReplace = 32;
+	static const uint64_t busy = uint64_t(1) << 63;
+
+	std::unique_ptr<entry[]> entries;
+	size_t mask = 0;
+	Replacement replacement = Replacement::KEEP;
+	int probeLimit = probeLimitKeep;
+
+	static uint64_t keyOf(const uint64_t digest) { return digest == 0 ? 1 : digest; }
+	static uint64_t checkOf(const uint64_t key) { return (key >> 56) & 0xFF; }
+	static uint64_t packValue(const uint64_t key, const int turnsRemaining, const uint64_t parentLink);
+	static int valueTurns(const uint64_t value) { return int((value >> 48) & 0x7FFF) - 1; }
+	static uint64_t valueLink(const uint64_t value) { return linkMax - ((value >> 8) & linkMax); }
+	static uint64_t valueRank(const uint64_t value) { return value >> 8; }
+};